@@ -0,0 +1,411 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <omp.h>
+
+// Benchmark reprodutível (make bench): roda as versões seq, v1, v2 e v3 (com cada
+// engine) para cada combinação de N, K e threads, sempre com a mesma semente
+// (KMEANS_SEED). Cada combinação roda algumas vezes sem medir (aquecimento) e depois
+// REPS vezes; a saída, em CSV ou JSON, traz a mediana e o desvio padrão do tempo do
+// laço principal, o tempo por iteração e o speedup e a eficiência em relação ao
+// menor número de threads da lista. Na v3, a lista de precisões (-p) mede também o
+// custo da precisão reduzida: a inércia final de cada execução e, em relação à
+// primeira precisão da lista, a diferença relativa de inércia e o speedup por
+// iteração. Os programas são chamados como na linha de comando e os resultados são
+// lidos da saída de cada um. As combinações que a v3 não aceita (precisão reduzida
+// fora das engines twopass e fused) são puladas, e uma execução que falha só tira a
+// sua combinação da saída: a matriz segue, e o código de saída indica a falha.
+
+#define MAX_LIST 64    // Máximo de valores em cada lista (-v, -e, -t, -n, -k, -p)
+#define LINE_SIZE 1024
+
+// N, K e D das versões seq, v1 e v2 (fixos nos #define de cada uma)
+#define LEGACY_N 10000000
+#define LEGACY_K 50
+#define LEGACY_D 2
+
+// Versões medidas: nome, executável (em exe/) e se é uma das versões antigas, que
+// recebem só o número de threads
+typedef struct {
+    const char *name;
+    const char *program;
+    int         legacy;
+} Version;
+
+static const Version versions[] = {
+    { "seq", "kmeans_seq", 1 },
+    { "v1",  "kmeans_v1",  1 },
+    { "v2",  "kmeans_v2",  1 },
+    { "v3",  "kmeans_par", 0 },
+};
+#define NUM_VERSIONS (int)(sizeof(versions) / sizeof(versions[0]))
+
+// Engines da v3 que aceitam float32 e q16 (as de Engine.f32 = 1)
+static const char *reduced_engines[] = { "twopass", "fused" };
+#define NUM_REDUCED (int)(sizeof(reduced_engines) / sizeof(reduced_engines[0]))
+
+// Resultado de uma execução, lido da saída do programa
+typedef struct {
+    int    iterations;
+    double time;        // Tempo do laço principal (seg)
+    int    n, d;        // N e D de fato usados (com KMEANS_DATA, os do arquivo)
+    double inertia;     // Inércia final (só na v3; negativa nas versões antigas)
+    char   kernel[32];  // Kernel de atribuição da v3 ("-" nas versões antigas)
+} Sample;
+
+// Opções repassadas à v3 (vazias = padrão da v3)
+static const char *exe_dir  = "exe";
+static const char *v3_init  = NULL;
+static int         v3_dims  = 0;
+static int         v3_iter  = 0;
+static int         json     = 0;
+static int         records  = 0;  // Linhas já impressas (separador do JSON)
+
+// Separa uma lista "a,b,c" (a string é modificada). Retorna o número de itens
+static int split_list(char *s, char **items) {
+    int count = 0;
+    for (char *tok = strtok(s, ","); tok != NULL && count < MAX_LIST; tok = strtok(NULL, ",")) {
+        items[count++] = tok;
+    }
+    return count;
+}
+
+static int parse_ints(char *s, int *values) {
+    char *items[MAX_LIST];
+    int count = split_list(s, items);
+    for (int i = 0; i < count; i++) values[i] = atoi(items[i]);
+    return count;
+}
+
+// Se a v3 roda a engine na precisão dada (NULL ou f64: todas as engines)
+static int supported(const char *engine, const char *prec) {
+    if (prec == NULL || strcmp(prec, "f64") == 0) return 1;
+    for (int e = 0; e < NUM_REDUCED; e++) {
+        if (strcmp(reduced_engines[e], engine) == 0) return 1;
+    }
+    return 0;
+}
+
+static int compare_int(const void *a, const void *b) {
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Mediana de n valores (o vetor é ordenado)
+static double median(double *v, int n) {
+    qsort(v, (size_t)n, sizeof(double), compare_double);
+    return (n % 2) ? v[n / 2] : 0.5 * (v[n / 2 - 1] + v[n / 2]);
+}
+
+// Desvio padrão amostral
+static double stddev(const double *v, int n) {
+    if (n < 2) return 0.0;
+    double mean = 0.0, sq = 0.0;
+    for (int i = 0; i < n; i++) mean += v[i];
+    mean /= n;
+    for (int i = 0; i < n; i++) sq += (v[i] - mean) * (v[i] - mean);
+    return sqrt(sq / (n - 1));
+}
+
+// Roda uma vez a versão ver com a engine, a precisão (NULL = padrão), N, K e threads
+// dados. Retorna 0, ou -1 se o programa falhou ou a saída não tinha o resultado
+// esperado
+static int run_once(const Version *ver, const char *engine, const char *prec, int n, int k, int threads,
+                    Sample *out) {
+    char cmd[LINE_SIZE];
+    if (ver->legacy) {
+        snprintf(cmd, sizeof(cmd), "%s/%s %d", exe_dir, ver->program, threads);
+    } else {
+        int len = snprintf(cmd, sizeof(cmd), "%s/%s -m 0 -t %d -e %s -n %d -k %d",
+                           exe_dir, ver->program, threads, engine, n, k);
+        if (v3_init != NULL) len += snprintf(cmd + len, sizeof(cmd) - len, " -c %s", v3_init);
+        if (prec != NULL)    len += snprintf(cmd + len, sizeof(cmd) - len, " -p %s", prec);
+        if (v3_dims > 0)     len += snprintf(cmd + len, sizeof(cmd) - len, " -d %d", v3_dims);
+        if (v3_iter > 0)     snprintf(cmd + len, sizeof(cmd) - len, " -i %d", v3_iter);
+    }
+
+    FILE *p = popen(cmd, "r");
+    if (p == NULL) {
+        perror(cmd);
+        return -1;
+    }
+
+    out->iterations = -1;
+    out->time       = -1.0;
+    out->inertia    = -1.0;
+    out->n          = ver->legacy ? LEGACY_N : n;
+    out->d          = ver->legacy ? LEGACY_D : (v3_dims > 0 ? v3_dims : 2);
+    strcpy(out->kernel, "-");
+
+    char line[LINE_SIZE];
+    while (fgets(line, sizeof(line), p) != NULL) {
+        const char *s;
+        if (ver->legacy) {
+            if ((s = strstr(line, "convergiu em ")) != NULL) sscanf(s + 13, "%d", &out->iterations);
+            if ((s = strstr(line, "Tempo total: ")) != NULL) sscanf(s + 13, "%lf", &out->time);
+            continue;
+        }
+        if ((s = strstr(line, "Kernel de atribuição: ")) != NULL) {
+            sscanf(s + strlen("Kernel de atribuição: "), "%31s", out->kernel);
+        } else if (strncmp(line, "Dataset: ", 9) == 0 && (s = strstr(line, "(N=")) != NULL) {
+            sscanf(s, "(N=%d, D=%d", &out->n, &out->d);
+        } else if (strstr(line, "Execução normal:") != NULL) {
+            if ((s = strstr(line, " D=")) != NULL)         sscanf(s + 3, "%d", &out->d);
+            if ((s = strstr(line, "Iterações=")) != NULL)  sscanf(s + strlen("Iterações="), "%d", &out->iterations);
+            if ((s = strstr(line, "Tempo=")) != NULL)      sscanf(s + 6, "%lf", &out->time);
+            if ((s = strstr(line, "Inércia=")) != NULL)    sscanf(s + strlen("Inércia="), "%lf", &out->inertia);
+        }
+    }
+
+    int status = pclose(p);
+    if (status != 0 || out->iterations < 1 || out->time < 0.0) {
+        fprintf(stderr, "Falha ao executar: %s\n", cmd);
+        return -1;
+    }
+    return 0;
+}
+
+static void print_header(void) {
+    if (json) printf("[\n");
+    else printf("version,engine,precision,n,k,d,threads,kernel,seed,reps,iterations,median_s,stddev_s,min_s,"
+                "per_iter_s,speedup,efficiency,inertia,inertia_diff,precision_speedup\n");
+}
+
+static void print_footer(void) {
+    if (json) printf("%s]\n", records ? "\n" : "");
+}
+
+// A inércia e as colunas relativas à primeira precisão ficam vazias (null no JSON)
+// quando não existem: nas versões antigas, ou na própria primeira precisão
+static void print_record(const char *version, const char *engine, const char *prec, const Sample *s, int k,
+                         int threads, unsigned int seed, int reps, double med, double sd, double min,
+                         double per_iter, double speedup, double efficiency, double inertia_diff,
+                         double prec_speedup) {
+    char inertia[32] = "", diff[32] = "", pspeed[32] = "";
+    if (s->inertia >= 0.0) snprintf(inertia, sizeof(inertia), "%.6e", s->inertia);
+    if (prec_speedup > 0.0) {
+        snprintf(diff, sizeof(diff), "%.4e", inertia_diff);
+        snprintf(pspeed, sizeof(pspeed), "%.4f", prec_speedup);
+    }
+
+    if (json) {
+        printf("%s  {\"version\": \"%s\", \"engine\": \"%s\", \"precision\": \"%s\", \"n\": %d, "
+               "\"k\": %d, \"d\": %d, \"threads\": %d, \"kernel\": \"%s\", \"seed\": %u, \"reps\": %d, "
+               "\"iterations\": %d, \"median_s\": %.6f, \"stddev_s\": %.6f, \"min_s\": %.6f, "
+               "\"per_iter_s\": %.9f, \"speedup\": %.4f, \"efficiency\": %.4f, \"inertia\": %s, "
+               "\"inertia_diff\": %s, \"precision_speedup\": %s}",
+               records ? ",\n" : "", version, engine, prec, s->n, k, s->d, threads, s->kernel, seed, reps,
+               s->iterations, med, sd, min, per_iter, speedup, efficiency, inertia[0] ? inertia : "null",
+               diff[0] ? diff : "null", pspeed[0] ? pspeed : "null");
+    } else {
+        printf("%s,%s,%s,%d,%d,%d,%d,%s,%u,%d,%d,%.6f,%.6f,%.6f,%.9f,%.4f,%.4f,%s,%s,%s\n",
+               version, engine, prec, s->n, k, s->d, threads, s->kernel, seed, reps, s->iterations,
+               med, sd, min, per_iter, speedup, efficiency, inertia, diff, pspeed);
+    }
+    fflush(stdout);
+    records++;
+}
+
+// Mede uma combinação (versão, engine, precisão, N, K) para cada número de threads.
+// O speedup e a eficiência usam o tempo por iteração, já que v1 e v2 geram pontos
+// diferentes para cada número de threads (e podem convergir em outro número de
+// iterações). base guarda, por número de threads, o tempo por iteração e a inércia
+// da primeira precisão (first = 1), contra os quais as outras são comparadas.
+// Um número de threads cuja execução falhou fica fora da saída e os demais seguem.
+// Retorna 0, ou -1 se alguma execução falhou
+static int bench_config(const Version *ver, const char *engine, const char *prec, int first, int n, int k,
+                        const int *threads, int num_threads, int reps, int warmup, unsigned int seed,
+                        Sample *base) {
+    double *times = malloc((size_t)reps * sizeof(double));
+    if (times == NULL) return -1;
+
+    double base_per_iter = 0.0;
+    int    base_threads  = threads[0];
+    int    rc            = 0;
+    for (int t = 0; t < num_threads; t++) {
+        // A versão sequencial ignora o número de threads
+        if (strcmp(ver->name, "seq") == 0 && t > 0) break;
+
+        fprintf(stderr, "bench: %s %s %s N=%d K=%d threads=%d\n", ver->name, engine, prec ? prec : "-", n, k,
+                threads[t]);
+        Sample s;
+        int ok = 1;
+        for (int w = 0; w < warmup && ok; w++) ok = run_once(ver, engine, prec, n, k, threads[t], &s) == 0;
+
+        // Com a semente fixa, o número de iterações é o mesmo em todas as repetições
+        double min = INFINITY;
+        for (int r = 0; r < reps && ok; r++) {
+            ok = run_once(ver, engine, prec, n, k, threads[t], &s) == 0;
+            times[r] = s.time;
+            if (s.time < min) min = s.time;
+        }
+        if (!ok) {
+            if (first) base[t].inertia = -1.0;
+            rc = -1;
+            continue;
+        }
+
+        double sd       = stddev(times, reps);
+        double med      = median(times, reps);
+        double per_iter = med / s.iterations;
+        if (base_per_iter == 0.0) {
+            base_per_iter = per_iter;
+            base_threads  = threads[t];
+        }
+        double speedup  = (per_iter > 0.0) ? base_per_iter / per_iter : 0.0;
+
+        // Custo da precisão: base[t].time guarda o tempo por iteração da primeira
+        double inertia_diff = 0.0, prec_speedup = 0.0;
+        if (first) {
+            base[t] = s;
+            base[t].time = per_iter;
+        } else if (base[t].inertia > 0.0 && s.inertia >= 0.0 && per_iter > 0.0) {
+            inertia_diff = (s.inertia - base[t].inertia) / base[t].inertia;
+            prec_speedup = base[t].time / per_iter;
+        }
+        print_record(ver->name, ver->legacy ? "-" : engine, prec ? prec : "-", &s, ver->legacy ? LEGACY_K : k,
+                     threads[t], seed, reps, med, sd, min, per_iter, speedup,
+                     speedup * base_threads / threads[t], inertia_diff, prec_speedup);
+    }
+
+    free(times);
+    return rc;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Uso: %s [-v versões] [-e engines] [-t threads] [-n Ns] [-k Ks] [-r reps] [-w aquecimento]\n"
+            "          [-s semente] [-f csv|json] [-x diretório] [-c init] [-p precisões] [-d D] [-i iterações]\n"
+            "  listas separadas por vírgula; versões: seq, v1, v2, v3 (padrão: todas)\n"
+            "  -p  precisões da v3 (f64, f32, q16); a primeira é a referência de inércia e speedup\n"
+            "  padrões: -e twopass -t 1,2,4,... (até o máximo do OpenMP) -n 1000000 -k 50 -r 5 -w 1\n"
+            "           -s 12345 -f csv -x exe\n"
+            "  -c, -p, -d e -i são repassadas à v3; seq, v1 e v2 usam N=%d, K=%d e D=%d fixos\n",
+            prog, LEGACY_N, LEGACY_K, LEGACY_D);
+}
+
+int main(int argc, char *argv[]) {
+    char default_versions[] = "seq,v1,v2,v3";
+    char default_engines[]  = "twopass";
+    char default_n[]        = "1000000";
+    char default_k[]        = "50";
+    char *version_list = default_versions, *engine_list = default_engines;
+    char *n_list = default_n, *k_list = default_k, *thread_list = NULL, *prec_list = NULL;
+    int reps = 5, warmup = 1;
+    unsigned int seed = 12345;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "v:e:t:n:k:r:w:s:f:x:c:p:d:i:h")) != -1) {
+        switch (opt) {
+        case 'v': version_list = optarg; break;
+        case 'e': engine_list  = optarg; break;
+        case 't': thread_list  = optarg; break;
+        case 'n': n_list       = optarg; break;
+        case 'k': k_list       = optarg; break;
+        case 'r': reps         = atoi(optarg); break;
+        case 'w': warmup       = atoi(optarg); break;
+        case 's': seed         = (unsigned int)strtoul(optarg, NULL, 10); break;
+        case 'x': exe_dir      = optarg; break;
+        case 'c': v3_init      = optarg; break;
+        case 'p': prec_list    = optarg; break;
+        case 'd': v3_dims      = atoi(optarg); break;
+        case 'i': v3_iter      = atoi(optarg); break;
+        case 'f':
+            if (strcmp(optarg, "json") == 0) json = 1;
+            else if (strcmp(optarg, "csv") == 0) json = 0;
+            else {
+                fprintf(stderr, "Formato desconhecido: %s.\n", optarg);
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    char *version_names[MAX_LIST], *engines[MAX_LIST], *precs[MAX_LIST];
+    int   ns[MAX_LIST], ks[MAX_LIST], threads[MAX_LIST];
+    int num_versions = split_list(version_list, version_names);
+    int num_engines  = split_list(engine_list, engines);
+    int num_precs    = 1;
+    precs[0] = NULL;
+    if (prec_list != NULL) num_precs = split_list(prec_list, precs);
+    int num_ns       = parse_ints(n_list, ns);
+    int num_ks       = parse_ints(k_list, ks);
+    int num_threads  = 0;
+    if (thread_list != NULL) {
+        num_threads = parse_ints(thread_list, threads);
+    } else {
+        for (int t = 1; t <= omp_get_max_threads() && num_threads < MAX_LIST; t *= 2) threads[num_threads++] = t;
+    }
+    qsort(threads, (size_t)num_threads, sizeof(int), compare_int);
+
+    if (reps < 1 || warmup < 0 || num_versions == 0 || num_engines == 0 || num_ns == 0 || num_ks == 0 ||
+        num_precs == 0 || num_threads == 0 || threads[0] < 1) {
+        fprintf(stderr, "Parâmetro fora do intervalo (reps >= 1, aquecimento >= 0, listas não vazias).\n");
+        return 1;
+    }
+
+    // Todas as versões (e todas as execuções) usam a mesma semente
+    char seed_str[16];
+    snprintf(seed_str, sizeof(seed_str), "%u", seed);
+    setenv("KMEANS_SEED", seed_str, 1);
+
+    print_header();
+    int rc = 0, failed = 0;
+    for (int v = 0; v < num_versions && rc == 0; v++) {
+        const Version *ver = NULL;
+        for (int i = 0; i < NUM_VERSIONS; i++) {
+            if (strcmp(versions[i].name, version_names[v]) == 0) ver = &versions[i];
+        }
+        if (ver == NULL) {
+            fprintf(stderr, "Versão desconhecida: %s.\n", version_names[v]);
+            rc = 1;
+            break;
+        }
+
+        // As versões antigas têm N, K, engine e precisão fixos: uma combinação só
+        int loops_e = ver->legacy ? 1 : num_engines;
+        int loops_n = ver->legacy ? 1 : num_ns;
+        int loops_k = ver->legacy ? 1 : num_ks;
+        int loops_p = ver->legacy ? 1 : num_precs;
+        Sample base[MAX_LIST];
+        for (int e = 0; e < loops_e; e++) {
+            for (int i = 0; i < loops_n; i++) {
+                for (int j = 0; j < loops_k; j++) {
+                    // Sem a primeira precisão, as outras não têm referência
+                    for (int t = 0; t < num_threads; t++) base[t].inertia = -1.0;
+                    for (int p = 0; p < loops_p; p++) {
+                        const char *prec = ver->legacy ? NULL : precs[p];
+                        if (!ver->legacy && !supported(engines[e], prec)) {
+                            fprintf(stderr, "bench: %s %s %s não suportada pela v3, pulando\n", ver->name,
+                                    engines[e], prec);
+                            continue;
+                        }
+                        if (bench_config(ver, engines[e], prec, p == 0, ns[i], ks[j], threads, num_threads,
+                                         reps, warmup, seed, base) != 0) {
+                            failed++;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    print_footer();
+    if (failed > 0) {
+        fprintf(stderr, "bench: %d combinações falharam (fora da saída)\n", failed);
+        rc = 1;
+    }
+    return rc;
+}
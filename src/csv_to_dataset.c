@@ -0,0 +1,141 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "kmeans.h"
+
+// Conversor de CSV (uma linha por ponto, coordenadas separadas por vírgula) para o
+// formato binário lido pela v3. Uma primeira passada conta as linhas e as colunas;
+// a segunda escreve cada valor direto na sua coluna do arquivo de saída mapeado, de
+// modo que o conversor não precisa guardar o conjunto inteiro na memória.
+//
+// Uso: csv_to_dataset entrada.csv saida.kmds [f32]
+
+// Conta os campos de uma linha; devolve 0 se algum campo não for numérico
+static int count_fields(const char *line) {
+    int fields = 0;
+    const char *p = line;
+    for (;;) {
+        char *end;
+        strtod(p, &end);
+        if (end == p) return 0;
+        fields++;
+        while (*end == ' ' || *end == '\t') end++;
+        if (*end != ',') return (*end == '\n' || *end == '\r' || *end == '\0') ? fields : 0;
+        p = end + 1;
+    }
+}
+
+static int blank(const char *line) {
+    return line[strspn(line, " \t\r\n")] == '\0';
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        fprintf(stderr, "Uso: %s entrada.csv saida.kmds [f32]\n", argv[0]);
+        return 1;
+    }
+    uint32_t dtype = (argc > 3 && strcmp(argv[3], "f32") == 0) ? DTYPE_F32 : DTYPE_F64;
+
+    FILE *in = fopen(argv[1], "r");
+    if (in == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    // Primeira passada: número de pontos e de dimensões. Uma primeira linha não
+    // numérica é tratada como cabeçalho do CSV. As linhas são lidas com getline, que
+    // aumenta o buffer até o fim da linha, qualquer que seja o número de colunas
+    char  *line = NULL;
+    size_t line_cap = 0;
+    uint64_t n = 0;
+    int d = 0, skip_header = 0;
+    long line_no = 0;
+    while (getline(&line, &line_cap, in) != -1) {
+        line_no++;
+        if (blank(line)) continue;
+        int fields = count_fields(line);
+        if (d == 0 && fields == 0 && n == 0 && !skip_header) {
+            skip_header = 1;
+            continue;
+        }
+        if (d == 0) d = fields;
+        if (fields != d || d == 0) {
+            fprintf(stderr, "%s:%ld: esperava %d coordenadas numéricas.\n", argv[1], line_no, d);
+            free(line);
+            fclose(in);
+            return 1;
+        }
+        n++;
+    }
+    if (n == 0 || d > MAX_D) {
+        if (n == 0) fprintf(stderr, "%s: nenhum ponto encontrado.\n", argv[1]);
+        else        fprintf(stderr, "%s: %d coordenadas por ponto (máximo de %d).\n", argv[1], d, MAX_D);
+        free(line);
+        fclose(in);
+        return 1;
+    }
+
+    // Cria o arquivo de saída já com o tamanho final e o mapeia para escrita
+    size_t col  = dataset_column_bytes(n, dtype);
+    size_t size = sizeof(DatasetHeader) + (size_t)d * col;
+    int fd = open(argv[2], O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || ftruncate(fd, (off_t)size) != 0) {
+        perror(argv[2]);
+        free(line);
+        fclose(in);
+        return 1;
+    }
+    char *out = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (out == MAP_FAILED) {
+        perror(argv[2]);
+        close(fd);
+        free(line);
+        fclose(in);
+        return 1;
+    }
+
+    DatasetHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, DATASET_MAGIC, sizeof(h.magic));
+    h.n     = n;
+    h.d     = (uint32_t)d;
+    h.dtype = dtype;
+    memcpy(out, &h, sizeof(h));
+
+    // Segunda passada: cada coordenada vai para a sua coluna
+    char *cols = out + sizeof(DatasetHeader);
+    rewind(in);
+    uint64_t i = 0;
+    int header = skip_header;
+    while (getline(&line, &line_cap, in) != -1 && i < n) {
+        if (blank(line)) continue;
+        if (header) {
+            header = 0;
+            continue;
+        }
+        char *p = line;
+        for (int c = 0; c < d; c++) {
+            double v = strtod(p, &p);
+            if (dtype == DTYPE_F32) ((float *)(cols + c * col))[i] = (float)v;
+            else                    ((double *)(cols + c * col))[i] = v;
+            p = strchr(p, ',');
+            if (p != NULL) p++;
+            else break;
+        }
+        i++;
+    }
+
+    munmap(out, size);
+    close(fd);
+    free(line);
+    fclose(in);
+    printf("%s: N=%llu, D=%d, tipo=%s\n", argv[2], (unsigned long long)n, d,
+           dtype == DTYPE_F32 ? "float32" : "float64");
+    return 0;
+}
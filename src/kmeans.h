@@ -0,0 +1,509 @@
+#ifndef KMEANS_H
+#define KMEANS_H
+
+// Tipos e funções compartilhados pelos módulos da versão paralela (v3)
+
+#include <stddef.h>
+#include <stdint.h>
+#include <omp.h>
+
+#define DEFAULT_K 50                // Número padrão de centróides
+#define DEFAULT_D 2                 // Número padrão de dimensões
+#define MAX_D 4096                  // Maior D aceito (vetores de um ponto vão para a pilha)
+#define ASSIGN_BLOCK 4096           // Pontos por bloco no laço de atribuição
+#define ALIGNMENT 64                // Alinhamento (em bytes) dos vetores de pontos
+#define MPI_CHUNKS 4                // Faixas de centróides somadas entre processos MPI em paralelo
+#define MAX_RESTARTS 256            // Maior n_init (reinícios avançados juntos na mesma passada)
+
+// Rótulo do cluster de cada ponto: tipo estreito para reduzir o tráfego de memória
+typedef uint16_t label_t;
+#define NO_LABEL ((label_t)UINT16_MAX) // Ponto ainda sem cluster
+#define MAX_K    ((int)UINT16_MAX - 1)  // Maior K representável em label_t
+
+// Kernels especializados: K é arredondado para um múltiplo de K_PAD (até SPECIAL_MAX_K)
+// e os centróides excedentes são sentinelas no infinito, que nunca vencem o argmin
+#define K_PAD         8
+#define SPECIAL_MAX_K 64
+
+// Precisão das coordenadas no laço principal. Em PREC_F32 os pontos ficam em
+// float32 (metade do tráfego de memória e o dobro de pontos por registrador SIMD)
+// e as distâncias são calculadas em float; as somas por centróide continuam em double.
+// Em PREC_Q16 cada coordenada é um inteiro de 16 bits relativo à caixa envolvente da
+// dimensão (um quarto do tráfego do double), decodificado para float nos kernels
+enum { PREC_F64, PREC_F32, PREC_Q16 };
+#define Q16_MAX UINT16_MAX          // Maior valor quantizado (a caixa tem Q16_MAX passos)
+
+// Amostras da pipeline grossa-para-fina (kmeans_coarse.c): nenhuma (inicialização e
+// laço sobre todos os pontos), uniformes ou por importância
+enum { COARSE_NONE, COARSE_UNIFORM, COARSE_IMPORTANCE };
+
+// Limitantes por bloco de ASSIGN_BLOCK pontos, usados com a reordenação por cluster
+// (kmeans_reorder.c). Um bloco uniforme (todos os pontos no mesmo cluster) guarda um
+// limitante superior da distância dos seus pontos ao centróide do cluster; quando
+// ele prova que nenhum ponto muda de cluster, o bloco é marcado em skip e a
+// atribuição não calcula distâncias
+typedef struct {
+    int            num_blocks;
+    label_t       *label;   // Cluster de todos os pontos do bloco, ou NO_LABEL se misto
+    double        *radius;  // Limitante superior da distância ao centróide do cluster
+    unsigned char *skip;    // 1 se o bloco mantém o cluster na iteração atual
+} BlockBounds;
+
+// Pontos D-dimensionais em layout SoA (structure of arrays): cada coordenada em um
+// vetor contíguo (coluna), o que permite carregar 4 ou 8 pontos de uma vez em um
+// registrador SIMD. A coluna c começa em coords + c * stride; stride arredonda n
+// para um múltiplo de ALIGNMENT bytes, então todas as colunas ficam alinhadas.
+// Em precisão simples as colunas estão em coords32 (com o passo de float) e coords
+// é NULL. Em PREC_Q16 estão em coords16 (com o passo de uint16_t), e a coordenada
+// c do ponto vale q_lo[c] + q * q_step[c]. blocks só existe com a reordenação por
+// cluster (NULL caso contrário)
+typedef struct {
+    double   *coords;
+    float    *coords32;
+    label_t  *labels;
+    int       n;
+    int       d;
+    size_t    stride;
+    uint16_t *coords16;
+    float    *q_lo;
+    float    *q_step;
+    BlockBounds *blocks;
+} Points;
+
+// Centróides em linhas (k x d): as coordenadas de um centróide ficam juntas e são
+// lidas via broadcast pelos kernels de atribuição. Há linhas sentinela até
+// round_up(k, K_PAD), com coordenadas infinitas. pos32 é a cópia em float32 lida
+// pelos kernels de precisão simples, atualizada por centroids_to_f32()
+typedef struct {
+    double *pos;
+    float  *pos32;
+    int     k;
+    int     d;
+} Centroids;
+
+// Somas das coordenadas (k x d) e contagem de pontos por centróide. As somas
+// globais de uma execução também guardam a arena de parciais por thread (locals),
+// alocada na primeira iteração por thread_sums() e reaproveitada nas seguintes
+typedef struct Sums {
+    double      *sum;
+    int         *count;
+    int          k;
+    int          d;
+    struct Sums *locals;      // Parciais de cada thread, ou NULL
+    void        *arena;       // Memória única das parciais
+    int          num_locals;
+    int          num_nodes;   // Fatias por nó NUMA depois das das threads (0 sem NUMA)
+} Sums;
+
+// Reordenação periódica dos pontos por cluster (kmeans_reorder.c). A cada period
+// iterações os pontos são ordenados pelo rótulo (counting sort estável) em um de
+// dois buffers, alternadamente; perm guarda o índice original de cada posição, para
+// devolver os rótulos na ordem do chamador ao final do fit
+typedef struct {
+    int         period;     // Reordena a cada period iterações (0 = nunca)
+    void       *buf[2];     // Cópias ordenadas dos pontos (buffer duplo)
+    size_t      buf_cap;
+    int         current;    // Buffer com os pontos atuais, ou -1 (ordem original)
+    label_t    *labels;     // Segundo vetor de rótulos (alterna com o do chamador)
+    int        *perm;       // Índice original do ponto em cada posição
+    int        *order;      // Origem de cada posição na ordenação em curso
+    int         cap;        // Capacidade (em pontos) de labels, perm e order
+    BlockBounds blocks;
+    int         blocks_cap;
+    Centroids   prev;       // Centróides da iteração anterior
+    double     *drift;      // Deslocamento de cada centróide desde a iteração anterior
+    double     *half_min;   // Metade da distância de cada centróide ao centróide mais próximo
+    int         planned;    // 1 depois da primeira iteração do fit
+    double      tol;        // Folga absoluta do teste dos blocos
+    int         reorders;   // Reordenações, tempo gasto nelas e blocos pulados no fit atual
+    double      time;
+    long long   skipped;
+    long long   checked;
+} Reorder;
+
+// Disposição das threads nos nós NUMA (modo NUMA, ver kmeans_numa.c). Os nós são
+// renumerados 0, 1, ... na ordem da primeira thread de cada um; node_id guarda o
+// número do nó no sistema. As threads do nó n são node_members[node_offset[n] ..
+// node_offset[n + 1]), em ordem de thread, e node_rank é a posição de cada uma ali
+typedef struct {
+    int  enabled;
+    int  num_nodes;
+    int  num_threads;
+    int *thread_node;
+    int *node_rank;
+    int *node_members;
+    int *node_offset;
+    int *node_id;
+} NumaLayout;
+
+// Fluxo de pontos sintéticos (kmeans_stream.c): o ponto i é gerado a partir da
+// semente e da posição i, sem guardar o conjunto inteiro na memória. Os pontos são
+// uniformes em [0, 100] ou, com blobs > 0, gaussianos em torno de blobs centros
+// sorteados em [0, 100], com desvio spread em cada dimensão; o blob j recebe uma
+// fração dos pontos proporcional a 1 / (j + 1)^imbalance
+#define STREAM_CHUNK ASSIGN_BLOCK   // Pontos gerados por vez em cada thread
+typedef struct {
+    unsigned int seed;
+    long long    n;
+    int          d;
+    int          blobs;      // 0 = uniforme
+    double       spread;
+    double       imbalance;
+    double      *centers;    // blobs x d
+    double      *cum;        // Frações acumuladas dos blobs
+} PointStream;
+
+// Resultado da pipeline grossa-para-fina
+typedef struct {
+    int       levels;     // Amostras percorridas (0 = N pequeno demais, a pipeline não rodou)
+    int       iterations; // Iterações somadas de todos os níveis
+    long long points;     // Tamanho da maior amostra (somado entre os processos)
+    double    init;       // Tempo da inicialização, feita sobre a primeira amostra
+    double    time;       // Tempo dos níveis (sorteio das amostras e iterações)
+} CoarseStats;
+
+// Estado da atualização incremental (kmeans_incremental.c). Cada ponto ativo tem uma
+// folga gap: a menor distância aos outros centróides menos a distância ao seu, medida
+// quando o estado foi montado. Os pontos de cada cluster ficam em uma lista ordenada
+// pela folga; drift[j] soma os deslocamentos do centróide j desde a montagem e
+// drift_max os maiores deslocamentos de cada passo. Enquanto gap >= drift[j] +
+// drift_max, o ponto continua provadamente em j, então só o início de cada lista
+// (visited[j] pontos, que só cresce) e os pontos novos são reavaliados com distâncias.
+// Esses ficam em cand, na ordem em que entraram, com as coordenadas copiadas para work
+// (rotulada pelo kernel de atribuição a cada passo)
+typedef struct {
+    float gap;
+    int   index;
+} GapEntry;
+
+typedef struct {
+    int        ready;      // 1 se o estado corresponde aos centróides e rótulos do contexto
+    int        k, d;
+    int        n;          // Pontos cobertos (os do último fit ou atualização, removidos inclusive)
+    double    *sum;        // Somas das coordenadas dos pontos ativos de cada cluster (k x d)
+    long long *count;      // Pontos ativos de cada cluster
+    GapEntry  *entries;    // Listas dos clusters, uma após a outra
+    int        entries_cap;
+    int       *start;      // Início da lista de cada cluster em entries (k + 1)
+    int       *visited;    // Pontos do início de cada lista em reavaliação
+    double    *drift;
+    double     drift_max;
+    int       *cand;       // Pontos em reavaliação
+    int        num_cand;
+    int        cand_cap;
+    Points     work;       // Cópia compacta das coordenadas dos pontos em cand
+} Incremental;
+
+// Resultado de uma atualização incremental
+typedef struct {
+    int       iterations; // Passos locais até nenhum ponto reavaliado mudar de cluster (ou max_iter)
+    long long candidates; // Pontos reavaliados com distâncias, somados nos passos
+    double    rebuild;    // Tempo da remontagem do estado (0 se não houve)
+} IncStats;
+
+// Formato binário de conjuntos de pontos (little-endian): cabeçalho de 64 bytes
+// seguido das D colunas de coordenadas, uma após a outra (column-major, igual ao
+// layout SoA de Points). Cada coluna ocupa N valores do tipo dtype e é completada
+// até um múltiplo de ALIGNMENT bytes, então todas começam alinhadas no mapeamento
+#define DATASET_MAGIC "KMDS0001"
+#define DTYPE_F64 0u
+#define DTYPE_F32 1u
+typedef struct {
+    char     magic[8];      // DATASET_MAGIC (sem o terminador)
+    uint64_t n;             // Número de pontos
+    uint32_t d;             // Dimensões
+    uint32_t dtype;         // DTYPE_F64 ou DTYPE_F32
+    uint8_t  reserved[40];  // Completa 64 bytes (zerado)
+} DatasetHeader;
+
+// Conjunto de pontos carregado de arquivo. Com mmap e float64, pts.coords aponta
+// para o mapeamento (somente leitura); pts.labels não é usado aqui. Aberto em
+// partes (versão MPI), pts tem só os pontos [first, first + pts.n) dos total_n
+typedef struct {
+    Points  pts;
+    int     first;
+    int     total_n;
+    void   *map;            // Mapeamento do arquivo (NULL se os pontos foram copiados)
+    size_t  map_size;
+    int     owns_coords;    // 1 se pts.coords foi alocado (leitura ou float32)
+} Dataset;
+
+// Leitura de um dataset em lotes por uma thread de E/S, com um conjunto fixo de
+// buffers reaproveitados (kmeans_dataset.c). Cada lote entregue por chunks_next vale
+// até a próxima chamada
+#define CHUNK_MAX_BUFFERS 8         // Maior número de buffers de uma leitura em lotes
+#define CHUNK_BUFFERS     3         // Buffers padrão: um em cálculo e dois sendo lidos
+typedef struct ChunkReader ChunkReader;
+
+// Kernel de atribuição: rotula os pontos [begin, end) e retorna quantos mudaram de cluster.
+// Se acc != NULL, cada ponto também é somado em acc na mesma passada (engine fused).
+typedef int (*assign_kernel_fn)(const Points *pts, int begin, int end, const Centroids *c, Sums *acc);
+
+// Engine de iteração. create (opcional) aloca o estado persistente entre iterações;
+// iterate atribui os pontos aos centróides (twopass e fused com o kernel recebido,
+// escolhido pelo contexto conforme D, K e a precisão), preenche as somas globais por
+// centróide e retorna quantos pontos mudaram de cluster (ou -1 se faltar memória);
+// destroy libera o estado. f32 indica se a engine aceita pontos em float32. As
+// engines sem estado por ponto (create == NULL) aceitam a reordenação por cluster.
+typedef struct {
+    const char *name;
+    void *(*create)(const Points *pts, int k);
+    int   (*iterate)(void *state, Points *pts, const Centroids *c, assign_kernel_fn kernel, Sums *sums);
+    void  (*destroy)(void *state);
+    int   f32;
+} Engine;
+
+// Inicialização dos centróides: escolhe as c->k posições iniciais a partir dos
+// pontos e da semente. Retorna 0, ou -1 se faltar memória.
+typedef struct {
+    const char *name;
+    int (*init)(const Points *pts, Centroids *c, unsigned int seed);
+} Initializer;
+
+// Distância (em doubles) entre as colunas de n pontos
+static inline size_t points_stride(int n) {
+    size_t per_line = ALIGNMENT / sizeof(double);
+    return ((size_t)n + per_line - 1) / per_line * per_line;
+}
+
+// Distância (em floats) entre as colunas de n pontos em precisão simples
+static inline size_t points_stride32(int n) {
+    size_t per_line = ALIGNMENT / sizeof(float);
+    return ((size_t)n + per_line - 1) / per_line * per_line;
+}
+
+// Distância (em uint16_t) entre as colunas de n pontos quantizados
+static inline size_t points_stride16(int n) {
+    size_t per_line = ALIGNMENT / sizeof(uint16_t);
+    return ((size_t)n + per_line - 1) / per_line * per_line;
+}
+
+// Coluna c (coordenada c de todos os pontos)
+static inline double *point_col(const Points *pts, int c) {
+    return pts->coords + (size_t)c * pts->stride;
+}
+
+// Coluna c em precisão simples
+static inline float *point_col32(const Points *pts, int c) {
+    return pts->coords32 + (size_t)c * pts->stride;
+}
+
+// Coordenada c do ponto quantizado i, decodificada em double
+static inline double point_q16(const Points *pts, int c, int i) {
+    return (double)pts->q_lo[c] + pts->coords16[(size_t)c * pts->stride + i] * (double)pts->q_step[c];
+}
+
+// Copia as coordenadas do ponto i para p (d posições)
+static inline void load_point(const Points *pts, int i, double *p) {
+    for (int c = 0; c < pts->d; c++) p[c] = pts->coords[(size_t)c * pts->stride + i];
+}
+
+// Coordenadas do centróide j
+static inline double *centroid(const Centroids *c, int j) {
+    return c->pos + (size_t)j * c->d;
+}
+
+// Função para calcular a distância euclidiana ao quadrado. A soma começa do zero
+// na ordem das coordenadas, a mesma dos kernels SIMD, para os resultados baterem
+static inline double distance_sq(const double *p, const double *q, int d) {
+    double s = 0.0;
+    for (int c = 0; c < d; c++) {
+        double t = p[c] - q[c];
+        s += t * t;
+    }
+    return s;
+}
+
+// Soma o ponto p (d coordenadas) nas somas do centróide j
+static inline void accumulate(Sums *s, int j, const double *p) {
+    double *row = s->sum + (size_t)j * s->d;
+    for (int c = 0; c < s->d; c++) row[c] += p[c];
+    s->count[j]++;
+}
+
+// Parte [first, last) de num_blocks blocos que cabe à thread t de um time de
+// num_threads: faixas contíguas, as r primeiras com um bloco a mais (a mesma
+// divisão do schedule(static) sem chunk do libgomp)
+static inline void block_share(int num_blocks, int t, int num_threads, int *first, int *last) {
+    int q = num_blocks / num_threads, r = num_blocks % num_threads;
+    *first = t * q + (t < r ? t : r);
+    *last  = *first + q + (t < r);
+}
+
+// Parte dos blocos da thread atual. Todos os laços que tocam os pontos usam esta
+// divisão, então cada thread lê sempre as mesmas páginas (as do seu nó NUMA)
+static inline void thread_blocks(int num_blocks, int *first, int *last) {
+    block_share(num_blocks, omp_get_thread_num(), omp_get_num_threads(), first, last);
+}
+
+// Instrumentação por iteração (ver kmeans_trace.c), ligada com KMEANS_TRACE (make
+// TRACE=1). Sem ela as macros não geram código. TRACE_MARK fecha a fase atual da
+// iteração (só a thread mestre marca); TRACE_BUSY, chamada por cada thread antes da
+// barreira que fecha a passada sobre os pontos, registra o tempo ocupado da thread
+enum { TRACE_ASSIGN, TRACE_ACCUMULATE, TRACE_MERGE, TRACE_UPDATE, TRACE_REORDER, TRACE_PHASES };
+#ifdef KMEANS_TRACE
+#define TRACE_RUN_BEGIN(engine, threads) trace_run_begin(engine, threads)
+#define TRACE_RUN_END()                  trace_run_end()
+#define TRACE_ITER_BEGIN()               trace_iter_begin()
+#define TRACE_ITER_END(changed)          trace_iter_end(changed)
+#define TRACE_MARK(p)                    do { if (omp_get_thread_num() == 0) trace_mark(p); } while (0)
+#define TRACE_BUSY()                     trace_busy()
+#else
+#define TRACE_RUN_BEGIN(engine, threads) ((void)0)
+#define TRACE_RUN_END()                  ((void)0)
+#define TRACE_ITER_BEGIN()               ((void)0)
+#define TRACE_ITER_END(changed)          ((void)0)
+#define TRACE_MARK(p)                    ((void)0)
+#define TRACE_BUSY()                     ((void)0)
+#endif
+
+// Mínimo e máximo sem tratamento de NaN: fmin/fmax viram chamadas de biblioteca
+// em -std=c99, o que pesa nos laços internos das engines com limitantes
+static inline double dmin(double a, double b) { return a < b ? a : b; }
+static inline double dmax(double a, double b) { return a > b ? a : b; }
+
+// kmeans_data.c
+void *alloc_aligned(size_t bytes);
+int   alloc_points(Points *pts, int num_points, int d);
+void  free_points(Points *pts);
+int   alloc_centroids(Centroids *c, int k, int d);
+void  free_centroids(Centroids *c);
+void  copy_centroids(Centroids *dst, const Centroids *src);
+int   alloc_sums(Sums *s, int k, int d);
+void  free_sums(Sums *s);
+void  clear_sums(Sums *s);
+void  update_centroids(Centroids *c, const Sums *s);
+void  centroids_to_f32(Centroids *c);
+void  convert_points_f32(const Points *src, Points *dst);
+void  convert_points_q16(const Points *src, Points *dst);
+Sums *thread_sums(Sums *s);
+void  reduce_thread_sums(Sums *s);
+
+// kmeans_assign.c
+// Conjuntos de instruções dos kernels, do detectado por detect_simd() para baixo
+enum { SIMD_SCALAR, SIMD_AVX2, SIMD_AVX512, NUM_SIMD };
+int assign_scalar(const Points *pts, int begin, int end, const Centroids *c, Sums *acc);
+const char      *detect_simd(void);
+assign_kernel_fn select_assign_kernel(int d, int k, int precision, int *specialized);
+assign_kernel_fn select_label_kernel(int d, int k);
+int              current_simd(void);
+
+// kmeans_init.c
+int init_random(const Points *pts, Centroids *c, unsigned int seed);
+int init_kmeans_parallel(const Points *pts, Centroids *c, unsigned int seed);
+
+// kmeans_coarse.c
+int coarse_fit(const Initializer *ini, const Points *pts, Centroids *c, unsigned int seed, int mode,
+               int max_iter, CoarseStats *stats);
+
+// kmeans_incremental.c
+int  inc_build(Incremental *s, const Points *pts, const Centroids *c);
+int  inc_update(Incremental *s, const Points *pts, const int *removed, int num_removed, Centroids *c,
+                assign_kernel_fn kernel, int max_iter, IncStats *stats);
+void inc_gaps(const Incremental *s, float *gap);
+int  inc_restore(Incremental *s, int k, int d, int n, const double *sum, const long long *count,
+                 const label_t *labels, const float *gap);
+void inc_free(Incremental *s);
+
+// kmeans_lloyd.c
+int iterate_twopass(void *state, Points *pts, const Centroids *c, assign_kernel_fn kernel, Sums *sums);
+int iterate_fused(void *state, Points *pts, const Centroids *c, assign_kernel_fn kernel, Sums *sums);
+int iterate_restarts(Points *pts, label_t *const *labels, const Centroids *c, assign_kernel_fn kernel,
+                     Sums *sums, const int *active, int num_restarts, int *changed);
+
+// kmeans_bounds.c
+double bound_tolerance(const Points *pts);
+void *hamerly_create(const Points *pts, int k);
+void *elkan_create(const Points *pts, int k);
+int   iterate_bounds(void *state, Points *pts, const Centroids *c, assign_kernel_fn kernel, Sums *sums);
+void  bounds_destroy(void *state);
+
+// kmeans_gemm.c
+void *gemm_create(const Points *pts, int k);
+int   iterate_gemm(void *state, Points *pts, const Centroids *c, assign_kernel_fn kernel, Sums *sums);
+void  gemm_destroy(void *state);
+
+// kmeans_yinyang.c
+void *yinyang_create(const Points *pts, int k);
+int   iterate_yinyang(void *state, Points *pts, const Centroids *c, assign_kernel_fn kernel, Sums *sums);
+void  yinyang_destroy(void *state);
+
+// kmeans_stream.c
+int    stream_init(PointStream *s, unsigned int seed, long long n, int d, int blobs, double spread, double imbalance);
+void   stream_free(PointStream *s);
+void   stream_fill(const PointStream *s, long long first, Points *batch);
+double sample_uniform(unsigned int seed, unsigned int sequence, long long id);
+
+// kmeans_minibatch.c
+void   minibatch_update(Centroids *c, const Sums *batch_sums, long long *seen);
+double batch_inertia(const Points *pts, const Centroids *c);
+
+// kmeans_reorder.c
+int  reorder_begin(Reorder *r, const Points *pts, int k, int precision);
+void reorder_plan(Reorder *r, const Centroids *c);
+int  reorder_points(Reorder *r, Points *pts, const Centroids *c, label_t *labels);
+void reorder_restore(Reorder *r, const Points *pts, label_t *labels);
+void reorder_free(Reorder *r);
+void block_refresh(const Points *pts, const Centroids *c, int b);
+void accumulate_runs(const Points *pts, int begin, int end, Sums *local);
+
+// kmeans_dataset.c
+size_t dataset_column_bytes(uint64_t n, uint32_t dtype);
+int    dataset_open(Dataset *ds, const char *path, int use_mmap);
+int    dataset_open_part(Dataset *ds, const char *path, int use_mmap, int part, int num_parts);
+void   dataset_close(Dataset *ds);
+ChunkReader *chunks_open(const char *path, int chunk, int num_buffers);
+void         chunks_close(ChunkReader *r);
+int          chunks_points(const ChunkReader *r);
+int          chunks_dims(const ChunkReader *r);
+int          chunks_size(const ChunkReader *r);
+int          chunks_start(ChunkReader *r);
+int          chunks_next(ChunkReader *r, Points **chunk, long long *first);
+void         chunks_times(ChunkReader *r, double *io_time, double *wait_time);
+
+// kmeans_numa.c
+extern NumaLayout numa_layout;
+int  numa_setup(int num_threads);
+void numa_bind_points(const Points *pts);
+void numa_release(void);
+
+// kmeans_trace.c
+void trace_run_begin(const char *engine, int threads);
+void trace_run_end(void);
+void trace_iter_begin(void);
+void trace_iter_end(int changed);
+void trace_mark(int p);
+void trace_busy(void);
+
+// kmeans_lib.c (engines e inicializações disponíveis; a API pública está em libkmeans.h)
+extern const Engine      engines[];
+extern const int         num_engines;
+extern const Initializer initializers[];
+extern const int         num_initializers;
+const Engine      *find_engine(const char *name);
+const Initializer *find_initializer(const char *name);
+
+// kmeans_mpi.c
+int    mpi_start(int *argc, char ***argv);
+void   mpi_finish(void);
+void   mpi_fail(void);
+int    mpi_rank(void);
+int    mpi_ranks(void);
+int    mpi_world_size(void);
+int    mpi_use_ranks(int count);
+double mpi_sum(double value);
+double mpi_max(double value);
+void   mpi_sum_array(double *values, int count);
+long long mpi_offset(long long count);
+void   mpi_post_sums(Sums *s, int first, int last);
+void   mpi_wait_sums(void);
+void   mpi_post_changed(int *changed);
+void   mpi_wait_changed(void);
+int    mpi_init_centroids(const Initializer *ini, const Points *pts, Centroids *c, unsigned int seed);
+
+// kmeans_kdtree.c
+void *kdtree_create(const Points *pts, int k);
+int   iterate_kdtree(void *state, Points *pts, const Centroids *c, assign_kernel_fn kernel, Sums *sums);
+void  kdtree_destroy(void *state);
+
+#endif
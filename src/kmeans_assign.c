@@ -0,0 +1,565 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KMEANS_X86 1
+#endif
+
+#include "kmeans.h"
+
+// Kernels de atribuição. Cada kernel é escrito uma vez como um corpo inline com D
+// (dimensões) e K (centróides) como parâmetros; as versões especializadas chamam o
+// corpo com D e K constantes, e o compilador desenrola os laços de coordenadas e de
+// centróides como fazia quando os dois eram #define. A versão genérica chama o mesmo
+// corpo com os valores de tempo de execução. Cada corpo existe em double e em float
+// (PREC_F32); na versão em float as distâncias e o argmin são em float e as somas
+// por centróide continuam em double. A versão em float também atende PREC_Q16: as
+// coordenadas de 16 bits são decodificadas para float nos registradores (x = q_lo +
+// q * q_step) ao serem carregadas, e o resto do corpo é o mesmo.
+
+#define ALWAYS_INLINE inline __attribute__((always_inline))
+
+// Até REG_D dimensões, os corpos SIMD carregam as coordenadas do grupo de pontos
+// uma vez e as mantêm em registradores durante todo o laço de centróides
+#define REG_D 8
+
+// Conjunto de instruções detectado (ou forçado via KMEANS_SIMD) por detect_simd()
+static int simd_level = SIMD_SCALAR;
+
+// Corpo escalar (fallback): o argmin usa seleção condicional em vez de desvio, o que
+// o compilador traduz em cmov e evita o branch mal predito de "if (d2 < minDist)".
+// Com COUNT = 0 os rótulos só são gravados, sem ler os anteriores (e o retorno é 0)
+static ALWAYS_INLINE int scalar_body_count(const Points *pts, int begin, int end, const Centroids *c,
+                                           Sums *acc, const int D, const int K, const int COUNT) {
+    const double *cols = pts->coords;
+    size_t stride = pts->stride;
+    int changed = 0;
+
+    for (int i = begin; i < end; i++) {
+        double minDist = INFINITY;
+        int bestCluster = 0;
+
+        for (int j = 0; j < K; j++) {
+            const double *cj = c->pos + (size_t)j * D;
+            double d2 = 0.0;
+            for (int d = 0; d < D; d++) {
+                double t = cols[d * stride + i] - cj[d];
+                d2 += t * t;
+            }
+            bestCluster = (d2 < minDist) ? j  : bestCluster;
+            minDist     = (d2 < minDist) ? d2 : minDist;
+        }
+
+        if (COUNT) changed += (pts->labels[i] != bestCluster);
+        pts->labels[i] = (label_t)bestCluster;
+
+        if (acc != NULL) {
+            double *row = acc->sum + (size_t)bestCluster * D;
+            for (int d = 0; d < D; d++) row[d] += cols[d * stride + i];
+            acc->count[bestCluster]++;
+        }
+    }
+    return changed;
+}
+
+static ALWAYS_INLINE int scalar_body(const Points *pts, int begin, int end, const Centroids *c,
+                                     Sums *acc, const int D, const int K) {
+    return scalar_body_count(pts, begin, end, c, acc, D, K, 1);
+}
+
+static ALWAYS_INLINE int scalar_body_store(const Points *pts, int begin, int end, const Centroids *c,
+                                           Sums *acc, const int D, const int K) {
+    return scalar_body_count(pts, begin, end, c, acc, D, K, 0);
+}
+
+// Coordenada d do ponto i em float: lida das colunas float32 ou, com Q16,
+// decodificada dos 16 bits (multiplicação e soma separadas, como nos corpos SIMD)
+static ALWAYS_INLINE float load_single(const Points *pts, int d, int i, const int Q16) {
+    return Q16 ? (float)pts->coords16[d * pts->stride + i] * pts->q_step[d] + pts->q_lo[d]
+               : pts->coords32[d * pts->stride + i];
+}
+
+// Coordenada d do ponto i em double, para as somas por centróide, conforme a
+// precisão dos pontos (PREC_F64, PREC_F32 ou PREC_Q16)
+static ALWAYS_INLINE double load_sum_value(const Points *pts, int d, int i, const int PREC) {
+    size_t at = (size_t)d * pts->stride + i;
+    return PREC == PREC_Q16 ? (double)pts->q_lo[d] + pts->coords16[at] * (double)pts->q_step[d]
+         : PREC == PREC_F32 ? (double)pts->coords32[at] : pts->coords[at];
+}
+
+// Corpo escalar em precisão simples: distâncias em float, somas em double
+static ALWAYS_INLINE int scalar_body_single(const Points *pts, int begin, int end, const Centroids *c,
+                                            Sums *acc, const int D, const int K, const int Q16) {
+    int changed = 0;
+
+    for (int i = begin; i < end; i++) {
+        float minDist = INFINITY;
+        int bestCluster = 0;
+
+        for (int j = 0; j < K; j++) {
+            const float *cj = c->pos32 + (size_t)j * D;
+            float d2 = 0.0f;
+            for (int d = 0; d < D; d++) {
+                float t = load_single(pts, d, i, Q16) - cj[d];
+                d2 += t * t;
+            }
+            bestCluster = (d2 < minDist) ? j  : bestCluster;
+            minDist     = (d2 < minDist) ? d2 : minDist;
+        }
+
+        changed += (pts->labels[i] != bestCluster);
+        pts->labels[i] = (label_t)bestCluster;
+
+        if (acc != NULL) {
+            double *row = acc->sum + (size_t)bestCluster * D;
+            for (int d = 0; d < D; d++) row[d] += load_sum_value(pts, d, i, Q16 ? PREC_Q16 : PREC_F32);
+            acc->count[bestCluster]++;
+        }
+    }
+    return changed;
+}
+
+static ALWAYS_INLINE int scalar_body_f32(const Points *pts, int begin, int end, const Centroids *c,
+                                         Sums *acc, const int D, const int K) {
+    return scalar_body_single(pts, begin, end, c, acc, D, K, 0);
+}
+
+static ALWAYS_INLINE int scalar_body_q16(const Points *pts, int begin, int end, const Centroids *c,
+                                         Sums *acc, const int D, const int K) {
+    return scalar_body_single(pts, begin, end, c, acc, D, K, 1);
+}
+
+#ifdef KMEANS_X86
+// Grava os rótulos calculados em SIMD a partir do ponto i, conta quantos mudaram
+// (se COUNT) e, se acc != NULL, acumula os pontos (lidos conforme PREC) nas somas
+// dos seus novos clusters
+static ALWAYS_INLINE int store_labels(const Points *pts, int i, const int *best, int lanes,
+                                      Sums *acc, const int D, const int PREC, const int COUNT) {
+    int changed = 0;
+    for (int l = 0; l < lanes; l++) {
+        if (COUNT) changed += (pts->labels[i + l] != best[l]);
+        pts->labels[i + l] = (label_t)best[l];
+    }
+    if (acc != NULL) {
+        for (int l = 0; l < lanes; l++) {
+            double *row = acc->sum + (size_t)best[l] * D;
+            for (int d = 0; d < D; d++) row[d] += load_sum_value(pts, d, i + l, PREC);
+            acc->count[best[l]]++;
+        }
+    }
+    return changed;
+}
+
+// Corpo AVX2: 4 pontos por registrador contra cada centróide em broadcast.
+// Processa dois grupos de 4 pontos por vez para esconder a latência da cadeia do argmin.
+// Não usa FMA de propósito: assim as distâncias são idênticas às do kernel escalar
+// e os rótulos não dependem do kernel escolhido.
+__attribute__((target("avx2")))
+static ALWAYS_INLINE int avx2_body_count(const Points *pts, int begin, int end, const Centroids *c,
+                                         Sums *acc, const int D, const int K, const int COUNT) {
+    const double *cols = pts->coords;
+    size_t stride = pts->stride;
+    int changed = 0;
+    int i = begin;
+
+    for (; i + 8 <= end; i += 8) {
+        __m256d best0 = _mm256_set1_pd(INFINITY), best1 = best0;
+        __m256d idx0  = _mm256_setzero_pd(),      idx1  = idx0;
+
+        __m256d p0[REG_D], p1[REG_D];
+        for (int d = 0; d < D && D <= REG_D; d++) {
+            p0[d] = _mm256_loadu_pd(cols + d * stride + i);
+            p1[d] = _mm256_loadu_pd(cols + d * stride + i + 4);
+        }
+
+        for (int j = 0; j < K; j++) {
+            const double *cj = c->pos + (size_t)j * D;
+            __m256d d0 = _mm256_setzero_pd(), d1 = d0;
+            #pragma GCC unroll 8
+            for (int d = 0; d < D; d++) {
+                __m256d cd = _mm256_broadcast_sd(&cj[d]);
+                __m256d x0 = (D <= REG_D) ? p0[d] : _mm256_loadu_pd(cols + d * stride + i);
+                __m256d x1 = (D <= REG_D) ? p1[d] : _mm256_loadu_pd(cols + d * stride + i + 4);
+                __m256d t0 = _mm256_sub_pd(x0, cd);
+                __m256d t1 = _mm256_sub_pd(x1, cd);
+                d0 = _mm256_add_pd(d0, _mm256_mul_pd(t0, t0));
+                d1 = _mm256_add_pd(d1, _mm256_mul_pd(t1, t1));
+            }
+            __m256d cj_idx = _mm256_set1_pd((double)j);
+
+            // Argmin sem desvio: máscara de comparação + blend do índice
+            __m256d lt0 = _mm256_cmp_pd(d0, best0, _CMP_LT_OQ);
+            __m256d lt1 = _mm256_cmp_pd(d1, best1, _CMP_LT_OQ);
+            best0 = _mm256_blendv_pd(best0, d0, lt0);
+            best1 = _mm256_blendv_pd(best1, d1, lt1);
+            idx0  = _mm256_blendv_pd(idx0, cj_idx, lt0);
+            idx1  = _mm256_blendv_pd(idx1, cj_idx, lt1);
+        }
+
+        int best[8];
+        _mm_storeu_si128((__m128i *)best,       _mm256_cvttpd_epi32(idx0));
+        _mm_storeu_si128((__m128i *)(best + 4), _mm256_cvttpd_epi32(idx1));
+        changed += store_labels(pts, i, best, 8, acc, D, PREC_F64, COUNT);
+    }
+
+    // Pontos restantes (menos de um grupo completo)
+    return changed + scalar_body_count(pts, i, end, c, acc, D, K, COUNT);
+}
+
+__attribute__((target("avx2")))
+static ALWAYS_INLINE int avx2_body(const Points *pts, int begin, int end, const Centroids *c,
+                                   Sums *acc, const int D, const int K) {
+    return avx2_body_count(pts, begin, end, c, acc, D, K, 1);
+}
+
+__attribute__((target("avx2")))
+static ALWAYS_INLINE int avx2_body_store(const Points *pts, int begin, int end, const Centroids *c,
+                                         Sums *acc, const int D, const int K) {
+    return avx2_body_count(pts, begin, end, c, acc, D, K, 0);
+}
+
+// Corpo AVX-512: 8 pontos por registrador, argmin via registradores de máscara
+__attribute__((target("avx512f")))
+static ALWAYS_INLINE int avx512_body_count(const Points *pts, int begin, int end, const Centroids *c,
+                                           Sums *acc, const int D, const int K, const int COUNT) {
+    const double *cols = pts->coords;
+    size_t stride = pts->stride;
+    int changed = 0;
+    int i = begin;
+
+    for (; i + 16 <= end; i += 16) {
+        __m512d best0 = _mm512_set1_pd(INFINITY), best1 = best0;
+        __m512d idx0  = _mm512_setzero_pd(),      idx1  = idx0;
+
+        __m512d p0[REG_D], p1[REG_D];
+        for (int d = 0; d < D && D <= REG_D; d++) {
+            p0[d] = _mm512_loadu_pd(cols + d * stride + i);
+            p1[d] = _mm512_loadu_pd(cols + d * stride + i + 8);
+        }
+
+        for (int j = 0; j < K; j++) {
+            const double *cj = c->pos + (size_t)j * D;
+            __m512d d0 = _mm512_setzero_pd(), d1 = d0;
+            #pragma GCC unroll 8
+            for (int d = 0; d < D; d++) {
+                __m512d cd = _mm512_set1_pd(cj[d]);
+                __m512d x0 = (D <= REG_D) ? p0[d] : _mm512_loadu_pd(cols + d * stride + i);
+                __m512d x1 = (D <= REG_D) ? p1[d] : _mm512_loadu_pd(cols + d * stride + i + 8);
+                __m512d t0 = _mm512_sub_pd(x0, cd);
+                __m512d t1 = _mm512_sub_pd(x1, cd);
+                d0 = _mm512_add_pd(d0, _mm512_mul_pd(t0, t0));
+                d1 = _mm512_add_pd(d1, _mm512_mul_pd(t1, t1));
+            }
+            __m512d cj_idx = _mm512_set1_pd((double)j);
+
+            __mmask8 lt0 = _mm512_cmp_pd_mask(d0, best0, _CMP_LT_OQ);
+            __mmask8 lt1 = _mm512_cmp_pd_mask(d1, best1, _CMP_LT_OQ);
+            best0 = _mm512_mask_blend_pd(lt0, best0, d0);
+            best1 = _mm512_mask_blend_pd(lt1, best1, d1);
+            idx0  = _mm512_mask_blend_pd(lt0, idx0, cj_idx);
+            idx1  = _mm512_mask_blend_pd(lt1, idx1, cj_idx);
+        }
+
+        int best[16];
+        _mm256_storeu_si256((__m256i *)best,       _mm512_cvttpd_epi32(idx0));
+        _mm256_storeu_si256((__m256i *)(best + 8), _mm512_cvttpd_epi32(idx1));
+        changed += store_labels(pts, i, best, 16, acc, D, PREC_F64, COUNT);
+    }
+
+    return changed + scalar_body_count(pts, i, end, c, acc, D, K, COUNT);
+}
+
+__attribute__((target("avx512f")))
+static ALWAYS_INLINE int avx512_body(const Points *pts, int begin, int end, const Centroids *c,
+                                     Sums *acc, const int D, const int K) {
+    return avx512_body_count(pts, begin, end, c, acc, D, K, 1);
+}
+
+__attribute__((target("avx512f")))
+static ALWAYS_INLINE int avx512_body_store(const Points *pts, int begin, int end, const Centroids *c,
+                                           Sums *acc, const int D, const int K) {
+    return avx512_body_count(pts, begin, end, c, acc, D, K, 0);
+}
+
+// Carrega 8 coordenadas d a partir do ponto i em float (com Q16, decodificadas)
+__attribute__((target("avx2")))
+static ALWAYS_INLINE __m256 avx2_load_single(const Points *pts, int d, int i, const int Q16) {
+    if (Q16) {
+        __m128i q = _mm_loadu_si128((const __m128i *)(pts->coords16 + (size_t)d * pts->stride + i));
+        __m256  x = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(q));
+        return _mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(pts->q_step[d])), _mm256_set1_ps(pts->q_lo[d]));
+    }
+    return _mm256_loadu_ps(pts->coords32 + (size_t)d * pts->stride + i);
+}
+
+// Corpo AVX2 em precisão simples: 8 pontos por registrador, dois grupos por vez
+__attribute__((target("avx2")))
+static ALWAYS_INLINE int avx2_body_single(const Points *pts, int begin, int end, const Centroids *c,
+                                          Sums *acc, const int D, const int K, const int Q16) {
+    int changed = 0;
+    int i = begin;
+
+    for (; i + 16 <= end; i += 16) {
+        __m256 best0 = _mm256_set1_ps(INFINITY), best1 = best0;
+        __m256 idx0  = _mm256_setzero_ps(),      idx1  = idx0;
+
+        __m256 p0[REG_D], p1[REG_D];
+        for (int d = 0; d < D && D <= REG_D; d++) {
+            p0[d] = avx2_load_single(pts, d, i, Q16);
+            p1[d] = avx2_load_single(pts, d, i + 8, Q16);
+        }
+
+        for (int j = 0; j < K; j++) {
+            const float *cj = c->pos32 + (size_t)j * D;
+            __m256 d0 = _mm256_setzero_ps(), d1 = d0;
+            #pragma GCC unroll 8
+            for (int d = 0; d < D; d++) {
+                __m256 cd = _mm256_broadcast_ss(&cj[d]);
+                __m256 x0 = (D <= REG_D) ? p0[d] : avx2_load_single(pts, d, i, Q16);
+                __m256 x1 = (D <= REG_D) ? p1[d] : avx2_load_single(pts, d, i + 8, Q16);
+                __m256 t0 = _mm256_sub_ps(x0, cd);
+                __m256 t1 = _mm256_sub_ps(x1, cd);
+                d0 = _mm256_add_ps(d0, _mm256_mul_ps(t0, t0));
+                d1 = _mm256_add_ps(d1, _mm256_mul_ps(t1, t1));
+            }
+            // Índices até MAX_K são exatos em float
+            __m256 cj_idx = _mm256_set1_ps((float)j);
+
+            __m256 lt0 = _mm256_cmp_ps(d0, best0, _CMP_LT_OQ);
+            __m256 lt1 = _mm256_cmp_ps(d1, best1, _CMP_LT_OQ);
+            best0 = _mm256_blendv_ps(best0, d0, lt0);
+            best1 = _mm256_blendv_ps(best1, d1, lt1);
+            idx0  = _mm256_blendv_ps(idx0, cj_idx, lt0);
+            idx1  = _mm256_blendv_ps(idx1, cj_idx, lt1);
+        }
+
+        int best[16];
+        _mm256_storeu_si256((__m256i *)best,       _mm256_cvttps_epi32(idx0));
+        _mm256_storeu_si256((__m256i *)(best + 8), _mm256_cvttps_epi32(idx1));
+        changed += store_labels(pts, i, best, 16, acc, D, Q16 ? PREC_Q16 : PREC_F32, 1);
+    }
+
+    return changed + scalar_body_single(pts, i, end, c, acc, D, K, Q16);
+}
+
+__attribute__((target("avx2")))
+static ALWAYS_INLINE int avx2_body_f32(const Points *pts, int begin, int end, const Centroids *c,
+                                       Sums *acc, const int D, const int K) {
+    return avx2_body_single(pts, begin, end, c, acc, D, K, 0);
+}
+
+__attribute__((target("avx2")))
+static ALWAYS_INLINE int avx2_body_q16(const Points *pts, int begin, int end, const Centroids *c,
+                                       Sums *acc, const int D, const int K) {
+    return avx2_body_single(pts, begin, end, c, acc, D, K, 1);
+}
+
+// Carrega 16 coordenadas d a partir do ponto i em float (com Q16, decodificadas)
+__attribute__((target("avx512f")))
+static ALWAYS_INLINE __m512 avx512_load_single(const Points *pts, int d, int i, const int Q16) {
+    if (Q16) {
+        __m256i q = _mm256_loadu_si256((const __m256i *)(pts->coords16 + (size_t)d * pts->stride + i));
+        __m512  x = _mm512_cvtepi32_ps(_mm512_cvtepu16_epi32(q));
+        return _mm512_add_ps(_mm512_mul_ps(x, _mm512_set1_ps(pts->q_step[d])), _mm512_set1_ps(pts->q_lo[d]));
+    }
+    return _mm512_loadu_ps(pts->coords32 + (size_t)d * pts->stride + i);
+}
+
+// Corpo AVX-512 em precisão simples: 16 pontos por registrador, dois grupos por vez
+__attribute__((target("avx512f")))
+static ALWAYS_INLINE int avx512_body_single(const Points *pts, int begin, int end, const Centroids *c,
+                                            Sums *acc, const int D, const int K, const int Q16) {
+    int changed = 0;
+    int i = begin;
+
+    for (; i + 32 <= end; i += 32) {
+        __m512 best0 = _mm512_set1_ps(INFINITY), best1 = best0;
+        __m512 idx0  = _mm512_setzero_ps(),      idx1  = idx0;
+
+        __m512 p0[REG_D], p1[REG_D];
+        for (int d = 0; d < D && D <= REG_D; d++) {
+            p0[d] = avx512_load_single(pts, d, i, Q16);
+            p1[d] = avx512_load_single(pts, d, i + 16, Q16);
+        }
+
+        for (int j = 0; j < K; j++) {
+            const float *cj = c->pos32 + (size_t)j * D;
+            __m512 d0 = _mm512_setzero_ps(), d1 = d0;
+            #pragma GCC unroll 8
+            for (int d = 0; d < D; d++) {
+                __m512 cd = _mm512_set1_ps(cj[d]);
+                __m512 x0 = (D <= REG_D) ? p0[d] : avx512_load_single(pts, d, i, Q16);
+                __m512 x1 = (D <= REG_D) ? p1[d] : avx512_load_single(pts, d, i + 16, Q16);
+                __m512 t0 = _mm512_sub_ps(x0, cd);
+                __m512 t1 = _mm512_sub_ps(x1, cd);
+                d0 = _mm512_add_ps(d0, _mm512_mul_ps(t0, t0));
+                d1 = _mm512_add_ps(d1, _mm512_mul_ps(t1, t1));
+            }
+            __m512 cj_idx = _mm512_set1_ps((float)j);
+
+            __mmask16 lt0 = _mm512_cmp_ps_mask(d0, best0, _CMP_LT_OQ);
+            __mmask16 lt1 = _mm512_cmp_ps_mask(d1, best1, _CMP_LT_OQ);
+            best0 = _mm512_mask_blend_ps(lt0, best0, d0);
+            best1 = _mm512_mask_blend_ps(lt1, best1, d1);
+            idx0  = _mm512_mask_blend_ps(lt0, idx0, cj_idx);
+            idx1  = _mm512_mask_blend_ps(lt1, idx1, cj_idx);
+        }
+
+        int best[32];
+        _mm512_storeu_si512((void *)best,        _mm512_cvttps_epi32(idx0));
+        _mm512_storeu_si512((void *)(best + 16), _mm512_cvttps_epi32(idx1));
+        changed += store_labels(pts, i, best, 32, acc, D, Q16 ? PREC_Q16 : PREC_F32, 1);
+    }
+
+    return changed + scalar_body_single(pts, i, end, c, acc, D, K, Q16);
+}
+
+__attribute__((target("avx512f")))
+static ALWAYS_INLINE int avx512_body_f32(const Points *pts, int begin, int end, const Centroids *c,
+                                         Sums *acc, const int D, const int K) {
+    return avx512_body_single(pts, begin, end, c, acc, D, K, 0);
+}
+
+__attribute__((target("avx512f")))
+static ALWAYS_INLINE int avx512_body_q16(const Points *pts, int begin, int end, const Centroids *c,
+                                         Sums *acc, const int D, const int K) {
+    return avx512_body_single(pts, begin, end, c, acc, D, K, 1);
+}
+
+// Instancia os três kernels de uma combinação, em uma precisão. KARG é a expressão
+// de K passada ao corpo: uma constante, ou c->k nas versões especializadas só em D
+#define DEFINE_PREC_KERNELS(NAME, SUFFIX, D, KARG)                                            \
+    static int assign_scalar##SUFFIX##_##NAME(const Points *pts, int b, int e, const Centroids *c, Sums *acc) { \
+        return scalar_body##SUFFIX(pts, b, e, c, acc, D, KARG);                               \
+    }                                                                                         \
+    __attribute__((target("avx2")))                                                           \
+    static int assign_avx2##SUFFIX##_##NAME(const Points *pts, int b, int e, const Centroids *c, Sums *acc) { \
+        return avx2_body##SUFFIX(pts, b, e, c, acc, D, KARG);                                 \
+    }                                                                                         \
+    __attribute__((target("avx512f")))                                                        \
+    static int assign_avx512##SUFFIX##_##NAME(const Points *pts, int b, int e, const Centroids *c, Sums *acc) { \
+        return avx512_body##SUFFIX(pts, b, e, c, acc, D, KARG);                               \
+    }
+#define KERNEL_ROW(NAME, SUFFIX) \
+    { assign_scalar##SUFFIX##_##NAME, assign_avx2##SUFFIX##_##NAME, assign_avx512##SUFFIX##_##NAME },
+
+#else
+#define DEFINE_PREC_KERNELS(NAME, SUFFIX, D, KARG)                                            \
+    static int assign_scalar##SUFFIX##_##NAME(const Points *pts, int b, int e, const Centroids *c, Sums *acc) { \
+        return scalar_body##SUFFIX(pts, b, e, c, acc, D, KARG);                               \
+    }
+#define KERNEL_ROW(NAME, SUFFIX) { assign_scalar##SUFFIX##_##NAME },
+#endif
+
+// Versões em double (sufixo vazio), em float (_f32), em 16 bits (_q16) e em double só
+// gravando os rótulos (_store, para o predict) de cada combinação
+#define DEFINE_KERNELS(NAME, D, KARG) \
+    DEFINE_PREC_KERNELS(NAME, , D, KARG) DEFINE_PREC_KERNELS(NAME, _f32, D, KARG) \
+    DEFINE_PREC_KERNELS(NAME, _q16, D, KARG) DEFINE_PREC_KERNELS(NAME, _store, D, KARG)
+
+// Combinações especializadas: D em SPECIAL_DIMS e K arredondado para múltiplo de K_PAD
+// até SPECIAL_MAX_K (coluna 0 da tabela: só D especializado, K qualquer)
+#define FOR_EACH_K(M, D) \
+    M(d##D##_kany, D, c->k) M(d##D##_k8, D, 8)   M(d##D##_k16, D, 16) M(d##D##_k24, D, 24) \
+    M(d##D##_k32, D, 32)    M(d##D##_k40, D, 40) M(d##D##_k48, D, 48) M(d##D##_k56, D, 56) \
+    M(d##D##_k64, D, 64)
+#define FOR_EACH_D(M, X) X(M, 2) X(M, 3) X(M, 4) X(M, 8) X(M, 16) X(M, 32)
+
+#define K_BUCKETS (1 + SPECIAL_MAX_K / K_PAD)
+static const int special_dims[] = { 2, 3, 4, 8, 16, 32 };
+#define NUM_SPECIAL_DIMS ((int)(sizeof(special_dims) / sizeof(special_dims[0])))
+
+#define DEFINE_ENTRY(NAME, D, KARG)    DEFINE_KERNELS(NAME, D, KARG)
+#define TABLE_ENTRY(NAME, D, KARG)     KERNEL_ROW(NAME, )
+#define TABLE_ENTRY_F32(NAME, D, KARG) KERNEL_ROW(NAME, _f32)
+#define TABLE_ENTRY_Q16(NAME, D, KARG) KERNEL_ROW(NAME, _q16)
+#define TABLE_ENTRY_STORE(NAME, D, KARG) KERNEL_ROW(NAME, _store)
+
+FOR_EACH_D(DEFINE_ENTRY, FOR_EACH_K)
+DEFINE_KERNELS(generic, pts->d, c->k)
+
+// Tabela de despacho: [precisão][dimensão * K_BUCKETS + faixa de K][conjunto de instruções].
+// A linha PREC_STORE é a dos kernels em double que só gravam os rótulos
+#define PREC_STORE (PREC_Q16 + 1)
+static const assign_kernel_fn special_kernels[][NUM_SPECIAL_DIMS * K_BUCKETS][NUM_SIMD] = {
+    { FOR_EACH_D(TABLE_ENTRY,       FOR_EACH_K) },
+    { FOR_EACH_D(TABLE_ENTRY_F32,   FOR_EACH_K) },
+    { FOR_EACH_D(TABLE_ENTRY_Q16,   FOR_EACH_K) },
+    { FOR_EACH_D(TABLE_ENTRY_STORE, FOR_EACH_K) },
+};
+static const assign_kernel_fn generic_kernels[][NUM_SIMD] = {
+    KERNEL_ROW(generic, )
+    KERNEL_ROW(generic, _f32)
+    KERNEL_ROW(generic, _q16)
+    KERNEL_ROW(generic, _store)
+};
+
+int assign_scalar(const Points *pts, int begin, int end, const Centroids *c, Sums *acc) {
+    return scalar_body(pts, begin, end, c, acc, pts->d, c->k);
+}
+
+// Detecta em tempo de execução, via CPUID, o melhor conjunto de instruções.
+// A variável de ambiente KMEANS_SIMD (scalar, avx2, avx512) força um específico.
+const char *detect_simd(void) {
+    const char *force = getenv("KMEANS_SIMD");
+
+#ifdef KMEANS_X86
+    __builtin_cpu_init();
+    int has_avx512 = __builtin_cpu_supports("avx512f");
+    int has_avx2   = __builtin_cpu_supports("avx2");
+
+    if (force != NULL && strcmp(force, "avx512") == 0 && !has_avx512) {
+        fprintf(stderr, "Aviso: CPU sem AVX-512, usando o melhor kernel disponível.\n");
+        force = NULL;
+    }
+    if (force != NULL && strcmp(force, "avx2") == 0 && !has_avx2) {
+        fprintf(stderr, "Aviso: CPU sem AVX2, usando o kernel escalar.\n");
+        force = "scalar";
+    }
+
+    if ((force == NULL || strcmp(force, "avx512") == 0) && has_avx512) {
+        simd_level = SIMD_AVX512;
+        return "avx512";
+    }
+    if ((force == NULL || strcmp(force, "avx512") == 0 || strcmp(force, "avx2") == 0) && has_avx2) {
+        simd_level = SIMD_AVX2;
+        return "avx2";
+    }
+#else
+    (void)force;
+#endif
+
+    simd_level = SIMD_SCALAR;
+    return "scalar";
+}
+
+// Conjunto de instruções escolhido pelo último detect_simd() (SIMD_SCALAR, SIMD_AVX2
+// ou SIMD_AVX512), para os módulos com kernels próprios (ex.: a engine gemm)
+int current_simd(void) {
+    return simd_level;
+}
+
+// Escolhe na tabela o kernel para D, K e a precisão (PREC_F64, PREC_F32 ou PREC_Q16), no
+// conjunto de instruções detectado. *specialized recebe 2 se D e K são constantes
+// no kernel, 1 se só D, 0 se genérico
+assign_kernel_fn select_assign_kernel(int d, int k, int precision, int *specialized) {
+    for (int s = 0; s < NUM_SPECIAL_DIMS; s++) {
+        if (special_dims[s] != d) continue;
+
+        int bucket = (k <= SPECIAL_MAX_K) ? (k + K_PAD - 1) / K_PAD : 0;
+        *specialized = (bucket > 0) ? 2 : 1;
+        return special_kernels[precision][s * K_BUCKETS + bucket][simd_level];
+    }
+    *specialized = 0;
+    return generic_kernels[precision][simd_level];
+}
+
+// Kernel em double para D e K que só grava os rótulos: não lê os anteriores (o buffer
+// pode vir sem inicializar) e retorna 0. Usado pelo predict
+assign_kernel_fn select_label_kernel(int d, int k) {
+    int specialized;
+    return select_assign_kernel(d, k, PREC_STORE, &specialized);
+}
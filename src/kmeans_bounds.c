@@ -0,0 +1,269 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <omp.h>
+
+#include "kmeans.h"
+
+// Engines exatas com poda por desigualdade triangular (Hamerly e Elkan).
+// Cada ponto guarda um limitante superior da distância ao seu centróide e
+// limitante(s) inferior(es) da distância aos demais. A cada iteração os limitantes
+// são corrigidos pelo deslocamento (drift) dos centróides, e a varredura dos K
+// centróides só é feita quando eles não provam que o rótulo continua o mesmo.
+
+#define BOUND_BLOCK 1024  // Pontos por bloco no schedule(dynamic)
+#define BOUND_EPS   1e-9  // Folga relativa à escala dos dados contra erros de arredondamento
+
+typedef struct {
+    int       elkan;          // 0 = Hamerly (1 limitante inferior), 1 = Elkan (K limitantes)
+    int       first;          // Primeira iteração: varredura completa inicializa os limitantes
+    int       k;              // Número de centróides
+    double    tol;            // Folga absoluta usada nas comparações entre limitantes
+    double   *upper;          // Limitante superior da distância ao centróide atual (por ponto)
+    double   *lower;          // Limitante(s) inferior(es): n (Hamerly) ou n*K (Elkan)
+    Centroids prev;           // Centróides da iteração anterior
+    double   *drift;          // Deslocamento de cada centróide desde a iteração anterior
+    double    max_drift[2];   // Maior e segundo maior deslocamento
+    int       argmax_drift;   // Centróide com o maior deslocamento
+    double   *half_min;       // Metade da distância de cada centróide ao centróide mais próximo
+    double   *half_cc;        // Metade das distâncias entre centróides, K x K (só Elkan)
+} BoundState;
+
+// O limitante u prova que a distância ao centróide atual é estritamente menor que
+// o limitante l. A folga garante que a poda nunca decide um empate ou um caso que
+// dependa de arredondamento: nesses casos a distância é calculada, e o desempate
+// pelo menor índice fica idêntico ao do laço de força bruta
+static inline int separated(const BoundState *st, double u, double l) {
+    return u + st->tol < l;
+}
+
+// Folga absoluta das comparações entre limitantes, proporcional à maior coordenada
+// (em módulo) dos dados (de todos os processos, na versão MPI). Também usada pela
+// engine Yinyang
+double bound_tolerance(const Points *pts) {
+    double extent = 0.0;
+    for (int d = 0; d < pts->d; d++) {
+        const double *col = point_col(pts, d);
+        #pragma omp parallel for schedule(static) reduction(max:extent)
+        for (int i = 0; i < pts->n; i++) extent = dmax(extent, fabs(col[i]));
+    }
+    return BOUND_EPS * (mpi_max(extent) + 1.0);
+}
+
+void bounds_destroy(void *state) {
+    BoundState *st = state;
+    if (st == NULL) return;
+    free(st->upper);
+    free(st->lower);
+    free_centroids(&st->prev);
+    free(st->drift);
+    free(st->half_min);
+    free(st->half_cc);
+    free(st);
+}
+
+static void *bounds_create(const Points *pts, int k, int elkan) {
+    BoundState *st = calloc(1, sizeof(BoundState));
+    if (st == NULL) return NULL;
+
+    size_t n_lower = elkan ? (size_t)pts->n * k : (size_t)pts->n;
+    st->elkan    = elkan;
+    st->first    = 1;
+    st->k        = k;
+    st->upper    = alloc_aligned((size_t)pts->n * sizeof(double));
+    st->lower    = alloc_aligned(n_lower * sizeof(double));
+    st->drift    = malloc((size_t)k * sizeof(double));
+    st->half_min = malloc((size_t)k * sizeof(double));
+    st->half_cc  = elkan ? malloc((size_t)k * k * sizeof(double)) : NULL;
+    if (alloc_centroids(&st->prev, k, pts->d) != 0 || st->upper == NULL || st->lower == NULL ||
+        st->drift == NULL || st->half_min == NULL || (elkan && st->half_cc == NULL)) {
+        bounds_destroy(st);
+        return NULL;
+    }
+
+    st->tol = bound_tolerance(pts);
+
+    return st;
+}
+
+void *hamerly_create(const Points *pts, int k) {
+    return bounds_create(pts, k, 0);
+}
+
+void *elkan_create(const Points *pts, int k) {
+    return bounds_create(pts, k, 1);
+}
+
+// Atualiza o deslocamento dos centróides e as distâncias entre centróides.
+// Custo O(K^2), feito por uma única thread antes da região paralela
+static void update_centroid_geometry(BoundState *st, const Centroids *c) {
+    if (!st->first) {
+        st->max_drift[0] = st->max_drift[1] = 0.0;
+        st->argmax_drift = 0;
+        for (int j = 0; j < st->k; j++) {
+            double d = sqrt(distance_sq(centroid(c, j), centroid(&st->prev, j), c->d));
+            st->drift[j] = d;
+            if (d > st->max_drift[0]) {
+                st->max_drift[1] = st->max_drift[0];
+                st->max_drift[0] = d;
+                st->argmax_drift = j;
+            } else if (d > st->max_drift[1]) {
+                st->max_drift[1] = d;
+            }
+        }
+    }
+    copy_centroids(&st->prev, c);
+
+    int k = st->k;
+    for (int j = 0; j < k; j++) st->half_min[j] = INFINITY;
+    for (int j = 0; j < k; j++) {
+        if (st->elkan) st->half_cc[(size_t)j * k + j] = 0.0;
+        for (int l = j + 1; l < k; l++) {
+            double h = 0.5 * sqrt(distance_sq(centroid(c, j), centroid(c, l), c->d));
+            if (st->elkan) st->half_cc[(size_t)j * k + l] = st->half_cc[(size_t)l * k + j] = h;
+            if (h < st->half_min[j]) st->half_min[j] = h;
+            if (h < st->half_min[l]) st->half_min[l] = h;
+        }
+    }
+}
+
+// Varredura completa de Hamerly: menor e segunda menor distância ao quadrado.
+// O desempate pelo menor índice é o mesmo do laço de força bruta
+static int hamerly_scan(BoundState *st, const double *p, const Centroids *c, int i) {
+    double best = INFINITY, second = INFINITY;
+    int bestCluster = 0;
+    for (int j = 0; j < c->k; j++) {
+        double d2 = distance_sq(p, centroid(c, j), c->d);
+        if (d2 < best) {
+            second = best;
+            best = d2;
+            bestCluster = j;
+        } else if (d2 < second) {
+            second = d2;
+        }
+    }
+    st->upper[i] = sqrt(best);
+    st->lower[i] = sqrt(second);
+    return bestCluster;
+}
+
+static int hamerly_point(BoundState *st, const double *p, int a, const Centroids *c, int i) {
+    if (st->first) return hamerly_scan(st, p, c, i);
+
+    // Corrige os limitantes pelo deslocamento dos centróides
+    st->upper[i] += st->drift[a];
+    st->lower[i] -= (a == st->argmax_drift) ? st->max_drift[1] : st->max_drift[0];
+
+    double m = dmax(st->half_min[a], st->lower[i]);
+    if (separated(st, st->upper[i], m)) return a;
+
+    // Aperta o limitante superior e testa novamente antes da varredura completa
+    st->upper[i] = sqrt(distance_sq(p, centroid(c, a), c->d));
+    if (separated(st, st->upper[i], m)) return a;
+
+    return hamerly_scan(st, p, c, i);
+}
+
+static int elkan_point(BoundState *st, const double *p, int a, const Centroids *c, int i) {
+    int     k  = st->k;
+    double *lb = st->lower + (size_t)i * k;
+
+    if (st->first) {
+        int bestCluster = 0;
+        double best = INFINITY;
+        for (int j = 0; j < k; j++) {
+            double d2 = distance_sq(p, centroid(c, j), c->d);
+            lb[j] = sqrt(d2);
+            if (d2 < best) {
+                best = d2;
+                bestCluster = j;
+            }
+        }
+        st->upper[i] = lb[bestCluster];
+        return bestCluster;
+    }
+
+    // Corrige os limitantes pelo deslocamento dos centróides
+    for (int j = 0; j < k; j++) lb[j] -= st->drift[j];
+    double u = st->upper[i] + st->drift[a];
+
+    if (!separated(st, u, st->half_min[a])) {
+        int    stale = 1;   // u ainda é um limitante, não a distância exata
+        double ua2   = 0.0; // Distância exata ao quadrado ao centróide a (quando !stale)
+        const double *half_cc_a = st->half_cc + (size_t)a * k;
+
+        for (int j = 0; j < k; j++) {
+            if (j == a) continue;
+            double z = dmax(lb[j], half_cc_a[j]);
+            if (separated(st, u, z)) continue;
+
+            if (stale) {
+                ua2   = distance_sq(p, centroid(c, a), c->d);
+                u     = sqrt(ua2);
+                lb[a] = u;
+                stale = 0;
+                if (separated(st, u, z)) continue;
+            }
+
+            double d2 = distance_sq(p, centroid(c, j), c->d);
+            lb[j] = sqrt(d2);
+            if (d2 < ua2 || (d2 == ua2 && j < a)) {
+                a   = j;
+                ua2 = d2;
+                u   = lb[j];
+                half_cc_a = st->half_cc + (size_t)a * k;
+            }
+        }
+    }
+
+    st->upper[i] = u;
+    return a;
+}
+
+// Iteração comum às duas engines. A poda deixa o custo por ponto muito desigual,
+// então os blocos de pontos são distribuídos com schedule(dynamic). Cada thread soma
+// os pontos nas suas parciais na mesma passada, como na engine fused
+int iterate_bounds(void *state, Points *pts, const Centroids *c, assign_kernel_fn kernel, Sums *sums) {
+    BoundState *st = state;
+    (void)kernel;
+    int num_points = pts->n;
+    int num_blocks = (num_points + BOUND_BLOCK - 1) / BOUND_BLOCK;
+    int changed    = 0;
+
+    Sums *locals = thread_sums(sums);
+    if (locals == NULL) return -1;
+
+    update_centroid_geometry(st, c);
+
+    #pragma omp parallel reduction(+:changed)
+    {
+      Sums *local = &locals[omp_get_thread_num()];
+      double p[pts->d];
+
+      #pragma omp for schedule(dynamic) nowait
+      for (int b = 0; b < num_blocks; b++) {
+        int begin = b * BOUND_BLOCK;
+        int end   = (begin + BOUND_BLOCK < num_points) ? begin + BOUND_BLOCK : num_points;
+
+        for (int i = begin; i < end; i++) {
+            load_point(pts, i, p);
+            int a = pts->labels[i];
+            int best = st->elkan ? elkan_point(st, p, a, c, i)
+                                 : hamerly_point(st, p, a, c, i);
+
+            changed += (a != best);
+            pts->labels[i] = (label_t)best;
+            accumulate(local, best, p);
+        }
+      }
+
+      TRACE_BUSY();
+      #pragma omp barrier
+      TRACE_MARK(TRACE_ASSIGN);
+      reduce_thread_sums(sums);
+    }
+    TRACE_MARK(TRACE_MERGE);
+
+    st->first = 0;
+    return changed;
+}
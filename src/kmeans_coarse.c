@@ -0,0 +1,268 @@
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+
+#include "kmeans.h"
+
+// Pipeline grossa-para-fina (COARSE_UNIFORM e COARSE_IMPORTANCE).
+//
+// Nas primeiras iterações do k-means os centróides ainda andam muito, e passadas
+// exatas sobre todos os pontos são desperdício. Aqui a inicialização e um Lloyd
+// ponderado rodam sobre uma amostra pequena dos pontos; cada nível seguinte parte
+// dos centróides do anterior com uma amostra COARSE_GROWTH vezes maior, até a
+// amostra ficar a um fator COARSE_GROWTH de N. O fit termina com poucas iterações
+// exatas da engine sobre todos os pontos, a partir desses centróides.
+//
+// As amostras são de Poisson: o ponto i entra com probabilidade p_i = min(1, m q_i),
+// sorteada pelo contador do ponto (sample_uniform, com o índice global do ponto), e
+// pesa 1 / p_i. As somas ponderadas estimam as somas sobre todos os pontos sem viés,
+// e a amostra não depende do número de threads nem de processos. Na amostra uniforme
+// q_i = 1 / N; na amostra por importância (o coreset leve de Bachem et al., 2018)
+// q_i = 1 / 2N + d(x_i, μ)² / 2Φ, com μ a média dos pontos e Φ a soma dos d(x, μ)²,
+// o que favorece os pontos longe da média (grupos pequenos e afastados).
+
+#define COARSE_MIN_SAMPLE (1 << 14) // Tamanho esperado mínimo da primeira amostra
+#define COARSE_PER_K      32        // ... e pelo menos COARSE_PER_K pontos por centróide
+#define COARSE_GROWTH     8         // Razão entre os tamanhos de dois níveis seguidos
+
+typedef struct {
+    const Points *pts;
+    int           mode;
+    unsigned int  seed;
+    long long     first;      // Índice global do primeiro ponto deste processo
+    double        total;      // N somado entre os processos
+    double       *mean;       // μ (COARSE_IMPORTANCE)
+    double        phi;        // Φ (COARSE_IMPORTANCE)
+    int           num_blocks;
+    int          *block_count; // Pontos sorteados em cada bloco, depois o início de cada um
+} Sampler;
+
+// Probabilidade de o ponto i entrar em uma amostra de tamanho esperado m
+static inline double inclusion(const Sampler *s, int i, double m) {
+    double q = 1.0 / s->total;
+    if (s->mode == COARSE_IMPORTANCE && s->phi > 0.0) {
+        double d2 = 0.0;
+        for (int c = 0; c < s->pts->d; c++) {
+            double t = point_col(s->pts, c)[i] - s->mean[c];
+            d2 += t * t;
+        }
+        q = 0.5 / s->total + 0.5 * d2 / s->phi;
+    }
+    return dmin(1.0, m * q);
+}
+
+// μ e Φ, somados bloco a bloco em ordem fixa (e entre os processos)
+static int importance_setup(Sampler *s) {
+    const Points *pts = s->pts;
+    int d = pts->d;
+    double *block_sum = malloc((size_t)s->num_blocks * (d + 1) * sizeof(double));
+    if (block_sum == NULL) return -1;
+
+    #pragma omp parallel for schedule(static)
+    for (int b = 0; b < s->num_blocks; b++) {
+        int begin = b * ASSIGN_BLOCK;
+        int end   = (begin + ASSIGN_BLOCK < pts->n) ? begin + ASSIGN_BLOCK : pts->n;
+        for (int c = 0; c < d; c++) {
+            const double *col = point_col(pts, c);
+            double sum = 0.0;
+            for (int i = begin; i < end; i++) sum += col[i];
+            block_sum[(size_t)b * (d + 1) + c] = sum;
+        }
+    }
+    for (int c = 0; c < d; c++) {
+        double sum = 0.0;
+        for (int b = 0; b < s->num_blocks; b++) sum += block_sum[(size_t)b * (d + 1) + c];
+        s->mean[c] = sum;
+    }
+    mpi_sum_array(s->mean, d);
+    for (int c = 0; c < d; c++) s->mean[c] /= s->total;
+
+    #pragma omp parallel for schedule(static)
+    for (int b = 0; b < s->num_blocks; b++) {
+        int begin = b * ASSIGN_BLOCK;
+        int end   = (begin + ASSIGN_BLOCK < pts->n) ? begin + ASSIGN_BLOCK : pts->n;
+        double sum = 0.0;
+        for (int c = 0; c < d; c++) {
+            const double *col = point_col(pts, c);
+            for (int i = begin; i < end; i++) {
+                double t = col[i] - s->mean[c];
+                sum += t * t;
+            }
+        }
+        block_sum[(size_t)b * (d + 1) + d] = sum;
+    }
+    double phi = 0.0;
+    for (int b = 0; b < s->num_blocks; b++) phi += block_sum[(size_t)b * (d + 1) + d];
+    s->phi = mpi_sum(phi);
+
+    free(block_sum);
+    return 0;
+}
+
+// Sorteia a amostra do nível level, de tamanho esperado m, em sample (alocada aqui)
+// com os pesos em *weight. A primeira passada conta os pontos de cada bloco e a
+// segunda refaz os mesmos sorteios, copiando cada ponto para a posição do seu bloco
+static int draw_sample(Sampler *s, int level, double m, Points *sample, double **weight) {
+    const Points *pts = s->pts;
+    unsigned int sequence = (unsigned int)level;
+
+    #pragma omp parallel for schedule(static)
+    for (int b = 0; b < s->num_blocks; b++) {
+        int begin = b * ASSIGN_BLOCK;
+        int end   = (begin + ASSIGN_BLOCK < pts->n) ? begin + ASSIGN_BLOCK : pts->n;
+        int count = 0;
+        for (int i = begin; i < end; i++) {
+            count += sample_uniform(s->seed, sequence, s->first + i) < inclusion(s, i, m);
+        }
+        s->block_count[b] = count;
+    }
+    int n = 0;
+    for (int b = 0; b < s->num_blocks; b++) {
+        int count = s->block_count[b];
+        s->block_count[b] = n;
+        n += count;
+    }
+
+    *weight = malloc((size_t)(n > 0 ? n : 1) * sizeof(double));
+    if (*weight == NULL || alloc_points(sample, n > 0 ? n : 1, pts->d) != 0) {
+        free(*weight);
+        *weight = NULL;
+        return -1;
+    }
+    sample->n = n;
+
+    #pragma omp parallel for schedule(static)
+    for (int b = 0; b < s->num_blocks; b++) {
+        int begin = b * ASSIGN_BLOCK;
+        int end   = (begin + ASSIGN_BLOCK < pts->n) ? begin + ASSIGN_BLOCK : pts->n;
+        int next  = s->block_count[b];
+        for (int i = begin; i < end; i++) {
+            double p = inclusion(s, i, m);
+            if (sample_uniform(s->seed, sequence, s->first + i) >= p) continue;
+            for (int c = 0; c < pts->d; c++) point_col(sample, c)[next] = point_col(pts, c)[i];
+            (*weight)[next]       = 1.0 / p;
+            sample->labels[next] = NO_LABEL;
+            next++;
+        }
+    }
+    return 0;
+}
+
+// Lloyd ponderado sobre a amostra, até nenhum ponto mudar de cluster (ou max_iter).
+// locals tem k x (d + 1) posições por thread: as somas ponderadas seguidas dos pesos
+// de cada centróide. Retorna o número de iterações
+static int weighted_lloyd(const Points *sample, const double *weight, Centroids *c, int max_iter,
+                          double *locals, double *total) {
+    int k = c->k, d = c->d, n = sample->n;
+    size_t width = (size_t)k * (d + 1);
+    int num_blocks  = (n + ASSIGN_BLOCK - 1) / ASSIGN_BLOCK;
+    int num_threads = omp_get_max_threads();
+    int specialized;
+    assign_kernel_fn kernel = select_assign_kernel(d, k, PREC_F64, &specialized);
+
+    int iterations = 0;
+    int changed    = 1;
+    while (changed && iterations < max_iter) {
+        changed = 0;
+        #pragma omp parallel reduction(+:changed)
+        {
+          double *local = locals + (size_t)omp_get_thread_num() * width;
+          double *wk    = local + (size_t)k * d;
+          memset(local, 0, width * sizeof(double));
+
+          int first, last;
+          thread_blocks(num_blocks, &first, &last);
+          for (int b = first; b < last; b++) {
+            int begin = b * ASSIGN_BLOCK;
+            int end   = (begin + ASSIGN_BLOCK < n) ? begin + ASSIGN_BLOCK : n;
+            changed += kernel(sample, begin, end, c, NULL);
+            for (int e = 0; e < d; e++) {
+              const double *col = point_col(sample, e);
+              for (int i = begin; i < end; i++) local[(size_t)sample->labels[i] * d + e] += weight[i] * col[i];
+            }
+            for (int i = begin; i < end; i++) wk[sample->labels[i]] += weight[i];
+          }
+        }
+
+        // Parciais somadas sempre na mesma ordem de threads (e depois entre os processos)
+        #pragma omp parallel for schedule(static)
+        for (size_t x = 0; x < width; x++) {
+            double sum = 0.0;
+            for (int t = 0; t < num_threads; t++) sum += locals[(size_t)t * width + x];
+            total[x] = sum;
+        }
+        mpi_sum_array(total, (int)width);
+        changed = (int)mpi_sum((double)changed);
+
+        const double *wk = total + (size_t)k * d;
+        for (int j = 0; j < k; j++) {
+            if (wk[j] == 0.0) continue;
+            double *cj = centroid(c, j);
+            for (int e = 0; e < d; e++) cj[e] = total[(size_t)j * d + e] / wk[j];
+        }
+        iterations++;
+    }
+    return iterations;
+}
+
+int coarse_fit(const Initializer *ini, const Points *pts, Centroids *c, unsigned int seed, int mode,
+               int max_iter, CoarseStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    double start_time = omp_get_wtime();
+
+    Sampler s;
+    s.pts         = pts;
+    s.mode        = mode;
+    s.seed        = seed;
+    s.first       = mpi_offset(pts->n);
+    s.total       = mpi_sum((double)pts->n);
+    s.phi         = 0.0;
+    s.num_blocks  = (pts->n + ASSIGN_BLOCK - 1) / ASSIGN_BLOCK;
+    s.mean        = malloc((size_t)pts->d * sizeof(double));
+    s.block_count = malloc((size_t)(s.num_blocks > 0 ? s.num_blocks : 1) * sizeof(int));
+
+    size_t width  = (size_t)c->k * (c->d + 1);
+    double *locals = malloc((size_t)omp_get_max_threads() * width * sizeof(double));
+    double *total  = malloc(width * sizeof(double));
+    int ok = s.mean != NULL && s.block_count != NULL && locals != NULL && total != NULL &&
+             (mode != COARSE_IMPORTANCE || importance_setup(&s) == 0);
+
+    double m = (double)COARSE_PER_K * c->k;
+    if (m < COARSE_MIN_SAMPLE) m = COARSE_MIN_SAMPLE;
+    for (int level = 0; ok && m * COARSE_GROWTH <= s.total; level++, m *= COARSE_GROWTH) {
+        Points sample;
+        double *weight;
+        if (draw_sample(&s, level, m, &sample, &weight) != 0) {
+            ok = 0;
+            break;
+        }
+
+        // A primeira amostra também escolhe os centróides iniciais (se tiver ao menos K
+        // pontos; senão a pipeline não roda e o fit inicializa sobre todos os pontos)
+        double sample_n = mpi_sum((double)sample.n);
+        if (level == 0 && sample_n < c->k) {
+            free_points(&sample);
+            free(weight);
+            break;
+        }
+        if (level == 0) {
+            double init_time = omp_get_wtime();
+            ok = mpi_init_centroids(ini, &sample, c, seed) == 0;
+            stats->init = omp_get_wtime() - init_time;
+        }
+        if (ok) {
+            stats->iterations += weighted_lloyd(&sample, weight, c, max_iter, locals, total);
+            stats->points      = (long long)sample_n;
+            stats->levels++;
+        }
+        free_points(&sample);
+        free(weight);
+    }
+    stats->time = omp_get_wtime() - start_time - stats->init;
+
+    free(s.mean);
+    free(s.block_count);
+    free(locals);
+    free(total);
+    return ok ? stats->levels : -1;
+}
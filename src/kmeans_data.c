@@ -0,0 +1,320 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <omp.h>
+
+#include "kmeans.h"
+
+// Aloca memória alinhada (retorna NULL em caso de falha)
+void *alloc_aligned(size_t bytes) {
+    void *ptr = NULL;
+    if (posix_memalign(&ptr, ALIGNMENT, bytes) != 0) return NULL;
+    return ptr;
+}
+
+void free_points(Points *pts) {
+    free(pts->coords);
+    free(pts->coords32);
+    free(pts->labels);
+    pts->coords   = NULL;
+    pts->coords32 = NULL;
+    pts->labels   = NULL;
+}
+
+int alloc_points(Points *pts, int num_points, int d) {
+    pts->n        = num_points;
+    pts->d        = d;
+    pts->stride   = points_stride(num_points);
+    pts->coords32 = NULL;
+    pts->coords16 = NULL;
+    pts->q_lo     = NULL;
+    pts->q_step   = NULL;
+    pts->blocks   = NULL;
+    pts->coords   = alloc_aligned(pts->stride * d * sizeof(double));
+    pts->labels = alloc_aligned((size_t)num_points * sizeof(label_t));
+    if (pts->coords == NULL || pts->labels == NULL) {
+        free_points(pts);
+        return -1;
+    }
+    return 0;
+}
+
+void free_centroids(Centroids *c) {
+    free(c->pos);
+    free(c->pos32);
+    c->pos   = NULL;
+    c->pos32 = NULL;
+}
+
+// Aloca k centróides de d coordenadas, mais as linhas sentinela (no infinito) até
+// o próximo múltiplo de K_PAD, lidas pelos kernels especializados
+int alloc_centroids(Centroids *c, int k, int d) {
+    int rows = (k + K_PAD - 1) / K_PAD * K_PAD;
+    c->k     = k;
+    c->d     = d;
+    c->pos   = alloc_aligned((size_t)rows * d * sizeof(double));
+    c->pos32 = alloc_aligned((size_t)rows * d * sizeof(float));
+    if (c->pos == NULL || c->pos32 == NULL) {
+        free_centroids(c);
+        return -1;
+    }
+    for (size_t v = (size_t)k * d; v < (size_t)rows * d; v++) {
+        c->pos[v]   = INFINITY;
+        c->pos32[v] = INFINITY;
+    }
+    return 0;
+}
+
+// Atualiza a cópia em float32 dos centróides, lida pelos kernels de precisão simples
+void centroids_to_f32(Centroids *c) {
+    for (size_t v = 0; v < (size_t)c->k * c->d; v++) c->pos32[v] = (float)c->pos[v];
+}
+
+// Copia as coordenadas de src para as colunas float32 já alocadas de dst (com o
+// passo dst->stride). A conversão usa a mesma divisão em blocos dos laços de
+// atribuição (thread_blocks), então cada thread toca as páginas que vai ler
+void convert_points_f32(const Points *src, Points *dst) {
+    int num_blocks = (src->n + ASSIGN_BLOCK - 1) / ASSIGN_BLOCK;
+
+    #pragma omp parallel
+    {
+      int first, last;
+      thread_blocks(num_blocks, &first, &last);
+      int begin = first * ASSIGN_BLOCK;
+      int end   = (last * ASSIGN_BLOCK < src->n) ? last * ASSIGN_BLOCK : src->n;
+      for (int d = 0; d < src->d; d++) {
+          const double *from = point_col(src, d);
+          float *to = dst->coords32 + (size_t)d * dst->stride;
+          for (int i = begin; i < end; i++) to[i] = (float)from[i];
+      }
+    }
+}
+
+// Quantiza as coordenadas de src em 16 bits para as colunas já alocadas de dst
+// (coords16, com o passo dst->stride), relativas à caixa envolvente de cada
+// dimensão (a de todos os processos, na versão MPI): a caixa é dividida em Q16_MAX
+// passos e cada coordenada vai para o passo mais próximo, com erro de até meio
+// passo. q_lo e q_step de dst recebem o início da caixa e o passo de cada dimensão
+void convert_points_q16(const Points *src, Points *dst) {
+    for (int d = 0; d < src->d; d++) {
+        const double *from = point_col(src, d);
+        double lo = INFINITY, hi = -INFINITY;
+
+        #pragma omp parallel for schedule(static) reduction(min:lo) reduction(max:hi)
+        for (int i = 0; i < src->n; i++) {
+            lo = dmin(lo, from[i]);
+            hi = dmax(hi, from[i]);
+        }
+        lo = -mpi_max(-lo);
+        hi = mpi_max(hi);
+
+        // Início arredondado para baixo e passo para cima em float, para a caixa
+        // inteira caber nos Q16_MAX passos
+        float lo32 = (float)lo;
+        if (lo32 > lo) lo32 = nextafterf(lo32, -INFINITY);
+        float step = (float)((hi - lo32) / Q16_MAX);
+        if ((double)step * Q16_MAX < hi - lo32) step = nextafterf(step, INFINITY);
+        dst->q_lo[d]   = lo32;
+        dst->q_step[d] = step;
+    }
+
+    int num_blocks = (src->n + ASSIGN_BLOCK - 1) / ASSIGN_BLOCK;
+
+    #pragma omp parallel
+    {
+      int first, last;
+      thread_blocks(num_blocks, &first, &last);
+      int begin = first * ASSIGN_BLOCK;
+      int end   = (last * ASSIGN_BLOCK < src->n) ? last * ASSIGN_BLOCK : src->n;
+      for (int d = 0; d < src->d; d++) {
+          const double *from = point_col(src, d);
+          uint16_t *to = dst->coords16 + (size_t)d * dst->stride;
+          double lo = dst->q_lo[d], step = dst->q_step[d];
+          for (int i = begin; i < end; i++) {
+              double q = (step > 0.0) ? (from[i] - lo) / step + 0.5 : 0.0;
+              to[i] = (q >= Q16_MAX) ? Q16_MAX : (q <= 0.0) ? 0 : (uint16_t)q;
+          }
+      }
+    }
+}
+
+void copy_centroids(Centroids *dst, const Centroids *src) {
+    memcpy(dst->pos, src->pos, (size_t)src->k * src->d * sizeof(double));
+}
+
+static void free_thread_sums(Sums *s) {
+    free(s->arena);
+    free(s->locals);
+    s->arena      = NULL;
+    s->locals     = NULL;
+    s->num_locals = 0;
+    s->num_nodes  = 0;
+}
+
+void free_sums(Sums *s) {
+    free_thread_sums(s);
+    free(s->sum);
+    free(s->count);
+    s->sum = NULL;
+    s->count = NULL;
+}
+
+// Aloca as somas de k centróides, já zeradas
+int alloc_sums(Sums *s, int k, int d) {
+    s->k          = k;
+    s->d          = d;
+    s->locals     = NULL;
+    s->arena      = NULL;
+    s->num_locals = 0;
+    s->num_nodes  = 0;
+    s->sum        = calloc((size_t)k * d, sizeof(double));
+    s->count = calloc((size_t)k, sizeof(int));
+    if (s->sum == NULL || s->count == NULL) {
+        free_sums(s);
+        return -1;
+    }
+    return 0;
+}
+
+void clear_sums(Sums *s) {
+    memset(s->sum,   0, (size_t)s->k * s->d * sizeof(double));
+    memset(s->count, 0, (size_t)s->k * sizeof(int));
+}
+
+// Move cada centróide para a média dos seus pontos (centróides vazios ficam parados)
+void update_centroids(Centroids *c, const Sums *s) {
+    for (int j = 0; j < c->k; j++) {
+        if (s->count[j] == 0) continue;
+        double *cj = centroid(c, j);
+        const double *sj = s->sum + (size_t)j * s->d;
+        for (int d = 0; d < c->d; d++) cj[d] = sj[d] / s->count[j];
+    }
+}
+
+// Bytes de um vetor arredondados para um múltiplo de ALIGNMENT
+static size_t padded(size_t bytes) {
+    return (bytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+// Parciais (zeradas) de cada thread, indexadas por omp_get_thread_num(). Ficam em
+// uma única arena, alocada na primeira chamada e reaproveitada enquanto o número de
+// threads não mudar; cada fatia (somas e contagens) começa em uma linha de cache
+// própria, então threads vizinhas não disputam linhas. No modo NUMA com mais de um
+// nó, a arena tem ainda uma fatia por nó (locals[T + nó]) para a redução em dois
+// níveis. Retorna NULL se faltar memória
+Sums *thread_sums(Sums *s) {
+    int num_threads = omp_get_max_threads();
+    const NumaLayout *nl = &numa_layout;
+    int num_nodes = (nl->enabled && nl->num_nodes > 1 && nl->num_threads == num_threads) ? nl->num_nodes : 0;
+    if (s->locals != NULL && s->num_locals == num_threads && s->num_nodes == num_nodes) return s->locals;
+    free_thread_sums(s);
+
+    int    num_slices  = num_threads + num_nodes;
+    size_t sum_bytes   = padded((size_t)s->k * s->d * sizeof(double));
+    size_t slice_bytes = sum_bytes + padded((size_t)s->k * sizeof(int));
+    s->locals = calloc((size_t)num_slices, sizeof(Sums));
+    s->arena  = alloc_aligned((size_t)num_slices * slice_bytes);
+    if (s->locals == NULL || s->arena == NULL) {
+        free_thread_sums(s);
+        return NULL;
+    }
+    s->num_locals = num_threads;
+    s->num_nodes  = num_nodes;
+
+    // Cada fatia é zerada (e, portanto, alocada fisicamente) pela thread que a usa;
+    // a fatia de um nó, pela primeira thread do nó
+    #pragma omp parallel num_threads(num_threads)
+    {
+      int t = omp_get_thread_num();
+      int slices[2] = { t, -1 };
+      if (num_nodes > 0 && nl->node_rank[t] == 0) slices[1] = num_threads + nl->thread_node[t];
+
+      for (int i = 0; i < 2 && slices[i] >= 0; i++) {
+          char *slice = (char *)s->arena + (size_t)slices[i] * slice_bytes;
+          memset(slice, 0, slice_bytes);
+          s->locals[slices[i]].sum   = (double *)slice;
+          s->locals[slices[i]].count = (int *)(slice + sum_bytes);
+          s->locals[slices[i]].k     = s->k;
+          s->locals[slices[i]].d     = s->d;
+      }
+    }
+    return s->locals;
+}
+
+// Soma as parciais de src em dst (centróides [first, last)) e zera as de src
+static void drain_sums(Sums *dst, Sums *src, int first, int last) {
+    int d = dst->d;
+    for (int j = first; j < last; j++) {
+        double *row  = dst->sum + (size_t)j * d;
+        double *part = src->sum + (size_t)j * d;
+        for (int c = 0; c < d; c++) {
+            row[c] += part[c];
+            part[c] = 0.0;
+        }
+        dst->count[j] += src->count[j];
+        src->count[j] = 0;
+    }
+}
+
+// Reduz as parciais dos centróides [lo, hi) em s. Chamada por todas as threads da
+// região paralela; termina com uma barreira
+static void reduce_range(Sums *s, int lo, int hi) {
+    if (s->num_nodes > 0 && omp_get_num_threads() == s->num_locals) {
+        const NumaLayout *nl = &numa_layout;
+        int t     = omp_get_thread_num();
+        int node  = nl->thread_node[t];
+        int begin = nl->node_offset[node];
+        int end   = nl->node_offset[node + 1];
+        int first, last;
+        block_share(hi - lo, nl->node_rank[t], end - begin, &first, &last);
+
+        Sums *part = &s->locals[s->num_locals + node];
+        for (int m = begin; m < end; m++) {
+            drain_sums(part, &s->locals[nl->node_members[m]], lo + first, lo + last);
+        }
+
+        #pragma omp barrier
+        #pragma omp for schedule(static)
+        for (int j = lo; j < hi; j++) {
+            for (int n = 0; n < s->num_nodes; n++) drain_sums(s, &s->locals[s->num_locals + n], j, j + 1);
+        }
+        return;
+    }
+
+    #pragma omp for schedule(static)
+    for (int j = lo; j < hi; j++) {
+        for (int t = 0; t < s->num_locals; t++) drain_sums(s, &s->locals[t], j, j + 1);
+    }
+}
+
+// Soma as parciais de todas as threads em s e as zera para a próxima iteração.
+// Chamada por todas as threads de uma região paralela (depois de uma barreira),
+// divide os centróides entre elas: cada centróide é reduzido por uma única thread,
+// sempre na ordem 0, 1, ..., T-1, então o resultado não depende da ordem de chegada
+// das threads. Fora de uma região paralela, roda na thread atual.
+// Com fatias por nó, a redução tem dois níveis: as threads de cada nó somam as
+// parciais do nó na fatia dele (só leituras locais), e depois os centróides são
+// divididos entre todas as threads, que somam as fatias dos nós em ordem fixa. Só
+// as fatias dos nós, uma por nó, cruzam a interconexão.
+// Com mais de um processo MPI, os centróides são reduzidos em MPI_CHUNKS faixas, e
+// a thread mestre dispara a soma entre os processos de cada faixa assim que ela fica
+// pronta, enquanto as threads seguem com a próxima
+void reduce_thread_sums(Sums *s) {
+    if (mpi_ranks() == 1) {
+        reduce_range(s, 0, s->k);
+        return;
+    }
+
+    for (int ch = 0; ch < MPI_CHUNKS; ch++) {
+        int lo, hi;
+        block_share(s->k, ch, MPI_CHUNKS, &lo, &hi);
+        reduce_range(s, lo, hi);
+        #pragma omp master
+        mpi_post_sums(s, lo, hi);
+    }
+    #pragma omp master
+    mpi_wait_sums();
+    #pragma omp barrier
+}
@@ -0,0 +1,454 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <omp.h>
+
+#include "kmeans.h"
+
+// Leitura de conjuntos de pontos no formato binário do projeto (ver DatasetHeader).
+// Com mmap, as colunas float64 do arquivo viram diretamente as colunas dos pontos,
+// sem cópia; a alternativa lê o arquivo inteiro para um buffer alocado. Na versão
+// MPI cada processo abre só a sua parte dos pontos (dataset_open_part). Para o
+// trabalho de uma passada só (mini-batch e rotulação), o arquivo também pode ser lido
+// em lotes por uma thread de E/S (chunks_*), sem ficar inteiro na memória.
+
+#define PAGE_TOUCH 4096  // Passo (em bytes) da passada que traz as páginas para a memória
+
+size_t dataset_column_bytes(uint64_t n, uint32_t dtype) {
+    size_t bytes = (size_t)n * (dtype == DTYPE_F32 ? sizeof(float) : sizeof(double));
+    return (bytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+static int check_header(const DatasetHeader *h, const char *path) {
+    if (memcmp(h->magic, DATASET_MAGIC, sizeof(h->magic)) != 0) {
+        fprintf(stderr, "%s: não é um dataset do k-means.\n", path);
+        return -1;
+    }
+    if (h->d < 1 || h->d > MAX_D) {
+        fprintf(stderr, "%s: D=%u fora do intervalo suportado (1 a %d).\n", path, h->d, MAX_D);
+        return -1;
+    }
+    if (h->dtype != DTYPE_F64 && h->dtype != DTYPE_F32) {
+        fprintf(stderr, "%s: tipo de coordenada desconhecido (%u).\n", path, h->dtype);
+        return -1;
+    }
+    if (h->n < 1 || h->n > INT_MAX) {
+        fprintf(stderr, "%s: N=%llu fora do intervalo suportado.\n", path, (unsigned long long)h->n);
+        return -1;
+    }
+    return 0;
+}
+
+// Converte uma coluna float32 para a coluna float64 correspondente dos pontos, com a
+// divisão em blocos dos laços de atribuição (cada thread toca as páginas que vai ler)
+static void widen_column(const float *src, double *dst, int n) {
+    int num_blocks = (n + ASSIGN_BLOCK - 1) / ASSIGN_BLOCK;
+
+    #pragma omp parallel
+    {
+      int first, last;
+      thread_blocks(num_blocks, &first, &last);
+      int end = (last * ASSIGN_BLOCK < n) ? last * ASSIGN_BLOCK : n;
+      for (int i = first * ASSIGN_BLOCK; i < end; i++) dst[i] = src[i];
+    }
+}
+
+// Aloca as colunas dos pontos (leitura para buffer ou conversão de float32)
+static int alloc_coords(Dataset *ds) {
+    ds->owns_coords = 1;
+    ds->pts.coords  = alloc_aligned(ds->pts.stride * ds->pts.d * sizeof(double));
+    if (ds->pts.coords == NULL) return -1;
+    numa_bind_points(&ds->pts);
+    return 0;
+}
+
+// Traz as páginas das colunas para a memória com a mesma divisão estática em
+// blocos usada pelos laços de atribuição: cada página do page cache é lida (e
+// alocada) pela thread que vai processá-la, no nó NUMA dessa thread. Antes de
+// tocar a sua faixa, a thread pede a leitura antecipada dela ao kernel
+static void touch_columns(const Dataset *ds) {
+    const Points *pts = &ds->pts;
+    int num_blocks = (pts->n + ASSIGN_BLOCK - 1) / ASSIGN_BLOCK;
+    long page = sysconf(_SC_PAGESIZE);
+    unsigned long sink = 0;
+
+    #pragma omp parallel reduction(+:sink)
+    {
+      int first, last;
+      thread_blocks(num_blocks, &first, &last);
+
+      if (first < last) {
+        size_t begin = (size_t)first * ASSIGN_BLOCK;
+        size_t end   = (size_t)last * ASSIGN_BLOCK;
+        if (end > (size_t)pts->n) end = pts->n;
+
+        for (int d = 0; d < pts->d; d++) {
+            const char *lo = (const char *)(point_col(pts, d) + begin);
+            const char *hi = (const char *)(point_col(pts, d) + end);
+            const char *aligned = (const char *)((uintptr_t)lo / page * page);
+            posix_madvise((void *)aligned, (size_t)(hi - aligned), POSIX_MADV_WILLNEED);
+            for (const char *p = lo; p < hi; p += PAGE_TOUCH) sink += (unsigned char)*p;
+        }
+      }
+    }
+
+    // Impede que o compilador elimine a passada
+    volatile unsigned long keep = sink;
+    (void)keep;
+}
+
+static int open_mapped(Dataset *ds, int fd, const DatasetHeader *h, size_t file_size, const char *path) {
+    int n = ds->pts.n;
+    size_t col = dataset_column_bytes(h->n, h->dtype);
+
+    ds->map = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (ds->map == MAP_FAILED) {
+        ds->map = NULL;
+        perror(path);
+        return -1;
+    }
+    ds->map_size = file_size;
+
+    const char *data = (const char *)ds->map + sizeof(DatasetHeader);
+    if (h->dtype == DTYPE_F64) {
+        // Sem cópia: as colunas dos pontos são as do mapeamento (col é múltiplo de
+        // ALIGNMENT, então o passo entre colunas é o mesmo de points_stride). Uma
+        // parte começa em um múltiplo de ASSIGN_BLOCK pontos, ainda alinhada
+        ds->pts.coords = (double *)data + ds->first;
+        ds->pts.stride = points_stride(ds->total_n);
+        touch_columns(ds);
+    } else {
+        // float32 é convertido para double; o mapeamento deixa de ser necessário
+        int rc = alloc_coords(ds);
+        for (int d = 0; rc == 0 && d < ds->pts.d; d++) {
+            widen_column((const float *)(data + d * col) + ds->first, point_col(&ds->pts, d), n);
+        }
+        munmap(ds->map, ds->map_size);
+        ds->map = NULL;
+        if (rc != 0) return -1;
+    }
+    return 0;
+}
+
+// Lê bytes a partir de offset, repetindo enquanto pread devolver leituras parciais
+static int read_full(int fd, void *dst, size_t bytes, off_t offset) {
+    char *p = dst;
+    while (bytes > 0) {
+        ssize_t r = pread(fd, p, bytes, offset);
+        if (r <= 0) return -1;
+        p += r;
+        bytes -= (size_t)r;
+        offset += r;
+    }
+    return 0;
+}
+
+static int open_read(Dataset *ds, int fd, const DatasetHeader *h) {
+    int n = ds->pts.n;
+    size_t col  = dataset_column_bytes(h->n, h->dtype);
+    size_t elem = (h->dtype == DTYPE_F64) ? sizeof(double) : sizeof(float);
+    off_t  skip = (off_t)(sizeof(DatasetHeader) + (size_t)ds->first * elem);
+
+    if (alloc_coords(ds) != 0) return -1;
+    if (h->dtype == DTYPE_F64 && n == ds->total_n) {
+        // As colunas do arquivo já têm o mesmo passo das colunas em memória
+        return read_full(fd, ds->pts.coords, col * ds->pts.d, (off_t)sizeof(DatasetHeader));
+    }
+    if (h->dtype == DTYPE_F64) {
+        // Só uma parte dos pontos: lê a faixa de cada coluna
+        int rc = 0;
+        for (int d = 0; rc == 0 && d < ds->pts.d; d++) {
+            rc = read_full(fd, point_col(&ds->pts, d), (size_t)n * elem, skip + (off_t)(d * col));
+        }
+        return rc;
+    }
+
+    float *buf = alloc_aligned((size_t)n * elem);
+    if (buf == NULL) return -1;
+    int rc = 0;
+    for (int d = 0; rc == 0 && d < ds->pts.d; d++) {
+        rc = read_full(fd, buf, (size_t)n * elem, skip + (off_t)(d * col));
+        if (rc == 0) widen_column(buf, point_col(&ds->pts, d), n);
+    }
+    free(buf);
+    return rc;
+}
+
+int dataset_open(Dataset *ds, const char *path, int use_mmap) {
+    return dataset_open_part(ds, path, use_mmap, 0, 1);
+}
+
+// Abre a parte part de num_parts do arquivo: os blocos de ASSIGN_BLOCK pontos são
+// divididos em faixas contíguas (block_share), e só as colunas dessa faixa são
+// lidas. ds->first e ds->total_n dão a posição da parte no conjunto inteiro
+int dataset_open_part(Dataset *ds, const char *path, int use_mmap, int part, int num_parts) {
+    memset(ds, 0, sizeof(Dataset));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return -1;
+    }
+
+    DatasetHeader h;
+    struct stat sb;
+    if (fstat(fd, &sb) != 0 || read_full(fd, &h, sizeof(h), 0) != 0) {
+        fprintf(stderr, "%s: não foi possível ler o cabeçalho.\n", path);
+        close(fd);
+        return -1;
+    }
+    if (check_header(&h, path) != 0) {
+        close(fd);
+        return -1;
+    }
+    size_t file_size = sizeof(DatasetHeader) + h.d * dataset_column_bytes(h.n, h.dtype);
+    if ((size_t)sb.st_size < file_size) {
+        fprintf(stderr, "%s: arquivo truncado (%lld de %zu bytes).\n", path, (long long)sb.st_size, file_size);
+        close(fd);
+        return -1;
+    }
+
+    int first, last;
+    block_share((int)((h.n + ASSIGN_BLOCK - 1) / ASSIGN_BLOCK), part, num_parts, &first, &last);
+    ds->total_n    = (int)h.n;
+    ds->first      = first * ASSIGN_BLOCK;
+    ds->pts.n      = ((last * (uint64_t)ASSIGN_BLOCK < h.n) ? last * ASSIGN_BLOCK : (int)h.n) - ds->first;
+    ds->pts.d      = (int)h.d;
+    ds->pts.stride = points_stride(ds->pts.n);
+    int rc = use_mmap ? open_mapped(ds, fd, &h, file_size, path) : open_read(ds, fd, &h);
+    close(fd);
+    if (rc != 0) {
+        fprintf(stderr, "%s: erro ao carregar os pontos.\n", path);
+        dataset_close(ds);
+        return -1;
+    }
+    return 0;
+}
+
+void dataset_close(Dataset *ds) {
+    if (ds->owns_coords) free(ds->pts.coords);
+    if (ds->map != NULL) munmap(ds->map, ds->map_size);
+    memset(ds, 0, sizeof(Dataset));
+}
+
+// Leitura em lotes. A thread de E/S lê os lotes em ordem com pread, coluna a coluna,
+// para um conjunto fixo de buffers: o lote c vai para o buffer c % num_buffers, que
+// fica livre quando o lote c - num_buffers é devolvido. Enquanto as threads de
+// cálculo processam um lote, os seguintes já estão sendo lidos (com num_buffers = 1
+// leitura e cálculo se alternam, sem sobreposição). Antes de ler um lote, a thread
+// pede ao kernel a leitura antecipada do seguinte
+struct ChunkReader {
+    int             fd;
+    int             n;            // Pontos do arquivo
+    int             d;
+    uint32_t        dtype;
+    size_t          col_bytes;    // Bytes de uma coluna no arquivo (com o alinhamento)
+    int             chunk;        // Pontos por lote
+    int             num_chunks;
+    int             num_buffers;
+    Points          buf[CHUNK_MAX_BUFFERS];
+    float          *staging;      // Coluna de um lote em float32, antes da conversão
+    int             next_read;    // Próximo lote a ler (thread de E/S)
+    int             next_use;     // Próximo lote a entregar ao cálculo
+    int             released;     // Lotes já devolvidos pelo cálculo
+    int             in_use;       // 1 se o último lote entregue ainda não foi devolvido
+    int             stop;
+    int             failed;
+    int             running;      // 1 se a thread de E/S da passada atual existe
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    pthread_t       thread;
+    double          io_time;      // Tempo da thread de E/S em pread e na conversão
+    double          wait_time;    // Tempo do cálculo esperando lotes
+};
+
+// Bytes de cada coluna do lote c a partir de offset (posição do lote no arquivo)
+static void chunk_range(const ChunkReader *r, int c, off_t *offset, size_t *bytes) {
+    size_t elem  = (r->dtype == DTYPE_F64) ? sizeof(double) : sizeof(float);
+    int    begin = c * r->chunk;
+    int    n     = (r->n - begin < r->chunk) ? r->n - begin : r->chunk;
+    *offset = (off_t)(sizeof(DatasetHeader) + (size_t)begin * elem);
+    *bytes  = (size_t)n * elem;
+}
+
+static int read_chunk(ChunkReader *r, int c) {
+    Points *p = &r->buf[c % r->num_buffers];
+    off_t  offset;
+    size_t bytes;
+    chunk_range(r, c, &offset, &bytes);
+    p->n = (r->n - c * r->chunk < r->chunk) ? r->n - c * r->chunk : r->chunk;
+
+    // Leitura antecipada do lote seguinte, enquanto este é lido
+    if (c + 1 < r->num_chunks) {
+        off_t  next_offset;
+        size_t next_bytes;
+        chunk_range(r, c + 1, &next_offset, &next_bytes);
+        for (int d = 0; d < r->d; d++) {
+            posix_fadvise(r->fd, next_offset + (off_t)(d * r->col_bytes), (off_t)next_bytes, POSIX_FADV_WILLNEED);
+        }
+    }
+
+    for (int d = 0; d < r->d; d++) {
+        off_t at = offset + (off_t)(d * r->col_bytes);
+        if (r->dtype == DTYPE_F64) {
+            if (read_full(r->fd, point_col(p, d), bytes, at) != 0) return -1;
+        } else {
+            if (read_full(r->fd, r->staging, bytes, at) != 0) return -1;
+            double *col = point_col(p, d);
+            for (int i = 0; i < p->n; i++) col[i] = r->staging[i];
+        }
+    }
+    return 0;
+}
+
+static void *reader_main(void *arg) {
+    ChunkReader *r = arg;
+    pthread_mutex_lock(&r->lock);
+    while (!r->stop && r->next_read < r->num_chunks) {
+        while (!r->stop && r->next_read - r->released >= r->num_buffers) pthread_cond_wait(&r->cond, &r->lock);
+        if (r->stop) break;
+        int c = r->next_read;
+        pthread_mutex_unlock(&r->lock);
+
+        double start = omp_get_wtime();
+        int rc = read_chunk(r, c);
+        double elapsed = omp_get_wtime() - start;
+
+        pthread_mutex_lock(&r->lock);
+        r->io_time += elapsed;
+        if (rc != 0) r->failed = 1;
+        else r->next_read++;
+        pthread_cond_broadcast(&r->cond);
+        if (rc != 0) break;
+    }
+    pthread_mutex_unlock(&r->lock);
+    return NULL;
+}
+
+// Encerra a passada atual (se houver) e espera a thread de E/S
+static void chunks_stop(ChunkReader *r) {
+    if (!r->running) return;
+    pthread_mutex_lock(&r->lock);
+    r->stop = 1;
+    pthread_cond_broadcast(&r->cond);
+    pthread_mutex_unlock(&r->lock);
+    pthread_join(r->thread, NULL);
+    r->running = 0;
+}
+
+ChunkReader *chunks_open(const char *path, int chunk, int num_buffers) {
+    if (chunk < 1 || num_buffers < 1 || num_buffers > CHUNK_MAX_BUFFERS) return NULL;
+    ChunkReader *r = calloc(1, sizeof(ChunkReader));
+    if (r == NULL) return NULL;
+
+    r->fd = open(path, O_RDONLY);
+    if (r->fd < 0) {
+        perror(path);
+        free(r);
+        return NULL;
+    }
+
+    DatasetHeader h;
+    struct stat sb;
+    int ok = fstat(r->fd, &sb) == 0 && read_full(r->fd, &h, sizeof(h), 0) == 0;
+    if (!ok) fprintf(stderr, "%s: não foi possível ler o cabeçalho.\n", path);
+    if (ok && check_header(&h, path) != 0) ok = 0;
+    if (ok && (size_t)sb.st_size < sizeof(DatasetHeader) + h.d * dataset_column_bytes(h.n, h.dtype)) {
+        fprintf(stderr, "%s: arquivo truncado.\n", path);
+        ok = 0;
+    }
+    if (!ok) {
+        close(r->fd);
+        free(r);
+        return NULL;
+    }
+
+    r->n           = (int)h.n;
+    r->d           = (int)h.d;
+    r->dtype       = h.dtype;
+    r->col_bytes   = dataset_column_bytes(h.n, h.dtype);
+    r->chunk       = (chunk < r->n) ? chunk : r->n;
+    r->num_chunks  = (r->n + r->chunk - 1) / r->chunk;
+    r->num_buffers = num_buffers;
+    pthread_mutex_init(&r->lock, NULL);
+    pthread_cond_init(&r->cond, NULL);
+    posix_fadvise(r->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    for (int b = 0; b < num_buffers; b++) ok = ok && alloc_points(&r->buf[b], r->chunk, r->d) == 0;
+    if (ok && r->dtype == DTYPE_F32) {
+        r->staging = alloc_aligned((size_t)r->chunk * sizeof(float));
+        ok = r->staging != NULL;
+    }
+    if (!ok) {
+        fprintf(stderr, "%s: erro ao alocar os buffers de leitura.\n", path);
+        chunks_close(r);
+        return NULL;
+    }
+    return r;
+}
+
+void chunks_close(ChunkReader *r) {
+    if (r == NULL) return;
+    chunks_stop(r);
+    for (int b = 0; b < r->num_buffers; b++) free_points(&r->buf[b]);
+    free(r->staging);
+    pthread_mutex_destroy(&r->lock);
+    pthread_cond_destroy(&r->cond);
+    close(r->fd);
+    free(r);
+}
+
+int chunks_points(const ChunkReader *r) { return r->n; }
+int chunks_dims(const ChunkReader *r)   { return r->d; }
+int chunks_size(const ChunkReader *r)   { return r->chunk; }
+
+int chunks_start(ChunkReader *r) {
+    chunks_stop(r);
+    r->next_read = r->next_use = r->released = 0;
+    r->in_use    = r->stop = r->failed = 0;
+    r->io_time   = r->wait_time = 0.0;
+    if (pthread_create(&r->thread, NULL, reader_main, r) != 0) return -1;
+    r->running = 1;
+    return 0;
+}
+
+int chunks_next(ChunkReader *r, Points **chunk, long long *first) {
+    pthread_mutex_lock(&r->lock);
+    if (r->in_use) {
+        r->released++;
+        r->in_use = 0;
+        pthread_cond_broadcast(&r->cond);
+    }
+    if (r->next_use == r->num_chunks) {
+        pthread_mutex_unlock(&r->lock);
+        return 0;
+    }
+
+    double start = omp_get_wtime();
+    while (r->next_read <= r->next_use && !r->failed) pthread_cond_wait(&r->cond, &r->lock);
+    r->wait_time += omp_get_wtime() - start;
+    int rc = r->failed ? -1 : 1;
+    if (rc == 1) {
+        *chunk = &r->buf[r->next_use % r->num_buffers];
+        *first = (long long)r->next_use * r->chunk;
+        r->next_use++;
+        r->in_use = 1;
+    }
+    pthread_mutex_unlock(&r->lock);
+    return rc;
+}
+
+void chunks_times(ChunkReader *r, double *io_time, double *wait_time) {
+    pthread_mutex_lock(&r->lock);
+    *io_time   = r->io_time;
+    *wait_time = r->wait_time;
+    pthread_mutex_unlock(&r->lock);
+}
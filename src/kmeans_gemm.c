@@ -0,0 +1,388 @@
+#include <stdlib.h>
+#include <math.h>
+#include <float.h>
+#include <omp.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KMEANS_X86 1
+#endif
+
+#include "kmeans.h"
+
+// Engine gemm: para D grande, a distância de cada par vira ||x||² - 2 x·c + ||c||²,
+// e os produtos x·c de um bloco de pontos contra um bloco de centróides são
+// calculados como um produto de matrizes, no estilo do BLIS:
+// - um painel de pontos (cabe na L2) é percorrido uma vez para cada painel de
+//   centróides (cabe na L1), e os dois são relidos da cache;
+// - dentro dos painéis, um microkernel calcula MR pontos x NR centróides em
+//   registradores: cada coordenada de MR pontos é carregada uma vez para NR
+//   centróides, e cada coordenada de centróide uma vez para MR pontos;
+// - os centróides são empacotados em faixas de NR, coordenada a coordenada, com as
+//   normas ||c||², uma vez por iteração; as normas dos pontos são calculadas uma vez
+//   no create.
+// A forma expandida perde precisão por cancelamento quando ||x|| é grande perto da
+// distância. Cada ponto guarda a menor e a segunda menor distância aproximada; se a
+// diferença cabe no erro máximo da expansão (proporcional a (||x|| + max ||c||)²),
+// o ponto é recalculado com a distância exata dos outros kernels. Assim os rótulos
+// são os mesmos da força bruta, e os microkernels podem usar FMA.
+
+#define GEMM_L1_BYTES (32 * 1024)   // Painel de centróides
+#define GEMM_L2_BYTES (256 * 1024)  // Painel de pontos
+#define GEMM_SLACK    8.0           // Folga sobre o erro de arredondamento da expansão
+
+// Faixa de MR pontos (a partir de x, com as normas em xn) contra os centróides
+// [j0, j1) empacotados: atualiza a menor distância, a segunda menor e o índice da
+// menor de cada ponto
+typedef void (*strip_fn)(const double *x, size_t stride, int D, const double *pack, const double *cnorm,
+                         int j0, int j1, const double *xn, double *best, double *second, int *idx);
+
+typedef struct {
+    int       k;
+    int       k_pad;        // k arredondado para múltiplo de NR (sentinelas com ||c||² = +inf)
+    int       mr, nr;       // Pontos e centróides do microkernel
+    int       mc, nc;       // Pontos e centróides de cada painel
+    strip_fn  strip;
+    double   *norm;         // ||x||² de cada ponto
+    double   *root;         // ||x|| de cada ponto (para o erro máximo)
+    double   *pack;         // Centróides em faixas de NR: pack[j * D + d * NR + r] = c[j + r][d]
+    double   *cnorm;        // ||c||² (k_pad)
+    double    cmax;         // Maior ||c||
+    int       num_threads;
+    double   *best;         // Menor e segunda menor distância aproximada e índice da menor,
+    double   *second;       // mc por thread
+    int      *idx;
+} GemmState;
+
+// Atualiza menor, segunda menor e índice com a distância v do centróide j
+static inline void keep_two(double v, int j, double *best, double *second, int *idx) {
+    int lt  = v < *best;
+    *second = lt ? *best : (v < *second ? v : *second);
+    *idx    = lt ? j : *idx;
+    *best   = lt ? v : *best;
+}
+
+// Microkernel escalar: 4 pontos x 4 centróides
+#define SCALAR_MR 4
+#define SCALAR_NR 4
+static void strip_scalar(const double *x, size_t stride, int D, const double *pack, const double *cnorm,
+                         int j0, int j1, const double *xn, double *best, double *second, int *idx) {
+    for (int j = j0; j < j1; j += SCALAR_NR) {
+        const double *cp = pack + (size_t)j * D;
+        double acc[SCALAR_MR][SCALAR_NR] = { { 0.0 } };
+        for (int d = 0; d < D; d++) {
+            const double *xd = x + d * stride;
+            for (int p = 0; p < SCALAR_MR; p++) {
+                for (int r = 0; r < SCALAR_NR; r++) acc[p][r] += xd[p] * cp[d * SCALAR_NR + r];
+            }
+        }
+        for (int p = 0; p < SCALAR_MR; p++) {
+            for (int r = 0; r < SCALAR_NR; r++) {
+                keep_two(xn[p] - 2.0 * acc[p][r] + cnorm[j + r], j + r, &best[p], &second[p], &idx[p]);
+            }
+        }
+    }
+}
+
+#ifdef KMEANS_X86
+// Microkernel AVX2: 8 pontos (dois registradores) x 4 centróides, 8 acumuladores
+#define AVX2_MR 8
+#define AVX2_NR 4
+__attribute__((target("avx2,fma")))
+static void strip_avx2(const double *x, size_t stride, int D, const double *pack, const double *cnorm,
+                       int j0, int j1, const double *xn, double *best, double *second, int *idx) {
+    __m256d b0 = _mm256_loadu_pd(best), b1 = _mm256_loadu_pd(best + 4);
+    __m256d s0 = _mm256_loadu_pd(second), s1 = _mm256_loadu_pd(second + 4);
+    __m256d i0 = _mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i *)idx));
+    __m256d i1 = _mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i *)(idx + 4)));
+    __m256d n0 = _mm256_loadu_pd(xn), n1 = _mm256_loadu_pd(xn + 4);
+    __m256d minus2 = _mm256_set1_pd(-2.0);
+
+    for (int j = j0; j < j1; j += AVX2_NR) {
+        const double *cp = pack + (size_t)j * D;
+        __m256d a[AVX2_NR][2];
+        #pragma GCC unroll 4
+        for (int r = 0; r < AVX2_NR; r++) a[r][0] = a[r][1] = _mm256_setzero_pd();
+
+        for (int d = 0; d < D; d++) {
+            __m256d x0 = _mm256_loadu_pd(x + d * stride);
+            __m256d x1 = _mm256_loadu_pd(x + d * stride + 4);
+            #pragma GCC unroll 4
+            for (int r = 0; r < AVX2_NR; r++) {
+                __m256d cd = _mm256_broadcast_sd(cp + d * AVX2_NR + r);
+                a[r][0] = _mm256_fmadd_pd(x0, cd, a[r][0]);
+                a[r][1] = _mm256_fmadd_pd(x1, cd, a[r][1]);
+            }
+        }
+
+        #pragma GCC unroll 4
+        for (int r = 0; r < AVX2_NR; r++) {
+            __m256d cn  = _mm256_broadcast_sd(cnorm + j + r);
+            __m256d jv  = _mm256_set1_pd((double)(j + r));
+            __m256d v0  = _mm256_add_pd(_mm256_fmadd_pd(minus2, a[r][0], n0), cn);
+            __m256d v1  = _mm256_add_pd(_mm256_fmadd_pd(minus2, a[r][1], n1), cn);
+            __m256d lt0 = _mm256_cmp_pd(v0, b0, _CMP_LT_OQ);
+            __m256d lt1 = _mm256_cmp_pd(v1, b1, _CMP_LT_OQ);
+            s0 = _mm256_blendv_pd(_mm256_min_pd(s0, v0), b0, lt0);
+            s1 = _mm256_blendv_pd(_mm256_min_pd(s1, v1), b1, lt1);
+            b0 = _mm256_blendv_pd(b0, v0, lt0);
+            b1 = _mm256_blendv_pd(b1, v1, lt1);
+            i0 = _mm256_blendv_pd(i0, jv, lt0);
+            i1 = _mm256_blendv_pd(i1, jv, lt1);
+        }
+    }
+
+    _mm256_storeu_pd(best, b0);
+    _mm256_storeu_pd(best + 4, b1);
+    _mm256_storeu_pd(second, s0);
+    _mm256_storeu_pd(second + 4, s1);
+    _mm_storeu_si128((__m128i *)idx,       _mm256_cvttpd_epi32(i0));
+    _mm_storeu_si128((__m128i *)(idx + 4), _mm256_cvttpd_epi32(i1));
+}
+
+// Microkernel AVX-512: 16 pontos (dois registradores) x 8 centróides, 16 acumuladores
+#define AVX512_MR 16
+#define AVX512_NR 8
+__attribute__((target("avx512f")))
+static void strip_avx512(const double *x, size_t stride, int D, const double *pack, const double *cnorm,
+                         int j0, int j1, const double *xn, double *best, double *second, int *idx) {
+    __m512d b0 = _mm512_loadu_pd(best), b1 = _mm512_loadu_pd(best + 8);
+    __m512d s0 = _mm512_loadu_pd(second), s1 = _mm512_loadu_pd(second + 8);
+    __m512d i0 = _mm512_cvtepi32_pd(_mm256_loadu_si256((const __m256i *)idx));
+    __m512d i1 = _mm512_cvtepi32_pd(_mm256_loadu_si256((const __m256i *)(idx + 8)));
+    __m512d n0 = _mm512_loadu_pd(xn), n1 = _mm512_loadu_pd(xn + 8);
+    __m512d minus2 = _mm512_set1_pd(-2.0);
+
+    for (int j = j0; j < j1; j += AVX512_NR) {
+        const double *cp = pack + (size_t)j * D;
+        __m512d a[AVX512_NR][2];
+        #pragma GCC unroll 8
+        for (int r = 0; r < AVX512_NR; r++) a[r][0] = a[r][1] = _mm512_setzero_pd();
+
+        for (int d = 0; d < D; d++) {
+            __m512d x0 = _mm512_loadu_pd(x + d * stride);
+            __m512d x1 = _mm512_loadu_pd(x + d * stride + 8);
+            #pragma GCC unroll 8
+            for (int r = 0; r < AVX512_NR; r++) {
+                __m512d cd = _mm512_set1_pd(cp[d * AVX512_NR + r]);
+                a[r][0] = _mm512_fmadd_pd(x0, cd, a[r][0]);
+                a[r][1] = _mm512_fmadd_pd(x1, cd, a[r][1]);
+            }
+        }
+
+        #pragma GCC unroll 8
+        for (int r = 0; r < AVX512_NR; r++) {
+            __m512d cn  = _mm512_set1_pd(cnorm[j + r]);
+            __m512d jv  = _mm512_set1_pd((double)(j + r));
+            __m512d v0  = _mm512_add_pd(_mm512_fmadd_pd(minus2, a[r][0], n0), cn);
+            __m512d v1  = _mm512_add_pd(_mm512_fmadd_pd(minus2, a[r][1], n1), cn);
+            __mmask8 lt0 = _mm512_cmp_pd_mask(v0, b0, _CMP_LT_OQ);
+            __mmask8 lt1 = _mm512_cmp_pd_mask(v1, b1, _CMP_LT_OQ);
+            s0 = _mm512_mask_blend_pd(lt0, _mm512_min_pd(s0, v0), b0);
+            s1 = _mm512_mask_blend_pd(lt1, _mm512_min_pd(s1, v1), b1);
+            b0 = _mm512_mask_blend_pd(lt0, b0, v0);
+            b1 = _mm512_mask_blend_pd(lt1, b1, v1);
+            i0 = _mm512_mask_blend_pd(lt0, i0, jv);
+            i1 = _mm512_mask_blend_pd(lt1, i1, jv);
+        }
+    }
+
+    _mm512_storeu_pd(best, b0);
+    _mm512_storeu_pd(best + 8, b1);
+    _mm512_storeu_pd(second, s0);
+    _mm512_storeu_pd(second + 8, s1);
+    _mm256_storeu_si256((__m256i *)idx,       _mm512_cvttpd_epi32(i0));
+    _mm256_storeu_si256((__m256i *)(idx + 8), _mm512_cvttpd_epi32(i1));
+}
+#endif
+
+// Rótulo exato do ponto i: a mesma conta e o mesmo desempate (menor índice) do
+// kernel escalar de kmeans_assign.c
+static int exact_label(const Points *pts, int i, const Centroids *c) {
+    double minDist = INFINITY;
+    int bestCluster = 0;
+    for (int j = 0; j < c->k; j++) {
+        const double *cj = c->pos + (size_t)j * c->d;
+        double d2 = 0.0;
+        for (int d = 0; d < c->d; d++) {
+            double t = pts->coords[d * pts->stride + i] - cj[d];
+            d2 += t * t;
+        }
+        bestCluster = (d2 < minDist) ? j  : bestCluster;
+        minDist     = (d2 < minDist) ? d2 : minDist;
+    }
+    return bestCluster;
+}
+
+void gemm_destroy(void *state) {
+    GemmState *st = state;
+    if (st == NULL) return;
+    free(st->norm);
+    free(st->root);
+    free(st->pack);
+    free(st->cnorm);
+    free(st->best);
+    free(st->second);
+    free(st->idx);
+    free(st);
+}
+
+void *gemm_create(const Points *pts, int k) {
+    GemmState *st = calloc(1, sizeof(GemmState));
+    if (st == NULL) return NULL;
+
+    // Microkernel conforme o conjunto de instruções (o AVX2 também precisa de FMA)
+    int D = pts->d;
+    st->strip = strip_scalar;
+    st->mr    = SCALAR_MR;
+    st->nr    = SCALAR_NR;
+#ifdef KMEANS_X86
+    if (current_simd() == SIMD_AVX512) {
+        st->strip = strip_avx512;
+        st->mr    = AVX512_MR;
+        st->nr    = AVX512_NR;
+    } else if (current_simd() == SIMD_AVX2 && __builtin_cpu_supports("fma")) {
+        st->strip = strip_avx2;
+        st->mr    = AVX2_MR;
+        st->nr    = AVX2_NR;
+    }
+#endif
+
+    // Painéis: pontos na L2 e centróides na L1, em múltiplos do microkernel
+    size_t row   = (size_t)D * sizeof(double);
+    st->k        = k;
+    st->k_pad    = (k + st->nr - 1) / st->nr * st->nr;
+    st->mc       = (int)(GEMM_L2_BYTES / row) / st->mr * st->mr;
+    st->nc       = (int)(GEMM_L1_BYTES / row) / st->nr * st->nr;
+    if (st->mc < st->mr) st->mc = st->mr;
+    if (st->mc > ASSIGN_BLOCK) st->mc = ASSIGN_BLOCK;
+    if (st->nc < st->nr) st->nc = st->nr;
+    if (st->nc > st->k_pad) st->nc = st->k_pad;
+
+    st->num_threads = omp_get_max_threads();
+    size_t slots    = (size_t)st->num_threads * st->mc;
+    st->norm   = alloc_aligned((size_t)pts->n * sizeof(double));
+    st->root   = alloc_aligned((size_t)pts->n * sizeof(double));
+    st->pack   = alloc_aligned((size_t)st->k_pad * D * sizeof(double));
+    st->cnorm  = alloc_aligned((size_t)st->k_pad * sizeof(double));
+    st->best   = alloc_aligned(slots * sizeof(double));
+    st->second = alloc_aligned(slots * sizeof(double));
+    st->idx    = alloc_aligned(slots * sizeof(int));
+    if (st->norm == NULL || st->root == NULL || st->pack == NULL || st->cnorm == NULL || st->best == NULL ||
+        st->second == NULL || st->idx == NULL) {
+        gemm_destroy(st);
+        return NULL;
+    }
+
+    // Normas dos pontos: os pontos não mudam durante o fit
+    int num_blocks = (pts->n + ASSIGN_BLOCK - 1) / ASSIGN_BLOCK;
+    #pragma omp parallel
+    {
+      int first, last;
+      thread_blocks(num_blocks, &first, &last);
+      int end = (last * ASSIGN_BLOCK < pts->n) ? last * ASSIGN_BLOCK : pts->n;
+      for (int i = first * ASSIGN_BLOCK; i < end; i++) {
+          double s = 0.0;
+          for (int d = 0; d < D; d++) {
+              double v = pts->coords[d * pts->stride + i];
+              s += v * v;
+          }
+          st->norm[i] = s;
+          st->root[i] = sqrt(s);
+      }
+    }
+    return st;
+}
+
+// Empacota os centróides em faixas de NR e calcula as normas (uma vez por iteração)
+static void pack_centroids(GemmState *st, const Centroids *c) {
+    int D = c->d, nr = st->nr;
+    #pragma omp parallel for schedule(static)
+    for (int j = 0; j < st->k_pad; j++) {
+        double *dst = st->pack + (size_t)(j / nr * nr) * D + j % nr;
+        double  s   = 0.0;
+        for (int d = 0; d < D; d++) {
+            double v = (j < c->k) ? c->pos[(size_t)j * D + d] : 0.0;
+            dst[d * nr] = v;
+            s += v * v;
+        }
+        st->cnorm[j] = (j < c->k) ? s : INFINITY;
+    }
+
+    st->cmax = 0.0;
+    for (int j = 0; j < c->k; j++) st->cmax = dmax(st->cmax, st->cnorm[j]);
+    st->cmax = sqrt(st->cmax);
+}
+
+int iterate_gemm(void *state, Points *pts, const Centroids *c, assign_kernel_fn kernel, Sums *sums) {
+    GemmState *st = state;
+    (void)kernel;
+    int num_points = pts->n;
+    int num_blocks = (num_points + ASSIGN_BLOCK - 1) / ASSIGN_BLOCK;
+    int D          = pts->d;
+    int changed    = 0;
+
+    pack_centroids(st, c);
+    Sums *locals = thread_sums(sums);
+    if (locals == NULL) return -1;
+
+    // Erro máximo da forma expandida em relação à distância exata, por (||x|| + max ||c||)²
+    double eps = GEMM_SLACK * (D + 4) * DBL_EPSILON;
+
+    #pragma omp parallel reduction(+:changed)
+    {
+      int     t      = omp_get_thread_num();
+      Sums   *local  = &locals[t];
+      double *best   = st->best + (size_t)t * st->mc;
+      double *second = st->second + (size_t)t * st->mc;
+      int    *idx    = st->idx + (size_t)t * st->mc;
+
+      int first, last;
+      thread_blocks(num_blocks, &first, &last);
+      int end = (last * ASSIGN_BLOCK < num_points) ? last * ASSIGN_BLOCK : num_points;
+      for (int p0 = first * ASSIGN_BLOCK; p0 < end; p0 += st->mc) {
+        int p1   = (p0 + st->mc < end) ? p0 + st->mc : end;
+        int full = p0 + (p1 - p0) / st->mr * st->mr;
+        for (int l = 0; l < full - p0; l++) {
+            best[l]   = INFINITY;
+            second[l] = INFINITY;
+            idx[l]    = 0;
+        }
+
+        // Painel de pontos [p0, full) contra cada painel de centróides
+        for (int j0 = 0; j0 < st->k_pad; j0 += st->nc) {
+            int j1 = (j0 + st->nc < st->k_pad) ? j0 + st->nc : st->k_pad;
+            for (int i = p0; i < full; i += st->mr) {
+                st->strip(pts->coords + i, pts->stride, D, st->pack, st->cnorm, j0, j1, st->norm + i,
+                          best + (i - p0), second + (i - p0), idx + (i - p0));
+            }
+        }
+
+        // Rótulos (recalculados se a menor e a segunda menor estão dentro do erro, e
+        // nos pontos que não completam uma faixa) e somas por centróide
+        for (int i = p0; i < p1; i++) {
+            int l = i - p0, label;
+            if (i < full) {
+                double bound = st->root[i] + st->cmax;
+                label = (second[l] - best[l] <= eps * bound * bound) ? exact_label(pts, i, c) : idx[l];
+            } else {
+                label = exact_label(pts, i, c);
+            }
+            changed += (pts->labels[i] != label);
+            pts->labels[i] = (label_t)label;
+
+            double *row = local->sum + (size_t)label * D;
+            for (int d = 0; d < D; d++) row[d] += pts->coords[d * pts->stride + i];
+            local->count[label]++;
+        }
+      }
+
+      TRACE_BUSY();
+      #pragma omp barrier
+      TRACE_MARK(TRACE_ASSIGN);
+      reduce_thread_sums(sums);
+    }
+    TRACE_MARK(TRACE_MERGE);
+
+    return changed;
+}
@@ -0,0 +1,385 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <omp.h>
+
+#include "kmeans.h"
+
+// Atualização incremental (kmeans_update da libkmeans). Parte dos centróides, das
+// somas e contagens por cluster e das folgas por ponto do último fit ou atualização,
+// absorve os pontos adicionados e removidos direto nas somas e roda passos locais de
+// Lloyd só sobre os pontos que podem ter mudado de cluster.
+//
+// A prova vem dos limitantes de Hamerly: se x está em j com u = d(x, c_j) e l a menor
+// distância aos outros centróides, e desde então c_j andou no máximo drift[j] e
+// qualquer centróide no máximo drift_max, então d(x, c_j) <= u + drift[j] e as
+// outras distâncias são >= l - drift_max; com gap = l - u >= drift[j] + drift_max, j
+// continua o mais próximo. As folgas ficam fixas e os deslocamentos só se acumulam,
+// então os pontos de uma lista que precisam de distâncias são sempre um prefixo dela,
+// e um passo custa o tamanho desses prefixos mais os pontos novos, não N. Quando eles
+// passam de 1 / INC_REBUILD dos pontos, o estado é remontado: os pontos fora dos
+// prefixos recebem a folga descontada dos deslocamentos, os de dentro são medidos de
+// novo e as somas são refeitas do zero (sem o arredondamento acumulado nas trocas).
+
+#define INC_REBUILD 8 // Remonta o estado quando mais de 1 / INC_REBUILD dos pontos está em reavaliação
+
+// Folga em float arredondada para baixo (a prova não pode ficar mais frouxa)
+static inline float gap_down(double g) {
+    float f = (float)g;
+    return ((double)f > g) ? nextafterf(f, -INFINITY) : f;
+}
+
+// Folgas dos pontos [begin, end) marcados com NaN em gap, descontada a tolerância
+// das comparações. As distâncias de todos os pontos do bloco a cada centróide são
+// acumuladas coluna a coluna, na ordem de distance_sq
+static void block_gaps(const Points *pts, int begin, int end, const Centroids *c, float *gap, double tol) {
+    int count = end - begin, pending = 0;
+    for (int i = begin; i < end; i++) pending |= pts->labels[i] != NO_LABEL && isnan(gap[i]);
+    if (!pending) return;
+
+    double own[ASSIGN_BLOCK], other[ASSIGN_BLOCK], dist[ASSIGN_BLOCK];
+    for (int l = 0; l < count; l++) other[l] = INFINITY;
+    for (int j = 0; j < c->k; j++) {
+        const double *cj = centroid(c, j);
+        for (int l = 0; l < count; l++) dist[l] = 0.0;
+        for (int e = 0; e < c->d; e++) {
+            const double *col = point_col(pts, e) + begin;
+            for (int l = 0; l < count; l++) {
+                double t = col[l] - cj[e];
+                dist[l] += t * t;
+            }
+        }
+        for (int l = 0; l < count; l++) {
+            if (pts->labels[begin + l] == j) own[l] = dist[l];
+            else other[l] = dmin(other[l], dist[l]);
+        }
+    }
+    for (int l = 0; l < count; l++) {
+        int i = begin + l;
+        if (pts->labels[i] != NO_LABEL && isnan(gap[i])) gap[i] = gap_down(sqrt(other[l]) - sqrt(own[l]) - tol);
+    }
+}
+
+void inc_free(Incremental *s) {
+    free(s->sum);
+    free(s->count);
+    free(s->entries);
+    free(s->start);
+    free(s->visited);
+    free(s->drift);
+    free(s->cand);
+    free_points(&s->work);
+    memset(s, 0, sizeof(*s));
+}
+
+// Vetores por cluster (alocados uma vez) e listas para n pontos (só crescem)
+static int inc_alloc(Incremental *s, int k, int d, int n) {
+    if (s->sum == NULL) {
+        s->k       = k;
+        s->d       = d;
+        s->sum     = malloc((size_t)k * d * sizeof(double));
+        s->count   = malloc((size_t)k * sizeof(long long));
+        s->start   = malloc((size_t)(k + 1) * sizeof(int));
+        s->visited = malloc((size_t)k * sizeof(int));
+        s->drift   = malloc((size_t)k * sizeof(double));
+        if (s->sum == NULL || s->count == NULL || s->start == NULL || s->visited == NULL || s->drift == NULL) {
+            inc_free(s);
+            return -1;
+        }
+    }
+    if (n > s->entries_cap) {
+        free(s->entries);
+        s->entries     = malloc((size_t)n * sizeof(GapEntry));
+        s->entries_cap = (s->entries != NULL) ? n : 0;
+        if (s->entries == NULL) return -1;
+    }
+    return 0;
+}
+
+static int compare_entries(const void *a, const void *b) {
+    const GapEntry *x = a, *y = b;
+    if (x->gap != y->gap) return (x->gap < y->gap) ? -1 : 1;
+    return (x->index > y->index) - (x->index < y->index);
+}
+
+// Monta as listas dos clusters (counting sort pelo rótulo, depois cada lista pela
+// folga) e zera os deslocamentos e os pontos em reavaliação
+static void build_lists(Incremental *s, const label_t *labels, const float *gap, int n) {
+    int k = s->k;
+    memset(s->start, 0, (size_t)(k + 1) * sizeof(int));
+    for (int i = 0; i < n; i++) {
+        if (labels[i] != NO_LABEL) s->start[labels[i] + 1]++;
+    }
+    for (int j = 0; j < k; j++) s->start[j + 1] += s->start[j];
+
+    memcpy(s->visited, s->start, (size_t)k * sizeof(int));
+    for (int i = 0; i < n; i++) {
+        if (labels[i] == NO_LABEL) continue;
+        GapEntry e = { gap[i], i };
+        s->entries[s->visited[labels[i]]++] = e;
+    }
+    #pragma omp parallel for schedule(dynamic)
+    for (int j = 0; j < k; j++) {
+        qsort(s->entries + s->start[j], (size_t)(s->start[j + 1] - s->start[j]), sizeof(GapEntry), compare_entries);
+    }
+
+    memset(s->visited, 0, (size_t)k * sizeof(int));
+    for (int j = 0; j < k; j++) s->drift[j] = 0.0;
+    s->drift_max = 0.0;
+    s->num_cand  = 0;
+}
+
+// Folga atual de cada ponto coberto: a da lista descontada dos deslocamentos desde a
+// montagem, ou mark para os pontos em reavaliação (e os removidos)
+static void collect_gaps(const Incremental *s, float *gap, float mark) {
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < s->n; i++) gap[i] = mark;
+
+    #pragma omp parallel for schedule(dynamic)
+    for (int j = 0; j < s->k; j++) {
+        double slack = s->drift[j] + s->drift_max;
+        for (int p = s->start[j] + s->visited[j]; p < s->start[j + 1]; p++) {
+            gap[s->entries[p].index] = gap_down((double)s->entries[p].gap - slack);
+        }
+    }
+}
+
+void inc_gaps(const Incremental *s, float *gap) {
+    collect_gaps(s, gap, -INFINITY);
+}
+
+// Mede a folga dos pontos marcados com NaN em gap, refaz as somas e contagens a partir
+// dos rótulos (parciais por thread somadas em ordem fixa) e monta as listas
+static int measure(Incremental *s, const Points *pts, const Centroids *c, float *gap) {
+    int k = s->k, d = s->d, n = pts->n;
+    size_t width = (size_t)k * (d + 1);
+    int num_blocks  = (n + ASSIGN_BLOCK - 1) / ASSIGN_BLOCK;
+    int num_threads = omp_get_max_threads();
+    double *locals = malloc((size_t)num_threads * width * sizeof(double));
+    if (locals == NULL) return -1;
+    double tol = bound_tolerance(pts);
+
+    #pragma omp parallel
+    {
+      double *local = locals + (size_t)omp_get_thread_num() * width;
+      double *count = local + (size_t)k * d;
+      memset(local, 0, width * sizeof(double));
+
+      int first, last;
+      thread_blocks(num_blocks, &first, &last);
+      for (int b = first; b < last; b++) {
+        int begin = b * ASSIGN_BLOCK;
+        int end   = (begin + ASSIGN_BLOCK < n) ? begin + ASSIGN_BLOCK : n;
+        block_gaps(pts, begin, end, c, gap, tol);
+        for (int e = 0; e < d; e++) {
+          const double *col = point_col(pts, e);
+          for (int i = begin; i < end; i++) {
+            if (pts->labels[i] != NO_LABEL) local[(size_t)pts->labels[i] * d + e] += col[i];
+          }
+        }
+        for (int i = begin; i < end; i++) {
+          if (pts->labels[i] != NO_LABEL) count[pts->labels[i]] += 1.0;
+        }
+      }
+    }
+
+    #pragma omp parallel for schedule(static)
+    for (size_t x = 0; x < width; x++) {
+        double sum = 0.0;
+        for (int t = 0; t < num_threads; t++) sum += locals[(size_t)t * width + x];
+        if (x < (size_t)k * d) s->sum[x] = sum;
+        else s->count[x - (size_t)k * d] = (long long)sum;
+    }
+    free(locals);
+
+    build_lists(s, pts->labels, gap, n);
+    return 0;
+}
+
+int inc_build(Incremental *s, const Points *pts, const Centroids *c) {
+    s->ready = 0;
+    if (inc_alloc(s, c->k, c->d, pts->n) != 0) return -1;
+    float *gap = malloc((size_t)(pts->n > 0 ? pts->n : 1) * sizeof(float));
+    if (gap == NULL) return -1;
+
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < pts->n; i++) gap[i] = NAN;
+    s->n = pts->n;
+    int result = measure(s, pts, c, gap);
+    free(gap);
+
+    s->ready = (result == 0);
+    return result;
+}
+
+int inc_restore(Incremental *s, int k, int d, int n, const double *sum, const long long *count,
+                const label_t *labels, const float *gap) {
+    s->ready = 0;
+    if (inc_alloc(s, k, d, n) != 0) return -1;
+    memcpy(s->sum, sum, (size_t)k * d * sizeof(double));
+    memcpy(s->count, count, (size_t)k * sizeof(long long));
+    s->n = n;
+    build_lists(s, labels, gap, n);
+    s->ready = 1;
+    return 0;
+}
+
+// Soma (sign = 1) ou tira (sign = -1) o ponto p das somas do cluster j
+static inline void move_point(Incremental *s, int j, const double *p, int sign) {
+    double *row = s->sum + (size_t)j * s->d;
+    for (int e = 0; e < s->d; e++) row[e] += sign * p[e];
+    s->count[j] += sign;
+}
+
+// Centróides nas médias das somas (clusters vazios ficam onde estão). Acumula os
+// deslocamentos e retorna o maior deste passo
+static double move_centroids(Incremental *s, Centroids *c) {
+    double moved = 0.0;
+    for (int j = 0; j < s->k; j++) {
+        if (s->count[j] == 0) continue;
+        double *cj = centroid(c, j);
+        const double *sj = s->sum + (size_t)j * s->d;
+        double dist = 0.0;
+        for (int e = 0; e < s->d; e++) {
+            double v = sj[e] / s->count[j];
+            double t = v - cj[e];
+            dist += t * t;
+            cj[e] = v;
+        }
+        double step = sqrt(dist);
+        s->drift[j] += step;
+        moved = dmax(moved, step);
+    }
+    s->drift_max += moved;
+    return moved;
+}
+
+// Garante espaço para need pontos em reavaliação (a cópia compacta só cresce)
+static int reserve(Incremental *s, int need) {
+    if (need <= s->cand_cap) return 0;
+    int cap = (need > 2 * s->cand_cap) ? need : 2 * s->cand_cap;
+    int *cand = realloc(s->cand, (size_t)cap * sizeof(int));
+    if (cand == NULL) return -1;
+    s->cand = cand;
+
+    Points grown;
+    if (alloc_points(&grown, cap, s->d) != 0) return -1;
+    for (int e = 0; e < s->d && s->num_cand > 0; e++) {
+        memcpy(point_col(&grown, e), point_col(&s->work, e), (size_t)s->num_cand * sizeof(double));
+    }
+    if (s->num_cand > 0) memcpy(grown.labels, s->work.labels, (size_t)s->num_cand * sizeof(label_t));
+    free_points(&s->work);
+    s->work     = grown;
+    s->cand_cap = cap;
+    return 0;
+}
+
+// Põe o ponto i em reavaliação, com as coordenadas copiadas para a cópia compacta
+static void append(Incremental *s, const Points *pts, int i) {
+    int x = s->num_cand++;
+    s->cand[x] = i;
+    for (int e = 0; e < s->d; e++) point_col(&s->work, e)[x] = point_col(pts, e)[i];
+    s->work.labels[x] = NO_LABEL;
+}
+
+// Estende os prefixos das listas até a primeira folga que ainda prova o cluster.
+// Retorna 0, ou -1 se faltar memória
+static int extend(Incremental *s, const Points *pts) {
+    int need = s->num_cand;
+    for (int j = 0; j < s->k; j++) {
+        int base = s->start[j], size = s->start[j + 1] - base, v = s->visited[j];
+        double slack = s->drift[j] + s->drift_max;
+        while (v < size && (double)s->entries[base + v].gap < slack) v++;
+        need += v - s->visited[j];
+    }
+    if (reserve(s, need) != 0) return -1;
+
+    for (int j = 0; j < s->k; j++) {
+        int base = s->start[j], size = s->start[j + 1] - base;
+        double slack = s->drift[j] + s->drift_max;
+        while (s->visited[j] < size && (double)s->entries[base + s->visited[j]].gap < slack) {
+            append(s, pts, s->entries[base + s->visited[j]].index);
+            s->visited[j]++;
+        }
+    }
+    s->work.n = s->num_cand;
+    return 0;
+}
+
+// Rotula os pontos [begin, num_cand) da cópia compacta com o kernel de atribuição
+static void label_work(Incremental *s, int begin, const Centroids *c, assign_kernel_fn kernel) {
+    int num_blocks = (s->num_cand - begin + ASSIGN_BLOCK - 1) / ASSIGN_BLOCK;
+    #pragma omp parallel for schedule(static)
+    for (int b = 0; b < num_blocks; b++) {
+        int first = begin + b * ASSIGN_BLOCK;
+        int last  = (first + ASSIGN_BLOCK < s->num_cand) ? first + ASSIGN_BLOCK : s->num_cand;
+        kernel(&s->work, first, last, c, NULL);
+    }
+}
+
+int inc_update(Incremental *s, const Points *pts, const int *removed, int num_removed, Centroids *c,
+               assign_kernel_fn kernel, int max_iter, IncStats *stats) {
+    int n = pts->n, old_n = s->n;
+    label_t *labels = pts->labels;
+    double p[s->d];
+    memset(stats, 0, sizeof(*stats));
+
+    // Pontos removidos saem das somas do seu cluster (e, se estavam em reavaliação,
+    // ficam na cópia compacta, ignorados)
+    for (int r = 0; r < num_removed; r++) {
+        int i = removed[r];
+        if (labels[i] == NO_LABEL) continue;
+        load_point(pts, i, p);
+        move_point(s, labels[i], p, -1);
+        labels[i] = NO_LABEL;
+    }
+
+    // Pontos novos: rotulados pelo centróide mais próximo e somados; ficam em
+    // reavaliação até a próxima remontagem
+    int first_new = s->num_cand;
+    if (reserve(s, s->num_cand + (n - old_n)) != 0) return -1;
+    for (int i = old_n; i < n; i++) append(s, pts, i);
+    s->work.n = s->num_cand;
+    label_work(s, first_new, c, kernel);
+    for (int x = first_new; x < s->num_cand; x++) {
+        load_point(&s->work, x, p);
+        labels[s->cand[x]] = s->work.labels[x];
+        move_point(s, s->work.labels[x], p, 1);
+    }
+    s->n = n;
+
+    // Passos locais: centróides nas médias e reavaliação só dos pontos sem prova,
+    // até nenhum deles mudar de cluster. Ao sair, os centróides são as médias das somas
+    while (move_centroids(s, c) > 0.0 && stats->iterations < max_iter) {
+        if (extend(s, pts) != 0) return -1;
+        label_work(s, 0, c, kernel);
+
+        int changed = 0;
+        for (int x = 0; x < s->num_cand; x++) {
+            int i = s->cand[x];
+            label_t a = labels[i], b = s->work.labels[x];
+            if (a == NO_LABEL || a == b) continue;
+            load_point(&s->work, x, p);
+            move_point(s, a, p, -1);
+            move_point(s, b, p, 1);
+            labels[i] = b;
+            changed++;
+        }
+        stats->candidates += s->num_cand;
+        stats->iterations++;
+        if (changed == 0) break;
+    }
+
+    // Reavaliação grande demais: remonta o estado sobre os centróides atuais
+    if ((long long)s->num_cand * INC_REBUILD > n) {
+        double start_time = omp_get_wtime();
+        float *gap = malloc((size_t)n * sizeof(float));
+        if (gap == NULL) return -1;
+        collect_gaps(s, gap, NAN);
+        int result = (inc_alloc(s, s->k, s->d, n) == 0) ? measure(s, pts, c, gap) : -1;
+        free(gap);
+        if (result != 0) return -1;
+        stats->rebuild = omp_get_wtime() - start_time;
+    }
+    return 0;
+}
@@ -0,0 +1,311 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <omp.h>
+
+#include "kmeans.h"
+
+// Inicialização dos centróides.
+//
+// init_random sorteia K pontos (a inicialização original da v3). init_kmeans_parallel
+// é o k-means|| (Bahmani et al., 2012), versão paralela do k-means++: a cada rodada,
+// cada ponto entra no conjunto de candidatos com probabilidade proporcional à sua
+// distância ao quadrado até o candidato mais próximo, com INIT_OVERSAMPLE * K
+// candidatos esperados por rodada. Cada candidato recebe como peso o número de pontos
+// mais próximos dele, e o k-means++ ponderado, seguido de algumas iterações de Lloyd
+// ponderadas, reduz os candidatos (algumas centenas ou milhares) a K centróides.
+//
+// As passadas sobre os pontos usam o kernel de atribuição SIMD com os candidatos
+// da rodada no lugar dos centróides. O sorteio usa uma semente por bloco e por
+// rodada, e o custo total é somado bloco a bloco em ordem fixa: os candidatos não
+// dependem do número de threads.
+
+#define INIT_OVERSAMPLE  2  // Candidatos esperados por rodada, em múltiplos de K
+#define INIT_MAX_ROUNDS  5  // O artigo mostra que 5 rodadas bastam na prática
+#define INIT_LLOYD_ITERS 10 // Iterações de Lloyd sobre os candidatos ponderados
+
+int init_random(const Points *pts, Centroids *c, unsigned int seed) {
+    for (int j = 0; j < c->k; j++) {
+        int index = rand_r(&seed) % pts->n;
+        load_point(pts, index, centroid(c, j));
+    }
+    return 0;
+}
+
+typedef struct {
+    const Points *pts;
+    double  *dist;       // Distância ao quadrado de cada ponto ao candidato mais próximo
+    int     *owner;      // Índice desse candidato
+    label_t *near;       // Rótulos devolvidos pelo kernel (candidato mais próximo da rodada)
+    double  *block_phi;  // Custo de cada bloco de pontos
+    int     *cand;       // Índices (nos pontos) dos candidatos, em ordem de escolha
+    int      m, cap;
+    int      num_blocks;
+} KmparState;
+
+static int add_candidate(KmparState *st, int index) {
+    if (st->m == st->cap) {
+        int cap = (st->cap > 0) ? 2 * st->cap : 256;
+        int *cand = realloc(st->cand, (size_t)cap * sizeof(int));
+        if (cand == NULL) return -1;
+        st->cand = cand;
+        st->cap  = cap;
+    }
+    st->cand[st->m++] = index;
+    return 0;
+}
+
+static int compare_int(const void *a, const void *b) {
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+// Atualiza dist e owner com os candidatos [first, m) e devolve o custo total
+// (soma de dist), ou -1 se faltar memória. Os candidatos novos são atribuídos pelo
+// kernel SIMD em lotes de até MAX_K (o limite de label_t)
+static double update_nearest(KmparState *st, int first) {
+    const Points *pts = st->pts;
+    Points view = *pts;
+    view.labels = st->near;
+
+    for (int lo = first; lo < st->m; lo += MAX_K) {
+        int count = (st->m - lo < MAX_K) ? st->m - lo : MAX_K;
+        Centroids batch;
+        if (alloc_centroids(&batch, count, pts->d) != 0) return -1.0;
+        for (int j = 0; j < count; j++) load_point(pts, st->cand[lo + j], centroid(&batch, j));
+
+        int specialized;
+        assign_kernel_fn kernel = select_assign_kernel(pts->d, count, PREC_F64, &specialized);
+
+        #pragma omp parallel for schedule(static)
+        for (int b = 0; b < st->num_blocks; b++) {
+            int begin = b * ASSIGN_BLOCK;
+            int end   = (begin + ASSIGN_BLOCK < pts->n) ? begin + ASSIGN_BLOCK : pts->n;
+            kernel(&view, begin, end, &batch, NULL);
+
+            // Empate fica com o candidato mais antigo (menor índice)
+            double phi = 0.0;
+            for (int i = begin; i < end; i++) {
+                double p[pts->d];
+                load_point(pts, i, p);
+                double d2 = distance_sq(p, centroid(&batch, st->near[i]), pts->d);
+                if (d2 < st->dist[i]) {
+                    st->dist[i]  = d2;
+                    st->owner[i] = lo + st->near[i];
+                }
+                phi += st->dist[i];
+            }
+            st->block_phi[b] = phi;
+        }
+        free_centroids(&batch);
+    }
+
+    double phi = 0.0;
+    for (int b = 0; b < st->num_blocks; b++) phi += st->block_phi[b];
+    return phi;
+}
+
+// Uma rodada de amostragem: o ponto i entra com probabilidade ell * dist[i] / phi.
+// Cada bloco tem a sua sequência de rand_r, derivada da semente, do bloco e da rodada
+static int sample_round(KmparState *st, double phi, double ell, unsigned int seed, int round) {
+    const Points *pts = st->pts;
+    int first  = st->m;
+    int failed = 0;
+
+    #pragma omp parallel for schedule(static)
+    for (int b = 0; b < st->num_blocks; b++) {
+        unsigned int s = seed ^ (unsigned int)(b * 2654435761u) ^ (unsigned int)((round + 1) * 0x9E3779B9u);
+        int begin = b * ASSIGN_BLOCK;
+        int end   = (begin + ASSIGN_BLOCK < pts->n) ? begin + ASSIGN_BLOCK : pts->n;
+
+        for (int i = begin; i < end; i++) {
+            double u = rand_r(&s) / ((double)RAND_MAX + 1.0);
+            if (u * phi < ell * st->dist[i]) {
+                #pragma omp critical
+                if (add_candidate(st, i) != 0) failed = 1;
+            }
+        }
+    }
+    if (failed) return -1;
+
+    // A ordem de chegada depende das threads; a ordem dos índices não
+    qsort(st->cand + first, (size_t)(st->m - first), sizeof(int), compare_int);
+    return 0;
+}
+
+// Número de pontos mais próximos de cada candidato
+static int candidate_weights(const KmparState *st, double *weight) {
+    int num_threads = omp_get_max_threads();
+    int *locals = calloc((size_t)num_threads * st->m, sizeof(int));
+    if (locals == NULL) return -1;
+
+    #pragma omp parallel
+    {
+      int *local = locals + (size_t)omp_get_thread_num() * st->m;
+
+      #pragma omp for schedule(static)
+      for (int i = 0; i < st->pts->n; i++) local[st->owner[i]]++;
+
+      #pragma omp critical
+      for (int j = 0; j < st->m; j++) weight[j] += local[j];
+    }
+
+    free(locals);
+    return 0;
+}
+
+// k-means++ ponderado sobre os candidatos, seguido de até INIT_LLOYD_ITERS
+// iterações de Lloyd ponderadas. Se os candidatos se esgotarem (custo zero), os
+// centróides restantes são pontos sorteados do conjunto inteiro
+static int recluster(const Points *cpts, const double *weight, const Points *pts,
+                     Centroids *c, unsigned int seed) {
+    int m = cpts->n, d = cpts->d, k = c->k;
+    double *dist = malloc((size_t)m * sizeof(double));
+    double *wsum = calloc((size_t)k * (d + 1), sizeof(double));
+    if (dist == NULL || wsum == NULL) {
+        free(dist);
+        free(wsum);
+        return -1;
+    }
+    for (int i = 0; i < m; i++) dist[i] = INFINITY;
+
+    double total = 0.0;
+    for (int i = 0; i < m; i++) total += weight[i];
+
+    for (int j = 0; j < k; j++) {
+        double *cj = centroid(c, j);
+        if (total > 0.0) {
+            // Sorteia o candidato i com probabilidade weight[i] * dist[i] / total
+            double r = rand_r(&seed) / ((double)RAND_MAX + 1.0) * total;
+            int pick = -1;
+            for (int i = 0; i < m && r >= 0.0; i++) {
+                double w = (j == 0) ? weight[i] : weight[i] * dist[i];
+                if (w > 0.0) pick = i;
+                r -= w;
+            }
+            load_point(cpts, pick, cj);
+        } else {
+            load_point(pts, rand_r(&seed) % pts->n, cj);
+        }
+
+        total = 0.0;
+        for (int i = 0; i < m; i++) {
+            double p[d];
+            load_point(cpts, i, p);
+            dist[i] = dmin(dist[i], distance_sq(p, cj, d));
+            total  += weight[i] * dist[i];
+        }
+    }
+
+    int specialized;
+    assign_kernel_fn kernel = select_assign_kernel(d, k, PREC_F64, &specialized);
+    int num_blocks = (m + ASSIGN_BLOCK - 1) / ASSIGN_BLOCK;
+
+    for (int it = 0; it < INIT_LLOYD_ITERS; it++) {
+        int changed = 0;
+        #pragma omp parallel for schedule(static) reduction(+:changed)
+        for (int b = 0; b < num_blocks; b++) {
+            int begin = b * ASSIGN_BLOCK;
+            int end   = (begin + ASSIGN_BLOCK < m) ? begin + ASSIGN_BLOCK : m;
+            changed += kernel(cpts, begin, end, c, NULL);
+        }
+        if (changed == 0) break;
+
+        // Médias ponderadas: wsum guarda as k somas (d posições) seguidas dos k pesos
+        memset(wsum, 0, (size_t)k * (d + 1) * sizeof(double));
+        double *wk = wsum + (size_t)k * d;
+        for (int i = 0; i < m; i++) {
+            int j = cpts->labels[i];
+            double *row = wsum + (size_t)j * d;
+            for (int e = 0; e < d; e++) row[e] += weight[i] * point_col(cpts, e)[i];
+            wk[j] += weight[i];
+        }
+        for (int j = 0; j < k; j++) {
+            if (wk[j] == 0.0) continue;
+            double *cj = centroid(c, j);
+            for (int e = 0; e < d; e++) cj[e] = wsum[(size_t)j * d + e] / wk[j];
+        }
+    }
+
+    free(dist);
+    free(wsum);
+    return 0;
+}
+
+static void kmpar_free(KmparState *st) {
+    free(st->dist);
+    free(st->owner);
+    free(st->near);
+    free(st->block_phi);
+    free(st->cand);
+}
+
+// Escolhe os candidatos: o primeiro uniformemente, depois O(log N) rodadas de
+// amostragem (limitadas a INIT_MAX_ROUNDS), interrompidas se o custo zerar
+static int choose_candidates(KmparState *st, int k, unsigned int seed) {
+    int n = st->pts->n;
+
+    // Mesma divisão estática dos laços seguintes: cada thread toca as suas páginas
+    #pragma omp parallel for schedule(static)
+    for (int b = 0; b < st->num_blocks; b++) {
+        int begin = b * ASSIGN_BLOCK;
+        int end   = (begin + ASSIGN_BLOCK < n) ? begin + ASSIGN_BLOCK : n;
+        for (int i = begin; i < end; i++) {
+            st->dist[i]  = INFINITY;
+            st->owner[i] = 0;
+        }
+    }
+
+    if (add_candidate(st, rand_r(&seed) % n) != 0) return -1;
+    double phi = update_nearest(st, 0);
+
+    int rounds = (int)ceil(log10((double)n));
+    if (rounds < 1) rounds = 1;
+    if (rounds > INIT_MAX_ROUNDS) rounds = INIT_MAX_ROUNDS;
+
+    for (int r = 0; r < rounds && phi > 0.0; r++) {
+        int first = st->m;
+        if (sample_round(st, phi, (double)INIT_OVERSAMPLE * k, seed, r) != 0) return -1;
+        if (st->m > first) phi = update_nearest(st, first);
+    }
+    return (phi < 0.0) ? -1 : 0;
+}
+
+int init_kmeans_parallel(const Points *pts, Centroids *c, unsigned int seed) {
+    KmparState st;
+    memset(&st, 0, sizeof(st));
+    st.pts        = pts;
+    st.num_blocks = (pts->n + ASSIGN_BLOCK - 1) / ASSIGN_BLOCK;
+    st.dist       = alloc_aligned((size_t)pts->n * sizeof(double));
+    st.owner      = alloc_aligned((size_t)pts->n * sizeof(int));
+    st.near       = calloc((size_t)pts->n, sizeof(label_t));
+    st.block_phi  = malloc((size_t)st.num_blocks * sizeof(double));
+    if (st.dist == NULL || st.owner == NULL || st.near == NULL || st.block_phi == NULL ||
+        choose_candidates(&st, c->k, seed) != 0) {
+        kmpar_free(&st);
+        return -1;
+    }
+
+    // Candidatos em SoA, como os pontos, para reaproveitar o kernel de atribuição
+    Points cpts;
+    double *weight = calloc((size_t)st.m, sizeof(double));
+    if (weight == NULL || alloc_points(&cpts, st.m, pts->d) != 0) {
+        free(weight);
+        kmpar_free(&st);
+        return -1;
+    }
+    for (int j = 0; j < st.m; j++) {
+        for (int e = 0; e < pts->d; e++) point_col(&cpts, e)[j] = point_col(pts, e)[st.cand[j]];
+        cpts.labels[j] = NO_LABEL;
+    }
+
+    int rc = candidate_weights(&st, weight);
+    kmpar_free(&st);
+    if (rc == 0) rc = recluster(&cpts, weight, pts, c, seed);
+
+    free_points(&cpts);
+    free(weight);
+    return rc;
+}
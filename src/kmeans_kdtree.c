@@ -0,0 +1,395 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <omp.h>
+
+#include "kmeans.h"
+
+// Engine de filtragem por kd-tree (Kanungo et al., 2002). A árvore é construída uma
+// única vez sobre uma cópia dos pontos reordenada pela árvore, e cada nó guarda a
+// caixa envolvente, a contagem e a soma das coordenadas dos seus pontos. A cada
+// iteração os centróides candidatos descem pela árvore: em cada nó, o candidato
+// mais próximo do centro da caixa elimina os que ficam mais longe em toda a caixa.
+// Quando sobra um único candidato, a subárvore inteira é atribuída e somada a partir
+// das somas do nó, sem tocar nos seus pontos.
+
+#define KD_LEAF_SIZE    64      // Máximo de pontos em uma folha
+#define KD_BUILD_CUTOFF 65536   // Subárvores maiores que isso viram tarefas na construção
+#define KD_TASK_LEAVES  8       // Tarefas de travessia por thread (aprox.)
+#define KD_EPS          1e-9    // Folga relativa ao quadrado da escala dos dados
+
+// A caixa envolvente e a soma das coordenadas de cada nó ficam em vetores à parte
+// (KdState.box e KdState.sum), já que o tamanho depende de D
+typedef struct {
+    int    begin, end;      // Faixa dos pontos no vetor reordenado
+    int    left, right;     // Filhos (-1 em folhas)
+    int    owner;           // Centróide de todos os pontos da subárvore (-1 se misto)
+} KdNode;
+
+typedef struct {
+    int     n, k, d;
+    Points  tree;           // Pontos (e rótulos) na ordem da árvore
+    int    *perm;           // Índice original de cada ponto na ordem da árvore
+    KdNode *nodes;
+    double *box;            // Caixa de cada nó: d mínimos seguidos de d máximos
+    double *sum;            // Soma das coordenadas dos pontos de cada nó (d por nó)
+    int     num_nodes;
+    int     max_nodes;
+    int     root;
+    int     depth;          // Profundidade máxima da árvore
+    int     task_depth;     // Profundidade em que a travessia passa a ser sequencial
+    double  tol2;           // Folga absoluta (em distância ao quadrado) da poda
+    int     num_threads;
+    int    *scratch;        // Listas de candidatos por profundidade, por thread
+    int    *top_cand;       // Listas de candidatos dos nós acima de task_depth
+} KdState;
+
+// Contexto de uma tarefa sequencial da travessia
+typedef struct {
+    Points *pts;
+    Sums   *local;          // Somas parciais da thread que executa a tarefa
+    int    *cand;           // Listas de candidatos por profundidade
+    int     changed;
+} KdCtx;
+
+void kdtree_destroy(void *state) {
+    KdState *st = state;
+    if (st == NULL) return;
+    free_points(&st->tree);
+    free(st->perm);
+    free(st->nodes);
+    free(st->box);
+    free(st->sum);
+    free(st->scratch);
+    free(st->top_cand);
+    free(st);
+}
+
+static inline double *node_min(const KdState *st, int id) { return st->box + (size_t)id * 2 * st->d; }
+static inline double *node_max(const KdState *st, int id) { return node_min(st, id) + st->d; }
+static inline double *node_sum(const KdState *st, int id) { return st->sum + (size_t)id * st->d; }
+
+static inline void swap_points(KdState *st, int i, int j) {
+    for (int d = 0; d < st->d; d++) {
+        double *col = point_col(&st->tree, d);
+        double t = col[i]; col[i] = col[j]; col[j] = t;
+    }
+    int tp = st->perm[i]; st->perm[i] = st->perm[j]; st->perm[j] = tp;
+}
+
+// Quickselect: coloca na posição kth o ponto que estaria lá se [lo, hi) fosse
+// ordenado pela coordenada dim, com os menores à esquerda e os maiores à direita
+static void select_kth(KdState *st, int lo, int hi, int kth, int dim) {
+    double *key = point_col(&st->tree, dim);
+    hi--;
+    while (lo < hi) {
+        double a = key[lo], b = key[lo + (hi - lo) / 2], c = key[hi];
+        double pivot = (a < b) ? ((b < c) ? b : dmax(a, c)) : ((a < c) ? a : dmax(b, c));
+        int i = lo, j = hi;
+        while (i <= j) {
+            while (key[i] < pivot) i++;
+            while (key[j] > pivot) j--;
+            if (i <= j) {
+                swap_points(st, i, j);
+                i++;
+                j--;
+            }
+        }
+        if (kth <= j) hi = j;
+        else if (kth >= i) lo = i;
+        else break;
+    }
+}
+
+static int new_node(KdState *st) {
+    int id;
+    #pragma omp atomic capture
+    id = st->num_nodes++;
+    return id;
+}
+
+// Constrói a subárvore dos pontos [begin, end) e retorna o índice do nó. Os dois
+// filhos de subárvores grandes são construídos em paralelo por tarefas OpenMP
+static int build_node(KdState *st, int begin, int end) {
+    int id = new_node(st);
+    KdNode *nd = &st->nodes[id];
+    nd->begin = begin;
+    nd->end   = end;
+    nd->left  = nd->right = -1;
+    nd->owner = -1;
+
+    double *lo = node_min(st, id), *hi = node_max(st, id), *sum = node_sum(st, id);
+    int dim = 0;
+    for (int d = 0; d < st->d; d++) {
+        const double *col = point_col(&st->tree, d);
+        double mn = INFINITY, mx = -INFINITY, s = 0.0;
+        for (int i = begin; i < end; i++) {
+            mn = dmin(mn, col[i]);
+            mx = dmax(mx, col[i]);
+            s += col[i];
+        }
+        lo[d]  = mn;
+        hi[d]  = mx;
+        sum[d] = s;
+        if (hi[d] - lo[d] > hi[dim] - lo[dim]) dim = d;
+    }
+
+    if (end - begin <= KD_LEAF_SIZE) return id;
+
+    // Divide pela mediana da dimensão mais larga da caixa
+    int mid = begin + (end - begin) / 2;
+    select_kth(st, begin, end, mid, dim);
+
+    int left, right;
+    if (end - begin > KD_BUILD_CUTOFF) {
+        #pragma omp task shared(left, st)
+        left = build_node(st, begin, mid);
+        right = build_node(st, mid, end);
+        #pragma omp taskwait
+    } else {
+        left  = build_node(st, begin, mid);
+        right = build_node(st, mid, end);
+    }
+    st->nodes[id].left  = left;
+    st->nodes[id].right = right;
+    return id;
+}
+
+static int tree_depth(const KdState *st, int id) {
+    const KdNode *nd = &st->nodes[id];
+    if (nd->left < 0) return 0;
+    int l = tree_depth(st, nd->left), r = tree_depth(st, nd->right);
+    return 1 + (l > r ? l : r);
+}
+
+void *kdtree_create(const Points *pts, int k) {
+    KdState *st = calloc(1, sizeof(KdState));
+    if (st == NULL) return NULL;
+
+    int n = pts->n, d = pts->d;
+    st->n           = n;
+    st->k           = k;
+    st->d           = d;
+    st->max_nodes   = 4 * (n / KD_LEAF_SIZE + 1);
+    st->num_threads = omp_get_max_threads();
+    st->perm  = alloc_aligned((size_t)n * sizeof(int));
+    st->nodes = malloc((size_t)st->max_nodes * sizeof(KdNode));
+    st->box   = malloc((size_t)st->max_nodes * 2 * d * sizeof(double));
+    st->sum   = malloc((size_t)st->max_nodes * d * sizeof(double));
+    if (alloc_points(&st->tree, n, d) != 0 || st->perm == NULL || st->nodes == NULL ||
+        st->box == NULL || st->sum == NULL) {
+        kdtree_destroy(st);
+        return NULL;
+    }
+
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < n; i++) {
+        for (int e = 0; e < d; e++) point_col(&st->tree, e)[i] = point_col(pts, e)[i];
+        st->perm[i] = i;
+        st->tree.labels[i] = NO_LABEL;
+    }
+
+    #pragma omp parallel
+    #pragma omp single
+    st->root = build_node(st, 0, n);
+    st->depth = tree_depth(st, st->root);
+
+    // A travessia gera cerca de KD_TASK_LEAVES tarefas por thread
+    st->task_depth = 0;
+    while ((1 << st->task_depth) < KD_TASK_LEAVES * st->num_threads && st->task_depth < st->depth)
+        st->task_depth++;
+
+    // Listas de candidatos: uma por profundidade para cada thread, e uma por nó
+    // acima de task_depth (indexadas pela posição do nó, com a raiz em 1)
+    st->scratch  = malloc((size_t)st->num_threads * (st->depth + 1) * k * sizeof(int));
+    st->top_cand = malloc(((size_t)2 << st->task_depth) * k * sizeof(int));
+    if (st->scratch == NULL || st->top_cand == NULL) {
+        kdtree_destroy(st);
+        return NULL;
+    }
+
+    double extent = 0.0;
+    for (int e = 0; e < d; e++) {
+        extent = dmax(extent, dmax(fabs(node_min(st, st->root)[e]), fabs(node_max(st, st->root)[e])));
+    }
+    st->tol2 = KD_EPS * (extent + 1.0) * (extent + 1.0);
+    return st;
+}
+
+// Filtra os candidatos do nó: o candidato mais próximo do centro da caixa (zs)
+// elimina z quando z fica mais longe que zs até no vértice da caixa mais favorável a z.
+// A poda exige uma folga tol2, então um ponto da caixa nunca empata entre zs e z, e
+// a lista (em ordem crescente de índice) sempre contém o vencedor da força bruta
+static int filter_candidates(const KdState *st, int id, const Centroids *c,
+                             const int *cand, int ncand, int *out) {
+    int d = st->d;
+    const double *lo = node_min(st, id), *hi = node_max(st, id);
+    double mid[d], v[d];
+    for (int e = 0; e < d; e++) mid[e] = 0.5 * (lo[e] + hi[e]);
+
+    int zs = cand[0];
+    double best = distance_sq(mid, centroid(c, zs), d);
+    for (int q = 1; q < ncand; q++) {
+        double d2 = distance_sq(mid, centroid(c, cand[q]), d);
+        if (d2 < best) {
+            best = d2;
+            zs = cand[q];
+        }
+    }
+
+    const double *czs = centroid(c, zs);
+    int nout = 0;
+    for (int q = 0; q < ncand; q++) {
+        int z = cand[q];
+        if (z != zs) {
+            const double *cz = centroid(c, z);
+            for (int e = 0; e < d; e++) v[e] = (cz[e] > czs[e]) ? hi[e] : lo[e];
+            if (distance_sq(v, cz, d) - distance_sq(v, czs, d) > st->tol2) continue;
+        }
+        out[nout++] = z;
+    }
+    return nout;
+}
+
+// Rotula com j todos os pontos da subárvore. Subárvores que já estavam inteiras em j
+// são puladas, então só os pontos que mudaram de cluster são tocados
+static void label_subtree(KdState *st, int id, int j, KdCtx *ctx) {
+    KdNode *nd = &st->nodes[id];
+    if (nd->owner == j) return;
+    nd->owner = j;
+    if (nd->left >= 0) {
+        label_subtree(st, nd->left,  j, ctx);
+        label_subtree(st, nd->right, j, ctx);
+        return;
+    }
+    for (int i = nd->begin; i < nd->end; i++) {
+        if (st->tree.labels[i] != j) {
+            ctx->changed++;
+            st->tree.labels[i] = (label_t)j;
+            ctx->pts->labels[st->perm[i]] = (label_t)j;
+        }
+    }
+}
+
+// Atribui a subárvore inteira a j e soma seus pontos a partir das somas do nó
+static void assign_subtree(KdState *st, int id, int j, KdCtx *ctx) {
+    const KdNode *nd = &st->nodes[id];
+    const double *s = node_sum(st, id);
+    double *row = ctx->local->sum + (size_t)j * st->d;
+    for (int e = 0; e < st->d; e++) row[e] += s[e];
+    ctx->local->count[j] += nd->end - nd->begin;
+    label_subtree(st, id, j, ctx);
+}
+
+// Folha com mais de um candidato: varre os pontos contra os candidatos restantes
+static void assign_leaf(KdState *st, KdNode *nd, const Centroids *c, const int *cand, int ncand, KdCtx *ctx) {
+    int owner = -2;
+    double p[st->d];
+    for (int i = nd->begin; i < nd->end; i++) {
+        load_point(&st->tree, i, p);
+        int    bestCluster = cand[0];
+        double minDist = distance_sq(p, centroid(c, bestCluster), st->d);
+        for (int q = 1; q < ncand; q++) {
+            int    j  = cand[q];
+            double d2 = distance_sq(p, centroid(c, j), st->d);
+            bestCluster = (d2 < minDist) ? j  : bestCluster;
+            minDist     = (d2 < minDist) ? d2 : minDist;
+        }
+
+        if (st->tree.labels[i] != bestCluster) {
+            ctx->changed++;
+            st->tree.labels[i] = (label_t)bestCluster;
+            ctx->pts->labels[st->perm[i]] = (label_t)bestCluster;
+        }
+        accumulate(ctx->local, bestCluster, p);
+        owner = (owner == -2 || owner == bestCluster) ? bestCluster : -1;
+    }
+    nd->owner = owner;
+}
+
+// Travessia sequencial (dentro de uma tarefa)
+static void filter_node(KdState *st, int id, const Centroids *c, const int *cand, int ncand,
+                        int depth, KdCtx *ctx) {
+    KdNode *nd = &st->nodes[id];
+    int *next = ctx->cand + (size_t)depth * st->k;
+    int nnext = filter_candidates(st, id, c, cand, ncand, next);
+
+    if (nnext == 1) {
+        assign_subtree(st, id, next[0], ctx);
+    } else if (nd->left < 0) {
+        assign_leaf(st, nd, c, next, nnext, ctx);
+    } else {
+        nd->owner = -1;
+        filter_node(st, nd->left,  c, next, nnext, depth + 1, ctx);
+        filter_node(st, nd->right, c, next, nnext, depth + 1, ctx);
+    }
+}
+
+// Tarefa sequencial: usa as somas parciais e as listas de candidatos da thread que
+// a executa (tarefas vinculadas sem pontos de escalonamento não se intercalam)
+static void filter_task(KdState *st, int id, const Centroids *c, const int *cand, int ncand,
+                        int depth, Points *pts, Sums *locals, int *changed) {
+    int tid = omp_get_thread_num();
+    KdCtx ctx = { pts, &locals[tid], st->scratch + (size_t)tid * (st->depth + 1) * st->k, 0 };
+    filter_node(st, id, c, cand, ncand, depth, &ctx);
+    #pragma omp atomic
+    *changed += ctx.changed;
+}
+
+// Níveis superiores da travessia: filtram os candidatos e geram uma tarefa por
+// subárvore a partir de task_depth. pos é a posição do nó em um heap binário
+static void filter_top(KdState *st, int id, int pos, const Centroids *c, const int *cand, int ncand,
+                       int depth, Points *pts, Sums *locals, int *changed) {
+    KdNode *nd = &st->nodes[id];
+    if (depth >= st->task_depth || nd->left < 0) {
+        // A lista do pai continua viva até o taskwait do pai
+        #pragma omp task firstprivate(id, cand, ncand, depth)
+        filter_task(st, id, c, cand, ncand, depth, pts, locals, changed);
+        return;
+    }
+
+    int *next = st->top_cand + (size_t)pos * st->k;
+    int nnext = filter_candidates(st, id, c, cand, ncand, next);
+    if (nnext == 1) {
+        KdCtx ctx = { pts, &locals[omp_get_thread_num()], NULL, 0 };
+        assign_subtree(st, id, next[0], &ctx);
+        #pragma omp atomic
+        *changed += ctx.changed;
+    } else {
+        nd->owner = -1;
+        filter_top(st, nd->left,  2 * pos,     c, next, nnext, depth + 1, pts, locals, changed);
+        filter_top(st, nd->right, 2 * pos + 1, c, next, nnext, depth + 1, pts, locals, changed);
+        #pragma omp taskwait
+    }
+}
+
+int iterate_kdtree(void *state, Points *pts, const Centroids *c, assign_kernel_fn kernel, Sums *sums) {
+    KdState *st = state;
+    (void)kernel;
+    int changed = 0;
+
+    Sums *locals = thread_sums(sums);
+    int  *all    = malloc((size_t)c->k * sizeof(int));
+    if (locals == NULL || all == NULL) {
+        free(all);
+        return -1;
+    }
+    for (int j = 0; j < c->k; j++) all[j] = j;
+
+    #pragma omp parallel
+    {
+      #pragma omp single
+      {
+        filter_top(st, st->root, 1, c, all, c->k, 0, pts, locals, &changed);
+        #pragma omp taskwait
+      }
+
+      // A barreira implícita do single garante que todas as tarefas terminaram
+      TRACE_MARK(TRACE_ASSIGN);
+      reduce_thread_sums(sums);
+    }
+    TRACE_MARK(TRACE_MERGE);
+
+    free(all);
+    return changed;
+}
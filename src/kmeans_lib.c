@@ -0,0 +1,776 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <omp.h>
+
+#include "kmeans.h"
+#include "libkmeans.h"
+
+// Implementação da API pública (libkmeans.h) sobre as engines, os kernels e as
+// inicializações da v3. O contexto é dono dos centróides, das somas por centróide
+// (com a arena de parciais por thread), dos rótulos e da cópia compacta dos pontos
+// (float32 ou 16 bits, conforme a precisão) e dos buffers da reordenação por
+// cluster e dos reinícios (n_init); esses só crescem, então chamadas seguintes com lotes do mesmo tamanho não
+// alocam memória. O estado das engines (limitantes, kd-tree) depende dos pontos e
+// vive só durante um fit; o da atualização incremental (somas, rótulos e folgas por
+// ponto) fica no contexto entre um fit e as chamadas de kmeans_update.
+
+// Engines disponíveis, selecionáveis pelo nome
+const Engine engines[] = {
+    { "twopass", NULL,           iterate_twopass, NULL,            1 },
+    { "fused",   NULL,           iterate_fused,   NULL,            1 },
+    { "hamerly", hamerly_create, iterate_bounds,  bounds_destroy,  0 },
+    { "elkan",   elkan_create,   iterate_bounds,  bounds_destroy,  0 },
+    { "yinyang", yinyang_create, iterate_yinyang, yinyang_destroy, 0 },
+    { "kdtree",  kdtree_create,  iterate_kdtree,  kdtree_destroy,  0 },
+    { "gemm",    gemm_create,    iterate_gemm,    gemm_destroy,    0 },
+};
+const int num_engines = (int)(sizeof(engines) / sizeof(engines[0]));
+
+// Inicializações dos centróides, selecionáveis pelo nome
+const Initializer initializers[] = {
+    { "random", init_random          },
+    { "kmpar",  init_kmeans_parallel },
+};
+const int num_initializers = (int)(sizeof(initializers) / sizeof(initializers[0]));
+
+const Engine *find_engine(const char *name) {
+    for (int e = 0; e < num_engines; e++) {
+        if (strcmp(engines[e].name, name) == 0) return &engines[e];
+    }
+    return NULL;
+}
+
+const Initializer *find_initializer(const char *name) {
+    for (int i = 0; i < num_initializers; i++) {
+        if (strcmp(initializers[i].name, name) == 0) return &initializers[i];
+    }
+    return NULL;
+}
+
+// Arquivo de modelo (little-endian): cabeçalho de 64 bytes, k x d centróides em
+// float64 (em linhas) e k contadores uint64 de pontos vistos. Com o estado
+// incremental (points > 0), seguem as somas por cluster (k x d float64), o rótulo
+// (uint16) e a folga (float32) de cada um dos points pontos
+#define MODEL_MAGIC "KMMD0001"
+typedef struct {
+    char     magic[8];      // MODEL_MAGIC (sem o terminador)
+    uint32_t k;
+    uint32_t d;
+    uint64_t points;        // Pontos do estado incremental (0 = sem estado)
+    uint8_t  reserved[40];  // Completa 64 bytes (zerado)
+} ModelHeader;
+
+struct KMeansContext {
+    const Engine      *engine;
+    const Initializer *init;
+    int                precision;
+    int                max_iter;
+    int                num_threads;
+    unsigned int       seed;
+    int                trained;     // 1 se os centróides vieram de fit, partial_fit ou load
+    assign_kernel_fn   kernel;      // Kernel do fit (na precisão do contexto)
+    assign_kernel_fn   kernel64;    // Kernel em double (partial_fit e update)
+    assign_kernel_fn   labeler;     // Kernel em double que só grava os rótulos (predict)
+    Centroids          centroids;
+    Sums               sums;        // Somas globais e parciais por thread
+    long long         *seen;        // Pontos vistos por centróide (taxa do partial_fit)
+    label_t           *labels;
+    int                labels_cap;
+    void              *packed;      // Cópia em float32 ou em 16 bits (KMEANS_PREC_F32 ou Q16)
+    size_t             packed_cap;
+    float             *q_params;    // Início da caixa e passo de cada dimensão (Q16)
+    Reorder            reorder;     // Reordenação periódica por cluster (reorder.period > 0)
+    int                n_init;      // Reinícios avançados juntos no fit
+    label_t           *restart_labels; // Rótulos de cada reinício (n_init x n)
+    size_t             restart_cap;
+    int                coarse;      // Amostras da pipeline grossa-para-fina (COARSE_NONE = sem)
+    int                final_iter;  // Limite de iterações sobre todos os pontos depois dela
+    int                incremental; // Monta o estado incremental no fim de cada fit
+    Incremental        inc;
+};
+
+void kmeans_config_init(KMeansConfig *cfg, int k, int d) {
+    cfg->k           = k;
+    cfg->d           = d;
+    cfg->engine      = "twopass";
+    cfg->init        = "kmpar";
+    cfg->precision   = KMEANS_PREC_F64;
+    cfg->max_iter    = KMEANS_DEFAULT_MAX_ITER;
+    cfg->num_threads = 0;
+    cfg->seed        = 0;
+    cfg->reorder     = 0;
+    cfg->n_init      = 1;
+    cfg->coarse      = KMEANS_COARSE_NONE;
+    cfg->final_iter  = KMEANS_DEFAULT_FINAL_ITER;
+    cfg->incremental = 0;
+}
+
+KMeansContext *kmeans_create(const KMeansConfig *cfg) {
+    const Engine      *eng = find_engine(cfg->engine);
+    const Initializer *ini = find_initializer(cfg->init);
+    if (eng == NULL || ini == NULL || cfg->k < 1 || cfg->k > MAX_K || cfg->d < 1 || cfg->d > MAX_D ||
+        cfg->max_iter < 1 || cfg->num_threads < 0 ||
+        cfg->precision < KMEANS_PREC_F64 || cfg->precision > KMEANS_PREC_Q16 ||
+        (cfg->precision != KMEANS_PREC_F64 && !eng->f32) || cfg->reorder < 0 ||
+        (cfg->reorder > 0 && eng->create != NULL) || cfg->n_init < 1 || cfg->n_init > MAX_RESTARTS ||
+        (cfg->n_init > 1 && (eng->create != NULL || cfg->reorder > 0)) ||
+        cfg->coarse < KMEANS_COARSE_NONE || cfg->coarse > KMEANS_COARSE_IMPORTANCE || cfg->final_iter < 1 ||
+        (cfg->coarse != KMEANS_COARSE_NONE && cfg->n_init > 1) || cfg->incremental < 0 || cfg->incremental > 1) {
+        return NULL;
+    }
+
+    KMeansContext *ctx = calloc(1, sizeof(KMeansContext));
+    if (ctx == NULL) return NULL;
+    ctx->engine      = eng;
+    ctx->init        = ini;
+    ctx->precision   = cfg->precision;
+    ctx->max_iter    = cfg->max_iter;
+    ctx->num_threads = (cfg->num_threads > 0) ? cfg->num_threads : omp_get_max_threads();
+    ctx->seed        = cfg->seed;
+    ctx->reorder.period = cfg->reorder;
+    ctx->n_init      = cfg->n_init;
+    ctx->coarse      = cfg->coarse;
+    ctx->final_iter  = cfg->final_iter;
+    ctx->incremental = cfg->incremental;
+    ctx->seen        = calloc((size_t)cfg->k, sizeof(long long));
+    ctx->q_params    = malloc(2 * (size_t)cfg->d * sizeof(float));
+    if (alloc_centroids(&ctx->centroids, cfg->k, cfg->d) != 0 || alloc_sums(&ctx->sums, cfg->k, cfg->d) != 0 ||
+        ctx->seen == NULL || ctx->q_params == NULL) {
+        kmeans_destroy(ctx);
+        return NULL;
+    }
+
+    // O conjunto de instruções é detectado uma vez por processo
+    static int simd_detected = 0;
+    if (!simd_detected) {
+        detect_simd();
+        simd_detected = 1;
+    }
+    int specialized;
+    ctx->kernel   = select_assign_kernel(cfg->d, cfg->k, cfg->precision, &specialized);
+    ctx->kernel64 = select_assign_kernel(cfg->d, cfg->k, PREC_F64, &specialized);
+    ctx->labeler  = select_label_kernel(cfg->d, cfg->k);
+    return ctx;
+}
+
+void kmeans_destroy(KMeansContext *ctx) {
+    if (ctx == NULL) return;
+    free_centroids(&ctx->centroids);
+    free_sums(&ctx->sums);
+    free(ctx->seen);
+    free(ctx->labels);
+    free(ctx->packed);
+    free(ctx->q_params);
+    reorder_free(&ctx->reorder);
+    free(ctx->restart_labels);
+    inc_free(&ctx->inc);
+    free(ctx);
+}
+
+// Pontos de uma chamada: as colunas do chamador e os rótulos do contexto (alocados
+// de novo só se n passar da capacidade). Retorna 0, ou -1 se faltar memória
+static int view_points(KMeansContext *ctx, const double *coords, int n, size_t stride, Points *pts) {
+    if (n > ctx->labels_cap) {
+        free(ctx->labels);
+        ctx->labels     = alloc_aligned((size_t)n * sizeof(label_t));
+        ctx->labels_cap = (ctx->labels != NULL) ? n : 0;
+        if (ctx->labels == NULL) return -1;
+    }
+    pts->coords   = (double *)coords;
+    pts->coords32 = NULL;
+    pts->coords16 = NULL;
+    pts->q_lo     = NULL;
+    pts->q_step   = NULL;
+    pts->blocks   = NULL;
+    pts->labels   = ctx->labels;
+    pts->n        = n;
+    pts->d        = ctx->centroids.d;
+    pts->stride   = stride;
+
+    // Nenhum ponto tem cluster ainda
+    int num_blocks = (n + ASSIGN_BLOCK - 1) / ASSIGN_BLOCK;
+    #pragma omp parallel
+    {
+      int first, last;
+      thread_blocks(num_blocks, &first, &last);
+      int end = (last * ASSIGN_BLOCK < n) ? last * ASSIGN_BLOCK : n;
+      for (int i = first * ASSIGN_BLOCK; i < end; i++) pts->labels[i] = NO_LABEL;
+    }
+    return 0;
+}
+
+// Passa os pontos para a cópia compacta do contexto (realocada só se crescer): em
+// float32 ou, em KMEANS_PREC_Q16, quantizados em 16 bits
+static int pack_points(KMeansContext *ctx, const Points *pts, Points *packed) {
+    int q16 = (ctx->precision == PREC_Q16);
+    *packed = *pts;
+    packed->coords = NULL;
+    packed->stride = q16 ? points_stride16(pts->n) : points_stride32(pts->n);
+
+    size_t bytes = packed->stride * pts->d * (q16 ? sizeof(uint16_t) : sizeof(float));
+    int    fresh = bytes > ctx->packed_cap;
+    if (fresh) {
+        free(ctx->packed);
+        ctx->packed     = alloc_aligned(bytes);
+        ctx->packed_cap = (ctx->packed != NULL) ? bytes : 0;
+    }
+    if (ctx->packed == NULL) return -1;
+    if (q16) {
+        packed->coords16 = ctx->packed;
+        packed->q_lo     = ctx->q_params;
+        packed->q_step   = ctx->q_params + pts->d;
+    } else {
+        packed->coords32 = ctx->packed;
+    }
+
+    // Páginas novas vão para o nó NUMA da thread que as lê (antes do primeiro acesso)
+    if (fresh) numa_bind_points(packed);
+    if (q16) convert_points_q16(pts, packed);
+    else convert_points_f32(pts, packed);
+    return 0;
+}
+
+// Estado da atualização incremental ao fim de um fit (com KMeansConfig.incremental),
+// sobre os pontos em double e os rótulos na ordem do chamador. Retorna iterations, ou
+// -1 se faltar memória
+static int fit_state(KMeansContext *ctx, const Points *pts, int iterations, KMeansStats *stats) {
+    double start_time = omp_get_wtime();
+    if (iterations >= 0 && ctx->incremental && inc_build(&ctx->inc, pts, &ctx->centroids) != 0) {
+        fprintf(stderr, "Erro ao alocar memória para o estado incremental.\n");
+        return -1;
+    }
+    if (stats != NULL) {
+        stats->update_candidates = 0;
+        stats->state_time        = ctx->incremental ? omp_get_wtime() - start_time : 0.0;
+    }
+    return iterations;
+}
+
+static int fit_restarts(KMeansContext *ctx, Points *pts, KMeansStats *stats);
+
+static int fit(KMeansContext *ctx, const double *coords, int n, size_t stride, KMeansStats *stats) {
+    const Engine *eng = ctx->engine;
+    Centroids *c = &ctx->centroids;
+    if (n < 1 || stride < (size_t)n || (ctx->incremental && mpi_ranks() > 1)) return -1;
+
+    ctx->inc.ready = 0;
+    Points pts;
+    if (view_points(ctx, coords, n, stride, &pts) != 0) {
+        fprintf(stderr, "Erro ao alocar memória para os rótulos.\n");
+        mpi_fail();
+        return -1;
+    }
+    if (ctx->n_init > 1) return fit_state(ctx, &pts, fit_restarts(ctx, &pts, stats), stats);
+    Points caller = pts;
+
+    // Inicializa os centróides a partir dos pontos (sorteio ou k-means||) ou, com a
+    // pipeline grossa-para-fina, a partir da primeira amostra, refinando-os nas
+    // seguintes. Se N for pequeno demais para ela, a inicialização usa todos os pontos
+    CoarseStats coarse;
+    memset(&coarse, 0, sizeof(coarse));
+    double init_time = omp_get_wtime();
+    if (ctx->coarse != COARSE_NONE &&
+        coarse_fit(ctx->init, &pts, c, ctx->seed, ctx->coarse, ctx->max_iter, &coarse) < 0) {
+        fprintf(stderr, "Erro ao alocar memória para a pipeline grossa-para-fina.\n");
+        mpi_fail();
+        return -1;
+    }
+    if (coarse.levels == 0 && mpi_init_centroids(ctx->init, &pts, c, ctx->seed) != 0) {
+        fprintf(stderr, "Erro ao alocar memória para a inicialização %s.\n", ctx->init->name);
+        mpi_fail();
+        return -1;
+    }
+    init_time = (coarse.levels > 0) ? coarse.init : omp_get_wtime() - init_time;
+    int max_iter = (coarse.levels > 0) ? ctx->final_iter : ctx->max_iter;
+
+    // Reordenação por cluster: a folga do teste dos blocos vem dos pontos em double
+    Reorder *reorder = (ctx->reorder.period > 0) ? &ctx->reorder : NULL;
+    if (reorder != NULL && reorder_begin(reorder, &pts, c->k, ctx->precision) != 0) {
+        fprintf(stderr, "Erro ao alocar memória para a reordenação dos pontos.\n");
+        mpi_fail();
+        return -1;
+    }
+
+    // Precisão simples ou 16 bits: depois da inicialização (feita em double), os
+    // pontos passam para a cópia compacta
+    if (ctx->precision != PREC_F64) {
+        Points packed;
+        if (pack_points(ctx, &pts, &packed) != 0) {
+            fprintf(stderr, "Erro ao alocar memória para os pontos em %s.\n",
+                    ctx->precision == PREC_Q16 ? "16 bits" : "float32");
+            mpi_fail();
+            return -1;
+        }
+        pts = packed;
+        centroids_to_f32(c);
+    }
+    if (reorder != NULL) pts.blocks = &reorder->blocks;
+
+    // Aloca o estado persistente da engine (limitantes por ponto, etc.)
+    // Fica fora do tempo do laço principal, mas é medido à parte
+    void *state = NULL;
+    double setup_time = omp_get_wtime();
+    if (eng->create != NULL) {
+        state = eng->create(&pts, c->k);
+        if (state == NULL) {
+            fprintf(stderr, "Erro ao alocar memória para a engine %s.\n", eng->name);
+            mpi_fail();
+            return -1;
+        }
+    }
+
+    double start_time = omp_get_wtime();
+    setup_time = start_time - setup_time;
+
+    // Loop principal do algoritmo k-means
+    int iterations = 0;
+    int changed    = 1;
+    TRACE_RUN_BEGIN(eng->name, ctx->num_threads);
+    while (changed && iterations < max_iter) {
+        // Atribuição dos pontos e soma por centróide, conforme a engine selecionada
+        // (changed é o número de pontos que mudaram de cluster)
+        TRACE_ITER_BEGIN();
+        if (reorder != NULL) reorder_plan(reorder, c);
+        clear_sums(&ctx->sums);
+        changed = eng->iterate(state, &pts, c, ctx->kernel, &ctx->sums);
+        if (changed < 0) {
+            fprintf(stderr, "Erro ao alocar memória na iteração da engine %s.\n", eng->name);
+            mpi_fail();
+            break;
+        }
+
+        // Na versão MPI, as somas já chegam somadas entre os processos; o número de
+        // pontos que mudaram é somado enquanto os centróides são atualizados
+        mpi_post_changed(&changed);
+        update_centroids(c, &ctx->sums);
+        if (ctx->precision != PREC_F64) centroids_to_f32(c);
+        TRACE_MARK(TRACE_UPDATE);
+        mpi_wait_changed();
+
+        // A cada reorder->period iterações (se o laço continua), ordena os pontos
+        // pelo cluster atual
+        if (reorder != NULL && changed && (iterations + 1) % reorder->period == 0 &&
+            iterations + 1 < max_iter && reorder_points(reorder, &pts, c, ctx->labels) != 0) {
+            fprintf(stderr, "Erro ao alocar memória para a reordenação dos pontos.\n");
+            mpi_fail();
+            changed = -1;
+            break;
+        }
+        TRACE_MARK(TRACE_REORDER);
+        TRACE_ITER_END(changed);
+
+        iterations++;
+    }
+    TRACE_RUN_END();
+    double end_time = omp_get_wtime();
+
+    if (eng->destroy != NULL) eng->destroy(state);
+    if (changed < 0) return -1;
+
+    // Os tamanhos finais dos clusters viram os pontos vistos de um partial_fit seguinte
+    for (int j = 0; j < c->k; j++) ctx->seen[j] = ctx->sums.count[j];
+    ctx->trained = 1;
+
+    if (stats != NULL) {
+        // Tempos do processo mais lento e inércia somada entre os processos (MPI)
+        stats->iterations = iterations;
+        stats->time       = mpi_max(end_time - start_time);
+        stats->setup      = mpi_max(setup_time);
+        stats->init       = mpi_max(init_time);
+        stats->reorders     = (reorder != NULL) ? reorder->reorders : 0;
+        stats->reorder_time = (reorder != NULL) ? mpi_max(reorder->time) : 0.0;
+        stats->skipped      = 0.0;
+        if (reorder != NULL && reorder->checked > 0) {
+            stats->skipped = mpi_sum((double)reorder->skipped) / mpi_sum((double)reorder->checked);
+        }
+        stats->best_restart       = 0;
+        stats->restart_iterations = iterations;
+        stats->coarse_levels      = coarse.levels;
+        stats->coarse_iterations  = coarse.iterations;
+        stats->coarse_points      = coarse.points;
+        stats->coarse_time        = mpi_max(coarse.time);
+    }
+
+    // Rótulos de volta à ordem do chamador. A inércia é medida sobre os pontos em
+    // double do chamador (em f32 e q16, não sobre a cópia compacta), então inclui o
+    // erro da precisão reduzida
+    if (reorder != NULL) reorder_restore(reorder, &pts, ctx->labels);
+    if (stats != NULL) {
+        stats->inertia       = mpi_sum(batch_inertia(&caller, c));
+        stats->worst_inertia = stats->inertia;
+    }
+    return fit_state(ctx, &caller, iterations, stats);
+}
+
+// Fit com n_init reinícios (engines twopass e fused): o reinício r usa a semente
+// seed + r e tem os próprios centróides, somas e rótulos; a cada iteração,
+// iterate_restarts passa uma vez pelos pontos para todos os reinícios ativos. Um
+// reinício sai do laço quando converge (ou chega a max_iter) e, no fim, o de menor
+// inércia vai para o contexto (empate: o de menor índice)
+static int fit_restarts(KMeansContext *ctx, Points *pts, KMeansStats *stats) {
+    int num_restarts = ctx->n_init;
+    int k = ctx->centroids.k, d = ctx->centroids.d, n = pts->n;
+
+    size_t need = (size_t)num_restarts * n;
+    if (need > ctx->restart_cap) {
+        free(ctx->restart_labels);
+        ctx->restart_labels = alloc_aligned(need * sizeof(label_t));
+        ctx->restart_cap    = (ctx->restart_labels != NULL) ? need : 0;
+    }
+    Centroids *cs      = calloc((size_t)num_restarts, sizeof(Centroids));
+    Sums      *sums    = calloc((size_t)num_restarts, sizeof(Sums));
+    label_t  **labels  = malloc((size_t)num_restarts * sizeof(label_t *));
+    int       *active  = malloc((size_t)num_restarts * sizeof(int));
+    int       *changed = malloc((size_t)num_restarts * sizeof(int));
+    int       *iters   = calloc((size_t)num_restarts, sizeof(int));
+    double    *inertia = malloc((size_t)num_restarts * sizeof(double));
+    int ok = ctx->restart_labels != NULL && cs != NULL && sums != NULL && labels != NULL && active != NULL &&
+             changed != NULL && iters != NULL && inertia != NULL;
+    for (int r = 0; ok && r < num_restarts; r++) {
+        ok = alloc_centroids(&cs[r], k, d) == 0 && alloc_sums(&sums[r], k, d) == 0;
+    }
+
+    // Inicialização de cada reinício, com os pontos em double. Os rótulos do contexto
+    // (já sem cluster) servem de molde para os de cada reinício
+    double init_time = omp_get_wtime();
+    for (int r = 0; ok && r < num_restarts; r++) {
+        labels[r] = ctx->restart_labels + (size_t)r * n;
+        memcpy(labels[r], pts->labels, (size_t)n * sizeof(label_t));
+        active[r] = 1;
+        ok = mpi_init_centroids(ctx->init, pts, &cs[r], ctx->seed + (unsigned int)r) == 0;
+    }
+    init_time = omp_get_wtime() - init_time;
+
+    Points work = *pts;
+    if (ok && ctx->precision != PREC_F64) {
+        ok = pack_points(ctx, pts, &work) == 0;
+        for (int r = 0; ok && r < num_restarts; r++) centroids_to_f32(&cs[r]);
+    }
+
+    // Loop principal: os reinícios que ainda mudam avançam juntos
+    double start_time = omp_get_wtime();
+    int remaining  = num_restarts;
+    int iterations = 0;
+    TRACE_RUN_BEGIN(ctx->engine->name, ctx->num_threads);
+    while (ok && remaining > 0 && iterations < ctx->max_iter) {
+        TRACE_ITER_BEGIN();
+        for (int r = 0; r < num_restarts; r++) {
+            if (active[r]) clear_sums(&sums[r]);
+        }
+        if (iterate_restarts(&work, labels, cs, ctx->kernel, sums, active, num_restarts, changed) != 0) {
+            ok = 0;
+            break;
+        }
+
+        // Na versão MPI, as somas já chegam somadas entre os processos
+        int total = 0;
+        for (int r = 0; r < num_restarts; r++) {
+            if (!active[r]) continue;
+            changed[r] = (int)mpi_sum((double)changed[r]);
+            update_centroids(&cs[r], &sums[r]);
+            if (ctx->precision != PREC_F64) centroids_to_f32(&cs[r]);
+            iters[r]++;
+            total += changed[r];
+            if (changed[r] == 0) {
+                active[r] = 0;
+                remaining--;
+            }
+        }
+        TRACE_MARK(TRACE_UPDATE);
+        TRACE_ITER_END(total);
+        iterations++;
+    }
+    TRACE_RUN_END();
+    double end_time = omp_get_wtime();
+
+    // Inércia de cada reinício (somada entre os processos, sobre os pontos em double)
+    // e escolha do menor
+    int best = 0;
+    long long restart_iterations = 0;
+    Points view = *pts;
+    for (int r = 0; ok && r < num_restarts; r++) {
+        view.labels = labels[r];
+        inertia[r]  = mpi_sum(batch_inertia(&view, &cs[r]));
+        restart_iterations += iters[r];
+        if (inertia[r] < inertia[best]) best = r;
+    }
+
+    if (ok) {
+        copy_centroids(&ctx->centroids, &cs[best]);
+        centroids_to_f32(&ctx->centroids);
+        memcpy(ctx->labels, labels[best], (size_t)n * sizeof(label_t));
+        for (int j = 0; j < k; j++) ctx->seen[j] = sums[best].count[j];
+        ctx->trained = 1;
+    }
+    if (ok && stats != NULL) {
+        double worst = inertia[0];
+        for (int r = 1; r < num_restarts; r++) worst = dmax(worst, inertia[r]);
+        stats->iterations         = iters[best];
+        stats->time               = mpi_max(end_time - start_time);
+        stats->setup              = 0.0;
+        stats->init               = mpi_max(init_time);
+        stats->inertia            = inertia[best];
+        stats->reorders           = 0;
+        stats->reorder_time       = 0.0;
+        stats->skipped            = 0.0;
+        stats->best_restart       = best;
+        stats->worst_inertia      = worst;
+        stats->restart_iterations = restart_iterations;
+        stats->coarse_levels      = 0;
+        stats->coarse_iterations  = 0;
+        stats->coarse_points      = 0;
+        stats->coarse_time        = 0.0;
+    }
+    int result = ok ? iters[best] : -1;
+
+    for (int r = 0; r < num_restarts; r++) {
+        if (cs != NULL) free_centroids(&cs[r]);
+        if (sums != NULL) free_sums(&sums[r]);
+    }
+    free(cs);
+    free(sums);
+    free(labels);
+    free(active);
+    free(changed);
+    free(iters);
+    free(inertia);
+    if (!ok) {
+        fprintf(stderr, "Erro ao alocar memória para os %d reinícios.\n", num_restarts);
+        mpi_fail();
+    }
+    return result;
+}
+
+static int partial_fit(KMeansContext *ctx, const double *coords, int n, size_t stride) {
+    Centroids *c = &ctx->centroids;
+    if (n < 1 || stride < (size_t)n || (!ctx->trained && n < c->k)) return -1;
+
+    ctx->inc.ready = 0;
+    Points pts;
+    if (view_points(ctx, coords, n, stride, &pts) != 0) return -1;
+
+    // Centróides iniciais: escolhidos no primeiro lote
+    if (!ctx->trained) {
+        if (ctx->init->init(&pts, c, ctx->seed) != 0) return -1;
+        memset(ctx->seen, 0, (size_t)c->k * sizeof(long long));
+        ctx->trained = 1;
+    }
+
+    clear_sums(&ctx->sums);
+    if (iterate_fused(NULL, &pts, c, ctx->kernel64, &ctx->sums) < 0) return -1;
+    minibatch_update(c, &ctx->sums, ctx->seen);
+    return 0;
+}
+
+static int update(KMeansContext *ctx, const double *coords, int n, size_t stride, const int *removed,
+              int num_removed, KMeansStats *stats) {
+    Incremental *s = &ctx->inc;
+    if (!s->ready || n < s->n || stride < (size_t)n || num_removed < 0 || (num_removed > 0 && removed == NULL)) {
+        return -1;
+    }
+    for (int r = 0; r < num_removed; r++) {
+        if (removed[r] < 0 || removed[r] >= s->n) return -1;
+    }
+
+    // Rótulos dos pontos já cobertos preservados ao crescer
+    if (n > ctx->labels_cap) {
+        label_t *grown = alloc_aligned((size_t)n * sizeof(label_t));
+        if (grown == NULL) return -1;
+        memcpy(grown, ctx->labels, (size_t)s->n * sizeof(label_t));
+        free(ctx->labels);
+        ctx->labels     = grown;
+        ctx->labels_cap = n;
+    }
+    Points pts = { (double *)coords, NULL, ctx->labels, n, ctx->centroids.d, stride, NULL, NULL, NULL, NULL };
+
+    IncStats inc;
+    double start_time = omp_get_wtime();
+    if (inc_update(s, &pts, removed, num_removed, &ctx->centroids, ctx->kernel64, ctx->max_iter, &inc) != 0) {
+        fprintf(stderr, "Erro ao alocar memória para a atualização incremental.\n");
+        s->ready = 0;
+        return -1;
+    }
+    double end_time = omp_get_wtime();
+    centroids_to_f32(&ctx->centroids);
+    memcpy(ctx->seen, s->count, (size_t)ctx->centroids.k * sizeof(long long));
+
+    if (stats != NULL) {
+        memset(stats, 0, sizeof(*stats));
+        stats->iterations         = inc.iterations;
+        stats->time               = end_time - start_time;
+        stats->inertia            = -1.0;
+        stats->restart_iterations = inc.iterations;
+        stats->update_candidates  = inc.candidates;
+        stats->state_time         = inc.rebuild;
+    }
+    return inc.iterations;
+}
+
+// As chamadas abaixo rodam com as threads do contexto e devolvem ao chamador o número
+// de threads do OpenMP que ele tinha (a configuração vale só para a thread que chama)
+int kmeans_fit(KMeansContext *ctx, const double *coords, int n, size_t stride, KMeansStats *stats) {
+    int saved = omp_get_max_threads();
+    omp_set_num_threads(ctx->num_threads);
+    int result = fit(ctx, coords, n, stride, stats);
+    omp_set_num_threads(saved);
+    return result;
+}
+
+int kmeans_partial_fit(KMeansContext *ctx, const double *coords, int n, size_t stride) {
+    int saved = omp_get_max_threads();
+    omp_set_num_threads(ctx->num_threads);
+    int result = partial_fit(ctx, coords, n, stride);
+    omp_set_num_threads(saved);
+    return result;
+}
+
+int kmeans_update(KMeansContext *ctx, const double *coords, int n, size_t stride, const int *removed,
+                  int num_removed, KMeansStats *stats) {
+    int saved = omp_get_max_threads();
+    omp_set_num_threads(ctx->num_threads);
+    int result = update(ctx, coords, n, stride, removed, num_removed, stats);
+    omp_set_num_threads(saved);
+    return result;
+}
+
+int kmeans_predict(const KMeansContext *ctx, const double *coords, int n, size_t stride, uint16_t *labels) {
+    if (!ctx->trained || n < 0 || stride < (size_t)n) return -1;
+
+    Points pts = { (double *)coords, NULL, labels, n, ctx->centroids.d, stride, NULL, NULL, NULL, NULL };
+    int num_blocks = (n + ASSIGN_BLOCK - 1) / ASSIGN_BLOCK;
+    assign_kernel_fn kernel = ctx->labeler;
+
+    // Cada bloco de pontos é rotulado pelo kernel SIMD, sem somas e sem ler os rótulos
+    // anteriores do buffer do chamador
+    #pragma omp parallel num_threads(ctx->num_threads)
+    {
+      int first, last;
+      thread_blocks(num_blocks, &first, &last);
+      for (int b = first; b < last; b++) {
+        int begin = b * ASSIGN_BLOCK;
+        int end   = (begin + ASSIGN_BLOCK < n) ? begin + ASSIGN_BLOCK : n;
+        kernel(&pts, begin, end, &ctx->centroids, NULL);
+      }
+    }
+    return 0;
+}
+
+double kmeans_inertia(const KMeansContext *ctx, const double *coords, int n, size_t stride,
+                      const uint16_t *labels) {
+    Points pts = { (double *)coords, NULL, (label_t *)labels, n, ctx->centroids.d, stride, NULL, NULL, NULL, NULL };
+    int saved = omp_get_max_threads();
+    omp_set_num_threads(ctx->num_threads);
+    double inertia = batch_inertia(&pts, &ctx->centroids);
+    omp_set_num_threads(saved);
+    return inertia;
+}
+
+const double *kmeans_centroids(const KMeansContext *ctx) {
+    return ctx->centroids.pos;
+}
+
+const uint16_t *kmeans_labels(const KMeansContext *ctx) {
+    return ctx->labels;
+}
+
+int kmeans_save(const KMeansContext *ctx, const char *path) {
+    const Centroids *c = &ctx->centroids;
+    if (!ctx->trained) return -1;
+
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) {
+        perror(path);
+        return -1;
+    }
+
+    ModelHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, MODEL_MAGIC, sizeof(h.magic));
+    h.k = (uint32_t)c->k;
+    h.d = (uint32_t)c->d;
+    h.points = ctx->inc.ready ? (uint64_t)ctx->inc.n : 0;
+
+    int ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+             fwrite(c->pos, sizeof(double), (size_t)c->k * c->d, f) == (size_t)c->k * c->d;
+    for (int j = 0; ok && j < c->k; j++) {
+        uint64_t seen = (uint64_t)ctx->seen[j];
+        ok = fwrite(&seen, sizeof(seen), 1, f) == 1;
+    }
+
+    // Estado incremental: as folgas saem descontadas dos deslocamentos acumulados
+    if (ok && h.points > 0) {
+        size_t n   = (size_t)h.points;
+        float *gap = malloc(n * sizeof(float));
+        ok = gap != NULL;
+        if (ok) inc_gaps(&ctx->inc, gap);
+        ok = ok && fwrite(ctx->inc.sum, sizeof(double), (size_t)c->k * c->d, f) == (size_t)c->k * c->d &&
+             fwrite(ctx->labels, sizeof(label_t), n, f) == n && fwrite(gap, sizeof(float), n, f) == n;
+        free(gap);
+    }
+    if (fclose(f) != 0) ok = 0;
+    if (!ok) fprintf(stderr, "%s: erro ao gravar o modelo.\n", path);
+    return ok ? 0 : -1;
+}
+
+KMeansContext *kmeans_load(const char *path, const KMeansConfig *cfg) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        perror(path);
+        return NULL;
+    }
+
+    ModelHeader h;
+    if (fread(&h, sizeof(h), 1, f) != 1 || memcmp(h.magic, MODEL_MAGIC, sizeof(h.magic)) != 0 ||
+        h.k < 1 || h.k > MAX_K || h.d < 1 || h.d > MAX_D || h.points > INT_MAX) {
+        fprintf(stderr, "%s: não é um modelo do k-means.\n", path);
+        fclose(f);
+        return NULL;
+    }
+
+    KMeansConfig model;
+    if (cfg != NULL) model = *cfg;
+    else kmeans_config_init(&model, 0, 0);
+    model.k = (int)h.k;
+    model.d = (int)h.d;
+
+    KMeansContext *ctx = kmeans_create(&model);
+    Centroids *c = (ctx != NULL) ? &ctx->centroids : NULL;
+    int ok = ctx != NULL &&
+             fread(c->pos, sizeof(double), (size_t)c->k * c->d, f) == (size_t)c->k * c->d;
+    for (int j = 0; ok && j < c->k; j++) {
+        uint64_t seen;
+        ok = fread(&seen, sizeof(seen), 1, f) == 1;
+        ctx->seen[j] = (long long)seen;
+    }
+
+    // Estado incremental: somas, rótulos e folgas; as listas são montadas aqui
+    if (ok && h.points > 0) {
+        int     n   = (int)h.points;
+        double *sum = malloc((size_t)c->k * c->d * sizeof(double));
+        float  *gap = malloc((size_t)n * sizeof(float));
+        ctx->labels     = alloc_aligned((size_t)n * sizeof(label_t));
+        ctx->labels_cap = (ctx->labels != NULL) ? n : 0;
+        ok = sum != NULL && gap != NULL && ctx->labels != NULL &&
+             fread(sum, sizeof(double), (size_t)c->k * c->d, f) == (size_t)c->k * c->d &&
+             fread(ctx->labels, sizeof(label_t), (size_t)n, f) == (size_t)n &&
+             fread(gap, sizeof(float), (size_t)n, f) == (size_t)n;
+        for (int i = 0; ok && i < n; i++) ok = ctx->labels[i] == NO_LABEL || ctx->labels[i] < c->k;
+        ok = ok && inc_restore(&ctx->inc, c->k, c->d, n, sum, ctx->seen, ctx->labels, gap) == 0;
+        free(sum);
+        free(gap);
+    }
+    fclose(f);
+
+    if (!ok) {
+        fprintf(stderr, "%s: modelo truncado ou configuração inválida.\n", path);
+        kmeans_destroy(ctx);
+        return NULL;
+    }
+    centroids_to_f32(c);
+    ctx->trained = 1;
+    return ctx;
+}
@@ -0,0 +1,166 @@
+#include <omp.h>
+
+#include "kmeans.h"
+
+// Engine em duas passadas: atribuição em um laço e acumulação das somas em outro
+int iterate_twopass(void *state, Points *pts, const Centroids *c, assign_kernel_fn kernel, Sums *sums) {
+    int num_points = pts->n;
+    int num_blocks = (num_points + ASSIGN_BLOCK - 1) / ASSIGN_BLOCK;
+    int changed    = 0;
+    (void)state;
+
+    // Paraleliza a atribuição de pontos ao centróide mais próximo
+    // Cada bloco de pontos é rotulado pelo kernel SIMD selecionado (com a reordenação
+    // por cluster, os blocos que não podem mudar de cluster são pulados)
+    BlockBounds *blocks = pts->blocks;
+    #pragma omp parallel reduction(+:changed)
+    {
+      int first, last;
+      thread_blocks(num_blocks, &first, &last);
+      for (int b = first; b < last; b++) {
+        int begin = b * ASSIGN_BLOCK;
+        int end   = (begin + ASSIGN_BLOCK < num_points) ? begin + ASSIGN_BLOCK : num_points;
+        if (blocks != NULL && blocks->skip[b]) continue;
+        changed += kernel(pts, begin, end, c, NULL);
+        if (blocks != NULL) block_refresh(pts, c, b);
+      }
+      TRACE_BUSY();
+    }
+    TRACE_MARK(TRACE_ASSIGN);
+
+    // Paraleliza a soma dos pontos por centróide
+    // Cada thread calcula a soma localmente e depois as parciais são reduzidas
+    Sums *locals = thread_sums(sums);
+    if (locals == NULL) return -1;
+
+    #pragma omp parallel
+    {
+      Sums *local = &locals[omp_get_thread_num()];
+      int first, last;
+      thread_blocks(num_blocks, &first, &last);
+      int end = (last * ASSIGN_BLOCK < num_points) ? last * ASSIGN_BLOCK : num_points;
+
+      // Em precisão simples os pontos são lidos em float (ou decodificados dos 16
+      // bits) e somados em double. Com os pontos ordenados por cluster, a soma é
+      // feita por faixas do mesmo cluster
+      if (blocks != NULL) accumulate_runs(pts, first * ASSIGN_BLOCK, end, local);
+      for (int i = first * ASSIGN_BLOCK; blocks == NULL && i < end; i++) {
+        int cl = pts->labels[i];
+        double *row = local->sum + (size_t)cl * pts->d;
+        if (pts->coords16 != NULL) {
+            for (int d = 0; d < pts->d; d++) row[d] += point_q16(pts, d, i);
+        } else if (pts->coords32 != NULL) {
+            for (int d = 0; d < pts->d; d++) row[d] += pts->coords32[d * pts->stride + i];
+        } else {
+            for (int d = 0; d < pts->d; d++) row[d] += pts->coords[d * pts->stride + i];
+        }
+        local->count[cl]++;
+      }
+
+      TRACE_BUSY();
+      #pragma omp barrier
+      TRACE_MARK(TRACE_ACCUMULATE);
+      reduce_thread_sums(sums);
+    }
+    TRACE_MARK(TRACE_MERGE);
+
+    return changed;
+}
+
+// Engine fused: cada thread soma o ponto nas suas parciais na mesma passada em que
+// escolhe o centróide mais próximo. Lê os pontos uma única vez por iteração e
+// elimina uma região paralela (e a barreira correspondente)
+int iterate_fused(void *state, Points *pts, const Centroids *c, assign_kernel_fn kernel, Sums *sums) {
+    int num_points = pts->n;
+    int num_blocks = (num_points + ASSIGN_BLOCK - 1) / ASSIGN_BLOCK;
+    int changed    = 0;
+    (void)state;
+
+    Sums *locals = thread_sums(sums);
+    if (locals == NULL) return -1;
+
+    // Com a reordenação por cluster, um bloco que não pode mudar de cluster só é
+    // somado (em uma faixa)
+    BlockBounds *blocks = pts->blocks;
+    #pragma omp parallel reduction(+:changed)
+    {
+      Sums *local = &locals[omp_get_thread_num()];
+
+      int first, last;
+      thread_blocks(num_blocks, &first, &last);
+      for (int b = first; b < last; b++) {
+        int begin = b * ASSIGN_BLOCK;
+        int end   = (begin + ASSIGN_BLOCK < num_points) ? begin + ASSIGN_BLOCK : num_points;
+        if (blocks != NULL && blocks->skip[b]) {
+            accumulate_runs(pts, begin, end, local);
+            continue;
+        }
+        changed += kernel(pts, begin, end, c, local);
+        if (blocks != NULL) block_refresh(pts, c, b);
+      }
+
+      // Depois da barreira, as parciais são reduzidas centróide a centróide
+      TRACE_BUSY();
+      #pragma omp barrier
+      TRACE_MARK(TRACE_ASSIGN);
+      reduce_thread_sums(sums);
+    }
+    TRACE_MARK(TRACE_MERGE);
+
+    return changed;
+}
+
+// Vários reinícios (KMeansConfig.n_init) avançando juntos: cada bloco de pontos é
+// rotulado contra os centróides de todos os reinícios ativos antes de passar ao
+// próximo, então os pontos saem da memória uma vez por iteração e são relidos da
+// cache por cada reinício. Cada reinício tem os próprios rótulos e somas (labels[r],
+// sums[r]); changed[r] recebe os pontos que mudaram de cluster no reinício r.
+// Retorna 0, ou -1 se faltar memória
+int iterate_restarts(Points *pts, label_t *const *labels, const Centroids *c, assign_kernel_fn kernel,
+                     Sums *sums, const int *active, int num_restarts, int *changed) {
+    int num_points = pts->n;
+    int num_blocks = (num_points + ASSIGN_BLOCK - 1) / ASSIGN_BLOCK;
+
+    Sums *locals[MAX_RESTARTS];
+    for (int r = 0; r < num_restarts; r++) {
+        changed[r] = 0;
+        if (!active[r]) continue;
+        locals[r] = thread_sums(&sums[r]);
+        if (locals[r] == NULL) return -1;
+    }
+
+    #pragma omp parallel
+    {
+      int t = omp_get_thread_num();
+      int mine[MAX_RESTARTS] = { 0 };
+      Points view = *pts;
+
+      int first, last;
+      thread_blocks(num_blocks, &first, &last);
+      for (int b = first; b < last; b++) {
+        int begin = b * ASSIGN_BLOCK;
+        int end   = (begin + ASSIGN_BLOCK < num_points) ? begin + ASSIGN_BLOCK : num_points;
+        for (int r = 0; r < num_restarts; r++) {
+            if (!active[r]) continue;
+            view.labels = labels[r];
+            mine[r] += kernel(&view, begin, end, &c[r], &locals[r][t]);
+        }
+      }
+      for (int r = 0; r < num_restarts; r++) {
+          if (!active[r]) continue;
+          #pragma omp atomic
+          changed[r] += mine[r];
+      }
+
+      // Depois da barreira, as parciais de cada reinício são reduzidas
+      TRACE_BUSY();
+      #pragma omp barrier
+      TRACE_MARK(TRACE_ASSIGN);
+      for (int r = 0; r < num_restarts; r++) {
+          if (active[r]) reduce_thread_sums(&sums[r]);
+      }
+    }
+    TRACE_MARK(TRACE_MERGE);
+
+    return 0;
+}
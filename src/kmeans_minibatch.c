@@ -0,0 +1,44 @@
+#include <stdlib.h>
+#include <omp.h>
+
+#include "kmeans.h"
+
+// Modo mini-batch (Sculley, 2010): os pontos chegam em lotes de tamanho fixo e
+// cada lote move os centróides com uma taxa de aprendizado própria de cada
+// centróide (1 / pontos já vistos por ele). Só um lote fica na memória, então o
+// consumo não depende de N.
+
+// Move cada centróide em direção à média dos seus pontos no lote. Com taxa
+// count / seen, o resultado é o mesmo de aplicar a taxa 1 / seen ponto a ponto
+void minibatch_update(Centroids *c, const Sums *batch_sums, long long *seen) {
+    for (int j = 0; j < c->k; j++) {
+        int count = batch_sums->count[j];
+        if (count == 0) continue;
+
+        seen[j] += count;
+        double eta = (double)count / (double)seen[j];
+        double *cj = centroid(c, j);
+        const double *sj = batch_sums->sum + (size_t)j * c->d;
+        for (int d = 0; d < c->d; d++) cj[d] += eta * (sj[d] / count - cj[d]);
+    }
+}
+
+// Soma das distâncias ao quadrado de cada ponto ao centróide do seu rótulo (em
+// double, também para pontos em float32 ou quantizados)
+double batch_inertia(const Points *pts, const Centroids *c) {
+    double inertia = 0.0;
+
+    #pragma omp parallel for schedule(static) reduction(+:inertia)
+    for (int i = 0; i < pts->n; i++) {
+        double p[pts->d];
+        if (pts->coords16 != NULL) {
+            for (int d = 0; d < pts->d; d++) p[d] = point_q16(pts, d, i);
+        } else if (pts->coords32 != NULL) {
+            for (int d = 0; d < pts->d; d++) p[d] = point_col32(pts, d)[i];
+        } else {
+            load_point(pts, i, p);
+        }
+        inertia += distance_sq(p, centroid(c, pts->labels[i]), pts->d);
+    }
+    return inertia;
+}
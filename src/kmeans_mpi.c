@@ -0,0 +1,234 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef KMEANS_MPI
+#include <mpi.h>
+#endif
+
+#include "kmeans.h"
+
+// Versão distribuída (make VERSION=mpi, compilada com KMEANS_MPI). Cada processo
+// guarda uma parte dos pontos (faixas contíguas de blocos, ver dataset_open_part)
+// e roda a engine OpenMP sobre ela; as somas e contagens por centróide e o número
+// de pontos que mudaram de cluster são somados entre os processos a cada iteração.
+// As somas são reduzidas em MPI_CHUNKS faixas de centróides com MPI_Iallreduce: a
+// faixa já reduzida entre as threads é enviada enquanto as threads reduzem a
+// seguinte (ver reduce_thread_sums). Sem KMEANS_MPI, as funções tratam o programa
+// como um único processo e não fazem nada.
+
+#define INIT_SAMPLE (1 << 20) // Máximo de pontos reunidos no processo 0 para a inicialização
+
+// Processo atual e número de processos no comunicador em uso (ver mpi_use_ranks)
+static int rank       = 0;
+static int num_ranks  = 1;
+static int world_size = 1;
+
+#ifdef KMEANS_MPI
+static MPI_Comm    comm;
+static MPI_Request sum_requests[2 * MPI_CHUNKS];
+static int         num_sum_requests = 0;
+static MPI_Request changed_request  = MPI_REQUEST_NULL;
+#endif
+
+int mpi_rank(void)       { return rank; }
+int mpi_ranks(void)      { return num_ranks; }
+int mpi_world_size(void) { return world_size; }
+
+// Inicia o MPI (as chamadas saem só da thread mestre de cada processo). A saída
+// padrão dos processos diferentes do 0 é descartada, então os relatórios aparecem
+// uma vez só; erros continuam na saída de erro
+int mpi_start(int *argc, char ***argv) {
+#ifdef KMEANS_MPI
+    int provided;
+    if (MPI_Init_thread(argc, argv, MPI_THREAD_FUNNELED, &provided) != MPI_SUCCESS) return -1;
+    comm = MPI_COMM_WORLD;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &num_ranks);
+    world_size = num_ranks;
+    if (provided < MPI_THREAD_FUNNELED && rank == 0) {
+        fprintf(stderr, "Aviso: o MPI não garante MPI_THREAD_FUNNELED.\n");
+    }
+    if (rank != 0 && freopen("/dev/null", "w", stdout) == NULL) return -1;
+#else
+    (void)argc;
+    (void)argv;
+#endif
+    return 0;
+}
+
+void mpi_finish(void) {
+#ifdef KMEANS_MPI
+    mpi_use_ranks(world_size);
+    MPI_Finalize();
+#endif
+}
+
+// Restringe as próximas execuções aos processos 0, ..., count - 1 (para medir a
+// escalabilidade com menos processos que os do mpirun). Chamada por todos os
+// processos; retorna 1 nos que participam e 0 nos que ficam de fora, que não devem
+// chamar nenhuma outra função daqui até a próxima mpi_use_ranks
+int mpi_use_ranks(int count) {
+#ifdef KMEANS_MPI
+    int world_rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+    if (comm != MPI_COMM_WORLD && comm != MPI_COMM_NULL) MPI_Comm_free(&comm);
+    if (count >= world_size) {
+        comm = MPI_COMM_WORLD;
+    } else {
+        MPI_Comm_split(MPI_COMM_WORLD, (world_rank < count) ? 0 : MPI_UNDEFINED, world_rank, &comm);
+        if (comm == MPI_COMM_NULL) return 0;
+    }
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &num_ranks);
+#else
+    (void)count;
+#endif
+    return 1;
+}
+
+// Encerra todos os processos depois de um erro que só este processo viu (os outros
+// ficariam parados na próxima operação coletiva)
+void mpi_fail(void) {
+#ifdef KMEANS_MPI
+    if (world_size > 1) MPI_Abort(MPI_COMM_WORLD, 1);
+#endif
+}
+
+double mpi_sum(double value) {
+#ifdef KMEANS_MPI
+    if (num_ranks > 1) MPI_Allreduce(MPI_IN_PLACE, &value, 1, MPI_DOUBLE, MPI_SUM, comm);
+#endif
+    return value;
+}
+
+double mpi_max(double value) {
+#ifdef KMEANS_MPI
+    if (num_ranks > 1) MPI_Allreduce(MPI_IN_PLACE, &value, 1, MPI_DOUBLE, MPI_MAX, comm);
+#endif
+    return value;
+}
+
+// Soma de count nos processos anteriores a este (posição global do primeiro ponto
+// deste processo, quando count é o número de pontos de cada um)
+long long mpi_offset(long long count) {
+    long long offset = 0;
+#ifdef KMEANS_MPI
+    if (num_ranks > 1) MPI_Exscan(&count, &offset, 1, MPI_LONG_LONG, MPI_SUM, comm);
+    if (rank == 0) offset = 0;
+#else
+    (void)count;
+#endif
+    return offset;
+}
+
+// Soma count valores entre os processos, no lugar (somas ponderadas da pipeline
+// grossa-para-fina)
+void mpi_sum_array(double *values, int count) {
+#ifdef KMEANS_MPI
+    if (num_ranks > 1) MPI_Allreduce(MPI_IN_PLACE, values, count, MPI_DOUBLE, MPI_SUM, comm);
+#else
+    (void)values;
+    (void)count;
+#endif
+}
+
+// Dispara a soma entre os processos dos centróides [first, last) de s, já reduzidos
+// entre as threads. Só a thread mestre chama
+void mpi_post_sums(Sums *s, int first, int last) {
+#ifdef KMEANS_MPI
+    if (first == last) return;
+    MPI_Iallreduce(MPI_IN_PLACE, s->sum + (size_t)first * s->d, (last - first) * s->d, MPI_DOUBLE,
+                   MPI_SUM, comm, &sum_requests[num_sum_requests++]);
+    MPI_Iallreduce(MPI_IN_PLACE, s->count + first, last - first, MPI_INT,
+                   MPI_SUM, comm, &sum_requests[num_sum_requests++]);
+#else
+    (void)s;
+    (void)first;
+    (void)last;
+#endif
+}
+
+// Espera as somas disparadas por mpi_post_sums. Só a thread mestre chama
+void mpi_wait_sums(void) {
+#ifdef KMEANS_MPI
+    MPI_Waitall(num_sum_requests, sum_requests, MPI_STATUSES_IGNORE);
+    num_sum_requests = 0;
+#endif
+}
+
+// Dispara a soma de *changed entre os processos; o resultado só pode ser lido depois
+// de mpi_wait_changed, e entre as duas chamadas o processo pode atualizar os centróides
+void mpi_post_changed(int *changed) {
+#ifdef KMEANS_MPI
+    if (num_ranks > 1) MPI_Iallreduce(MPI_IN_PLACE, changed, 1, MPI_INT, MPI_SUM, comm, &changed_request);
+#else
+    (void)changed;
+#endif
+}
+
+void mpi_wait_changed(void) {
+#ifdef KMEANS_MPI
+    MPI_Wait(&changed_request, MPI_STATUS_IGNORE);
+#endif
+}
+
+// Inicializa os centróides na versão MPI. A amostra são os pontos de índice global
+// múltiplo de um passo fixo (no total, até INIT_SAMPLE): cada processo contribui com
+// os da sua parte, o processo 0 roda a inicialização sobre a amostra reunida e envia
+// os centróides aos demais. A amostra não depende do número de processos (inclusive
+// com um só), então os testes de escalabilidade partem dos mesmos centróides.
+// Retorna 0, ou -1 em todos os processos se faltar memória em algum
+int mpi_init_centroids(const Initializer *ini, const Points *pts, Centroids *c, unsigned int seed) {
+#ifdef KMEANS_MPI
+    double total = mpi_sum((double)pts->n);
+    int    step  = (total > INIT_SAMPLE) ? (int)((total + INIT_SAMPLE - 1) / INIT_SAMPLE) : 1;
+    if (num_ranks == 1 && step == 1) return ini->init(pts, c, seed);
+
+    // Primeiro ponto local com índice global múltiplo de step
+    long long first = mpi_offset(pts->n);
+    int skip  = (int)((step - first % step) % step);
+    int count = (pts->n > skip) ? (pts->n - skip + step - 1) / step : 0;
+
+    int *counts  = NULL, *offsets = NULL;
+    int  sample_n = 0;
+    if (rank == 0) {
+        counts  = malloc((size_t)num_ranks * sizeof(int));
+        offsets = malloc((size_t)num_ranks * sizeof(int));
+        if (counts == NULL || offsets == NULL) mpi_fail();
+    }
+    MPI_Gather(&count, 1, MPI_INT, counts, 1, MPI_INT, 0, comm);
+    if (rank == 0) {
+        for (int r = 0; r < num_ranks; r++) {
+            offsets[r] = sample_n;
+            sample_n  += counts[r];
+        }
+    }
+
+    // A amostra local e a reunida no processo 0, coluna a coluna
+    Points sample;
+    double *mine = malloc(((size_t)count + 1) * sizeof(double));
+    int rc = (mine == NULL || (rank == 0 && alloc_points(&sample, sample_n, pts->d) != 0)) ? -1 : 0;
+    if (rc != 0) mpi_fail();
+
+    for (int d = 0; d < pts->d; d++) {
+        for (int i = 0; i < count; i++) mine[i] = point_col(pts, d)[skip + (size_t)i * step];
+        MPI_Gatherv(mine, count, MPI_DOUBLE, (rank == 0) ? point_col(&sample, d) : NULL,
+                    counts, offsets, MPI_DOUBLE, 0, comm);
+    }
+    free(mine);
+
+    if (rank == 0) {
+        rc = ini->init(&sample, c, seed);
+        free_points(&sample);
+        free(counts);
+        free(offsets);
+    }
+    MPI_Bcast(&rc, 1, MPI_INT, 0, comm);
+    if (rc == 0) MPI_Bcast(c->pos, c->k * c->d, MPI_DOUBLE, 0, comm);
+    return rc;
+#else
+    return ini->init(pts, c, seed);
+#endif
+}
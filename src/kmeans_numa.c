@@ -0,0 +1,168 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <unistd.h>
+#include <omp.h>
+
+#ifdef KMEANS_NUMA
+#include <numa.h>
+#endif
+
+#include "kmeans.h"
+
+// Modo NUMA (opção -N da v3). Cada thread é fixada em uma CPU, e as threads ocupam
+// primeiro as CPUs de um nó e depois as do seguinte. Os laços sobre os pontos usam
+// a mesma divisão em blocos (thread_blocks), então, com os pontos de cada thread
+// alocados no nó dela (numa_bind_points), toda iteração lê memória local. As somas
+// por centróide são reduzidas primeiro dentro de cada nó e só depois entre os nós
+// (reduce_thread_sums). Sem libnuma (compilado sem KMEANS_NUMA), só fixa as threads
+// e trata a máquina como um único nó.
+
+NumaLayout numa_layout = { 0, 1, 0, NULL, NULL, NULL, NULL, NULL };
+
+// CPUs permitidas ao processo, lidas antes de a primeira thread ser fixada
+static cpu_set_t allowed;
+static int       allowed_read = 0;
+
+static int node_of_cpu(int cpu) {
+#ifdef KMEANS_NUMA
+    int node = (numa_available() >= 0) ? numa_node_of_cpu(cpu) : 0;
+    return (node < 0) ? 0 : node;
+#else
+    (void)cpu;
+    return 0;
+#endif
+}
+
+static int compare_cpu(const void *a, const void *b) {
+    int x = *(const int *)a, y = *(const int *)b;
+    int nx = node_of_cpu(x), ny = node_of_cpu(y);
+    if (nx != ny) return (nx > ny) - (nx < ny);
+    return (x > y) - (x < y);
+}
+
+void numa_release(void) {
+    free(numa_layout.thread_node);
+    free(numa_layout.node_rank);
+    free(numa_layout.node_members);
+    free(numa_layout.node_offset);
+    free(numa_layout.node_id);
+    memset(&numa_layout, 0, sizeof(numa_layout));
+    numa_layout.num_nodes = 1;
+}
+
+int numa_setup(int num_threads) {
+    if (!allowed_read) {
+        CPU_ZERO(&allowed);
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+            perror("sched_getaffinity");
+            return -1;
+        }
+        allowed_read = 1;
+#ifdef KMEANS_NUMA
+        if (numa_available() < 0) fprintf(stderr, "Aviso: NUMA indisponível, só fixando as threads.\n");
+#else
+        fprintf(stderr, "Aviso: compilado sem libnuma (NUMA=1), só fixando as threads.\n");
+#endif
+    }
+
+    // CPUs permitidas, ordenadas por nó e depois por número
+    int ncpu = 0;
+    int *cpus = malloc(CPU_SETSIZE * sizeof(int));
+    if (cpus == NULL) return -1;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &allowed)) cpus[ncpu++] = cpu;
+    }
+    qsort(cpus, (size_t)ncpu, sizeof(int), compare_cpu);
+
+    numa_release();
+    NumaLayout *nl = &numa_layout;
+    nl->thread_node  = malloc((size_t)num_threads * sizeof(int));
+    nl->node_rank    = malloc((size_t)num_threads * sizeof(int));
+    nl->node_members = malloc((size_t)num_threads * sizeof(int));
+    nl->node_offset  = calloc((size_t)num_threads + 1, sizeof(int));
+    nl->node_id      = malloc((size_t)num_threads * sizeof(int));
+    if (nl->thread_node == NULL || nl->node_rank == NULL || nl->node_members == NULL ||
+        nl->node_offset == NULL || nl->node_id == NULL) {
+        free(cpus);
+        numa_release();
+        return -1;
+    }
+
+    // Com OMP_PROC_BIND definido, as places do OpenMP já fixam as threads; senão a
+    // thread t vai para a t-ésima CPU da lista (em ordem circular)
+    int bind_here = (omp_get_proc_bind() == omp_proc_bind_false);
+    #pragma omp parallel num_threads(num_threads)
+    {
+      int t = omp_get_thread_num();
+      if (bind_here) {
+          cpu_set_t set;
+          CPU_ZERO(&set);
+          CPU_SET(cpus[t % ncpu], &set);
+          sched_setaffinity(0, sizeof(set), &set);
+      }
+      nl->thread_node[t] = node_of_cpu(sched_getcpu());
+    }
+    free(cpus);
+
+    // Renumera os nós usados (0, 1, ... na ordem da primeira thread de cada um) e
+    // agrupa as threads por nó, em ordem de thread
+    nl->num_nodes = 0;
+    for (int t = 0; t < num_threads; t++) {
+        int n = 0;
+        while (n < nl->num_nodes && nl->node_id[n] != nl->thread_node[t]) n++;
+        if (n == nl->num_nodes) nl->node_id[nl->num_nodes++] = nl->thread_node[t];
+        nl->thread_node[t] = n;
+        nl->node_offset[n + 1]++;
+    }
+    for (int n = 0; n < nl->num_nodes; n++) nl->node_offset[n + 1] += nl->node_offset[n];
+    for (int n = 0, next = 0; n < nl->num_nodes; n++) {
+        for (int t = 0; t < num_threads; t++) {
+            if (nl->thread_node[t] != n) continue;
+            nl->node_rank[t] = next - nl->node_offset[n];
+            nl->node_members[next++] = t;
+        }
+    }
+
+    nl->enabled     = 1;
+    nl->num_threads = num_threads;
+    return 0;
+}
+
+// Associa as páginas das colunas dos pontos ao nó da thread que vai processá-las,
+// antes do primeiro acesso (páginas já tocadas não são movidas). Páginas na divisa
+// entre threads de nós diferentes ficam com a última
+void numa_bind_points(const Points *pts) {
+#ifdef KMEANS_NUMA
+    const NumaLayout *nl = &numa_layout;
+    if (!nl->enabled || nl->num_nodes < 2 || numa_available() < 0) return;
+
+    long   page       = sysconf(_SC_PAGESIZE);
+    size_t elem       = (pts->coords16 != NULL) ? sizeof(uint16_t) :
+                        (pts->coords32 != NULL) ? sizeof(float) : sizeof(double);
+    char  *base       = (pts->coords16 != NULL) ? (char *)pts->coords16 :
+                        (pts->coords32 != NULL) ? (char *)pts->coords32 : (char *)pts->coords;
+    int    num_blocks = (pts->n + ASSIGN_BLOCK - 1) / ASSIGN_BLOCK;
+
+    for (int t = 0; t < nl->num_threads; t++) {
+        int first, last;
+        block_share(num_blocks, t, nl->num_threads, &first, &last);
+        if (first == last) continue;
+
+        size_t begin = (size_t)first * ASSIGN_BLOCK;
+        size_t end   = (size_t)last * ASSIGN_BLOCK;
+        if (end > (size_t)pts->n) end = pts->n;
+        for (int d = 0; d < pts->d; d++) {
+            char *lo = base + ((size_t)d * pts->stride + begin) * elem;
+            char *hi = base + ((size_t)d * pts->stride + end) * elem;
+            char *aligned = (char *)((uintptr_t)lo / page * page);
+            numa_tonode_memory(aligned, (size_t)(hi - aligned), nl->node_id[nl->thread_node[t]]);
+        }
+    }
+#else
+    (void)pts;
+#endif
+}
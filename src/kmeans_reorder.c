@@ -0,0 +1,362 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <omp.h>
+
+#include "kmeans.h"
+
+// Reordenação periódica dos pontos por cluster (KMeansConfig.reorder, engines twopass
+// e fused). Depois que o agrupamento se estabiliza, só os pontos da fronteira mudam
+// de cluster, mas na ordem original cada bloco mistura todos os clusters: cada
+// thread soma em linhas de acumuladores espalhadas e nenhum bloco tem um cluster só.
+// A cada period iterações os pontos são ordenados pelo rótulo e, dentro de cada
+// cluster, os do núcleo (a menos de REORDER_CORE x metade da distância do centróide
+// ao mais próximo) vêm antes dos da borda. A partir daí:
+// - a acumulação percorre faixas contínuas do mesmo cluster, somando cada coordenada
+//   da faixa em um registrador e só então na linha do centróide (accumulate_runs);
+// - um bloco em que todos os pontos têm o mesmo cluster guarda o raio (limitante
+//   superior da distância ao centróide), corrigido pelo deslocamento do centróide a
+//   cada iteração. Enquanto o raio for menor que metade da distância do centróide ao
+//   mais próximo, nenhum ponto do bloco muda de cluster, e o bloco não calcula
+//   distâncias (só é somado).
+// A ordem das somas muda, então os centróides podem diferir nos últimos dígitos de
+// uma execução sem reordenação.
+
+// Folga do teste dos blocos nos kernels em float32 e 16 bits, em relação à de
+// bound_tolerance: cobre o arredondamento das distâncias calculadas em float
+#define REORDER_FLOAT_SCALE 1e4
+
+// Fração de metade da distância ao centróide mais próximo que separa o núcleo da
+// borda de um cluster. Os blocos do núcleo continuam pulados enquanto o centróide
+// se desloca menos que o restante da fração
+#define REORDER_CORE 0.8
+
+void reorder_free(Reorder *r) {
+    free(r->buf[0]);
+    free(r->buf[1]);
+    free(r->labels);
+    free(r->perm);
+    free(r->order);
+    free(r->blocks.label);
+    free(r->blocks.radius);
+    free(r->blocks.skip);
+    free_centroids(&r->prev);
+    free(r->drift);
+    free(r->half_min);
+    int period = r->period;
+    memset(r, 0, sizeof(Reorder));
+    r->period = period;
+}
+
+// Prepara o início de um fit sobre pts (ainda em double, na ordem original):
+// vetores por ponto e por bloco (realocados só se n crescer) e a folga do teste dos
+// blocos. Retorna 0, ou -1 se faltar memória
+int reorder_begin(Reorder *r, const Points *pts, int k, int precision) {
+    int n = pts->n;
+    int num_blocks = (n + ASSIGN_BLOCK - 1) / ASSIGN_BLOCK;
+
+    if (n > r->cap) {
+        free(r->labels);
+        free(r->perm);
+        free(r->order);
+        r->labels = alloc_aligned((size_t)n * sizeof(label_t));
+        r->perm   = malloc((size_t)n * sizeof(int));
+        r->order  = malloc((size_t)n * sizeof(int));
+        r->cap    = (r->labels != NULL && r->perm != NULL && r->order != NULL) ? n : 0;
+        if (r->cap == 0) return -1;
+    }
+    if (num_blocks > r->blocks_cap) {
+        free(r->blocks.label);
+        free(r->blocks.radius);
+        free(r->blocks.skip);
+        r->blocks.label  = malloc((size_t)num_blocks * sizeof(label_t));
+        r->blocks.radius = malloc((size_t)num_blocks * sizeof(double));
+        r->blocks.skip   = malloc((size_t)num_blocks);
+        r->blocks_cap    = (r->blocks.label != NULL && r->blocks.radius != NULL && r->blocks.skip != NULL)
+                           ? num_blocks : 0;
+        if (r->blocks_cap == 0) return -1;
+    }
+    if (r->prev.pos == NULL) {
+        r->drift    = malloc((size_t)k * sizeof(double));
+        r->half_min = malloc((size_t)k * sizeof(double));
+        if (r->drift == NULL || r->half_min == NULL || alloc_centroids(&r->prev, k, pts->d) != 0) return -1;
+    }
+
+    r->blocks.num_blocks = num_blocks;
+    for (int b = 0; b < num_blocks; b++) {
+        r->blocks.label[b] = NO_LABEL;
+        r->blocks.skip[b]  = 0;
+    }
+    r->current  = -1;
+    r->planned  = 0;
+    r->reorders = 0;
+    r->time     = 0.0;
+    r->skipped  = 0;
+    r->checked  = 0;
+    r->tol      = bound_tolerance(pts);
+    if (precision != PREC_F64) r->tol *= REORDER_FLOAT_SCALE * sqrt((double)pts->d);
+    return 0;
+}
+
+// Metade da distância de cada centróide ao centróide mais próximo
+static void update_half_min(Reorder *r, const Centroids *c) {
+    int k = c->k;
+    for (int j = 0; j < k; j++) r->half_min[j] = INFINITY;
+    for (int j = 0; j < k; j++) {
+        for (int l = j + 1; l < k; l++) {
+            double h = 0.5 * sqrt(distance_sq(centroid(c, j), centroid(c, l), c->d));
+            if (h < r->half_min[j]) r->half_min[j] = h;
+            if (h < r->half_min[l]) r->half_min[l] = h;
+        }
+    }
+}
+
+// Antes de cada iteração: corrige o raio dos blocos uniformes pelo deslocamento do
+// centróide e marca os que não podem mudar de cluster. Custo O(K^2) para as
+// distâncias entre centróides, feito por uma única thread (como nas engines com
+// limitantes)
+void reorder_plan(Reorder *r, const Centroids *c) {
+    BlockBounds *bb = &r->blocks;
+    int k = c->k;
+
+    if (r->planned) {
+        for (int j = 0; j < k; j++) r->drift[j] = sqrt(distance_sq(centroid(c, j), centroid(&r->prev, j), c->d));
+    }
+    update_half_min(r, c);
+
+    // Um ponto a distância <= raio + folga do centróide a está estritamente mais
+    // perto de a que de qualquer outro centróide quando raio + folga < metade da
+    // menor distância de a aos demais
+    for (int b = 0; b < bb->num_blocks; b++) {
+        int a = bb->label[b];
+        bb->skip[b] = 0;
+        if (a == NO_LABEL) continue;
+        if (r->planned) bb->radius[b] += r->drift[a];
+        bb->skip[b] = bb->radius[b] + r->tol < r->half_min[a];
+        r->skipped += bb->skip[b];
+    }
+    r->checked += bb->num_blocks;
+
+    copy_centroids(&r->prev, c);
+    r->planned = 1;
+}
+
+// Depois da atribuição do bloco b: se todos os pontos ficaram no mesmo cluster,
+// guarda o cluster e o raio (maior distância de um ponto do bloco ao centróide)
+void block_refresh(const Points *pts, const Centroids *c, int b) {
+    BlockBounds *bb = pts->blocks;
+    int begin = b * ASSIGN_BLOCK;
+    int end   = (begin + ASSIGN_BLOCK < pts->n) ? begin + ASSIGN_BLOCK : pts->n;
+    int a     = pts->labels[begin];
+
+    bb->label[b] = NO_LABEL;
+    for (int i = begin + 1; i < end; i++) {
+        if (pts->labels[i] != a) return;
+    }
+
+    // Distâncias ao quadrado acumuladas coluna a coluna
+    double dist[ASSIGN_BLOCK];
+    const double *ca = centroid(c, a);
+    for (int i = 0; i < end - begin; i++) dist[i] = 0.0;
+    for (int d = 0; d < pts->d; d++) {
+        size_t col = (size_t)d * pts->stride + begin;
+        if (pts->coords16 != NULL) {
+            for (int i = 0; i < end - begin; i++) {
+                double t = point_q16(pts, d, begin + i) - ca[d];
+                dist[i] += t * t;
+            }
+        } else if (pts->coords32 != NULL) {
+            for (int i = 0; i < end - begin; i++) {
+                double t = pts->coords32[col + i] - ca[d];
+                dist[i] += t * t;
+            }
+        } else {
+            for (int i = 0; i < end - begin; i++) {
+                double t = pts->coords[col + i] - ca[d];
+                dist[i] += t * t;
+            }
+        }
+    }
+
+    double radius = 0.0;
+    for (int i = 0; i < end - begin; i++) radius = dmax(radius, dist[i]);
+    bb->radius[b] = sqrt(radius);
+    bb->label[b]  = (label_t)a;
+}
+
+// Soma os pontos [begin, end) nas parciais local, uma faixa contínua de pontos do
+// mesmo cluster por vez: cada coordenada da faixa é somada em uma variável e só
+// depois na linha do centróide. Nos pontos em 16 bits a faixa soma os inteiros e
+// decodifica uma vez (início * pontos + passo * soma)
+void accumulate_runs(const Points *pts, int begin, int end, Sums *local) {
+    for (int i = begin; i < end;) {
+        int cl = pts->labels[i];
+        int j  = i + 1;
+        while (j < end && pts->labels[j] == cl) j++;
+
+        double *row = local->sum + (size_t)cl * pts->d;
+        for (int d = 0; d < pts->d; d++) {
+            size_t col = (size_t)d * pts->stride;
+            if (pts->coords16 != NULL) {
+                uint64_t s = 0;
+                for (int t = i; t < j; t++) s += pts->coords16[col + t];
+                row[d] += (double)(j - i) * pts->q_lo[d] + (double)pts->q_step[d] * (double)s;
+            } else if (pts->coords32 != NULL) {
+                double s = 0.0;
+                for (int t = i; t < j; t++) s += pts->coords32[col + t];
+                row[d] += s;
+            } else {
+                double s = 0.0;
+                for (int t = i; t < j; t++) s += pts->coords[col + t];
+                row[d] += s;
+            }
+        }
+        local->count[cl] += j - i;
+        i = j;
+    }
+}
+
+// Chave de ordenação do ponto i: 2 x cluster, mais 1 se o ponto está na borda
+// (distância ao centróide c do cluster de pelo menos REORDER_CORE x half_min)
+static inline int sort_key(const Reorder *r, const Points *pts, const Centroids *c, int i) {
+    int a = pts->labels[i];
+    const double *ca = centroid(c, a);
+    double dist = 0.0;
+    for (int d = 0; d < pts->d; d++) {
+        size_t at = (size_t)d * pts->stride + i;
+        double t  = (pts->coords16 != NULL) ? point_q16(pts, d, i) - ca[d] :
+                    (pts->coords32 != NULL) ? pts->coords32[at] - ca[d] : pts->coords[at] - ca[d];
+        dist += t * t;
+    }
+    double core = REORDER_CORE * r->half_min[a];
+    return 2 * a + (dist >= core * core);
+}
+
+// Ordena os pontos pela chave sort_key (counting sort estável: a ordem é a mesma
+// com qualquer número de threads) no buffer que não está em uso, junto com os
+// rótulos (alternando entre labels, os do chamador, e os da reordenação), e aponta
+// pts para a cópia. Cada thread conta as chaves da sua faixa, as posições de cada
+// (chave, thread) saem de um prefixo e cada thread espalha os índices da sua faixa;
+// depois cada thread copia as posições de destino da sua faixa, então as páginas
+// novas ficam no nó NUMA da thread que as lê. Retorna 0, ou -1 se faltar memória
+int reorder_points(Reorder *r, Points *pts, const Centroids *c, label_t *labels) {
+    double start = omp_get_wtime();
+    int n = pts->n, k = 2 * c->k;
+    int num_blocks = (n + ASSIGN_BLOCK - 1) / ASSIGN_BLOCK;
+
+    size_t elem   = (pts->coords16 != NULL) ? sizeof(uint16_t) :
+                    (pts->coords32 != NULL) ? sizeof(float) : sizeof(double);
+    size_t stride = (pts->coords16 != NULL) ? points_stride16(n) :
+                    (pts->coords32 != NULL) ? points_stride32(n) : points_stride(n);
+    size_t bytes  = stride * pts->d * elem;
+    int    fresh  = bytes > r->buf_cap;
+    if (fresh) {
+        free(r->buf[0]);
+        free(r->buf[1]);
+        r->buf[0]  = alloc_aligned(bytes);
+        r->buf[1]  = alloc_aligned(bytes);
+        r->buf_cap = (r->buf[0] != NULL && r->buf[1] != NULL) ? bytes : 0;
+        if (r->buf_cap == 0) return -1;
+    }
+
+    int *offsets = calloc((size_t)omp_get_max_threads() * k, sizeof(int));
+    if (offsets == NULL) return -1;
+    update_half_min(r, c);
+
+    int      dst       = (r->current == 0) ? 1 : 0;
+    label_t *to_labels = (pts->labels == labels) ? r->labels : labels;
+    Points   sorted    = *pts;
+    sorted.stride      = stride;
+    sorted.labels      = to_labels;
+    if (pts->coords16 != NULL)      sorted.coords16 = r->buf[dst];
+    else if (pts->coords32 != NULL) sorted.coords32 = r->buf[dst];
+    else                            sorted.coords   = r->buf[dst];
+
+    // Páginas novas vão para o nó NUMA da thread que as lê (antes do primeiro acesso)
+    if (fresh) {
+        Points other = sorted;
+        if (other.coords16 != NULL)      other.coords16 = r->buf[1 - dst];
+        else if (other.coords32 != NULL) other.coords32 = r->buf[1 - dst];
+        else                             other.coords   = r->buf[1 - dst];
+        numa_bind_points(&sorted);
+        numa_bind_points(&other);
+    }
+
+    int composed = (r->current >= 0);
+    #pragma omp parallel
+    {
+      int t = omp_get_thread_num(), num_threads = omp_get_num_threads();
+      int first, last;
+      thread_blocks(num_blocks, &first, &last);
+      int begin = first * ASSIGN_BLOCK;
+      int end   = (last * ASSIGN_BLOCK < n) ? last * ASSIGN_BLOCK : n;
+      int *mine = offsets + (size_t)t * k;
+
+      for (int i = begin; i < end; i++) mine[sort_key(r, pts, c, i)]++;
+      #pragma omp barrier
+
+      // Posições por chave e, dentro da chave, por thread (na ordem da faixa)
+      #pragma omp single
+      {
+        int pos = 0;
+        for (int j = 0; j < k; j++) {
+            for (int s = 0; s < num_threads; s++) {
+                int count = offsets[(size_t)s * k + j];
+                offsets[(size_t)s * k + j] = pos;
+                pos += count;
+            }
+        }
+      }
+
+      for (int i = begin; i < end; i++) r->order[mine[sort_key(r, pts, c, i)]++] = i;
+      #pragma omp barrier
+
+      // Cópia para as posições de destino da faixa da thread
+      for (int d = 0; d < pts->d; d++) {
+          size_t from = (size_t)d * pts->stride, to = (size_t)d * stride;
+          if (elem == sizeof(uint16_t)) {
+              for (int i = begin; i < end; i++) sorted.coords16[to + i] = pts->coords16[from + r->order[i]];
+          } else if (elem == sizeof(float)) {
+              for (int i = begin; i < end; i++) sorted.coords32[to + i] = pts->coords32[from + r->order[i]];
+          } else {
+              for (int i = begin; i < end; i++) sorted.coords[to + i] = pts->coords[from + r->order[i]];
+          }
+      }
+      for (int i = begin; i < end; i++) to_labels[i] = pts->labels[r->order[i]];
+
+      // Os blocos da faixa mudaram de conteúdo: o raio é recalculado já em relação
+      // aos centróides atuais (o deslocamento somado na próxima iteração só o afrouxa)
+      for (int b = first; b < last; b++) block_refresh(&sorted, c, b);
+
+      // Índice original: a origem na ordem anterior passa pela permutação anterior
+      if (composed) {
+          for (int i = begin; i < end; i++) r->order[i] = r->perm[r->order[i]];
+      }
+    }
+    free(offsets);
+
+    int *perm = r->perm;
+    r->perm   = r->order;
+    r->order  = perm;
+    r->current = dst;
+    *pts = sorted;
+
+    r->reorders++;
+    r->time += omp_get_wtime() - start;
+    return 0;
+}
+
+// Devolve os rótulos dos pontos reordenados (pts) a labels, na ordem original
+void reorder_restore(Reorder *r, const Points *pts, label_t *labels) {
+    if (r->current < 0) return;
+
+    const label_t *from = pts->labels;
+    if (from == labels) {
+        memcpy(r->labels, labels, (size_t)pts->n * sizeof(label_t));
+        from = r->labels;
+    }
+
+    const int *perm = r->perm;
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < pts->n; i++) labels[perm[i]] = from[i];
+}
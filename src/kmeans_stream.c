@@ -0,0 +1,166 @@
+#include <stdlib.h>
+#include <math.h>
+#include <omp.h>
+
+#include "kmeans.h"
+
+// Gerador dos pontos sintéticos. Cada número vem do Philox4x32-10 (Salmon et al.,
+// 2011), um gerador baseado em contador: quatro palavras de 32 bits por (contador,
+// chave), sem estado entre chamadas. O contador é a posição do ponto no fluxo e o
+// grupo de 4 dimensões, e a chave é a semente, então um ponto sai igual em qualquer
+// passada, com qualquer número de threads e de processos MPI, e cada thread gera os
+// seus pontos de forma independente (o laço sobre os pontos é vetorizável).
+
+#define ALWAYS_INLINE inline __attribute__((always_inline))
+
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u
+#define PHILOX_W1 0xBB67AE85u
+
+// Chave de cada uso dos números (a semente vai na outra metade)
+enum { KEY_COORDS, KEY_BLOB, KEY_CENTERS, KEY_SAMPLE };
+#define BLOB_GROUP 0xFFFFFFFFu    // Grupo do contador usado no sorteio do blob de um ponto
+#define TWO_PI     6.283185307179586
+
+// Quatro palavras de 32 bits. Passadas por valor, e não por ponteiro, para que
+// dentro de um laço omp simd o contador fique em registradores
+typedef struct {
+    uint32_t w[4];
+} Philox4;
+
+// Philox4x32-10: 10 rodadas sobre o contador c com a chave (k0, k1)
+static ALWAYS_INLINE Philox4 philox(Philox4 c, uint32_t k0, uint32_t k1) {
+    for (int r = 0; r < 10; r++) {
+        uint64_t p0 = (uint64_t)PHILOX_M0 * c.w[0];
+        uint64_t p1 = (uint64_t)PHILOX_M1 * c.w[2];
+        Philox4 next = { { (uint32_t)(p1 >> 32) ^ c.w[1] ^ k0, (uint32_t)p1,
+                           (uint32_t)(p0 >> 32) ^ c.w[3] ^ k1, (uint32_t)p0 } };
+        c   = next;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+    return c;
+}
+
+// Quatro números do item (ponto ou centróide) id, no grupo group
+static ALWAYS_INLINE Philox4 stream_bits(unsigned int seed, uint32_t key, long long id, uint32_t group) {
+    Philox4 c = { { (uint32_t)id, (uint32_t)((unsigned long long)id >> 32), group, 0 } };
+    return philox(c, seed, key);
+}
+
+// Palavra de 32 bits para um uniforme em (0, 1). A conversão passa por int32_t (o
+// SSE2 e o AVX2 não convertem inteiros sem sinal em double), sem mudar o valor
+static ALWAYS_INLINE double uniform(uint32_t x) {
+    return ((double)(int32_t)(x ^ 0x80000000u) + 2147483648.5) * (1.0 / 4294967296.0);
+}
+
+// Uniforme em (0, 1) do item id na sequência sequence, para sorteios que precisam
+// dar o mesmo resultado com qualquer número de threads (amostras da pipeline
+// grossa-para-fina)
+double sample_uniform(unsigned int seed, unsigned int sequence, long long id) {
+    return uniform(stream_bits(seed, KEY_SAMPLE, id, sequence).w[0]);
+}
+
+int stream_init(PointStream *s, unsigned int seed, long long n, int d, int blobs, double spread, double imbalance) {
+    s->seed      = seed;
+    s->n         = n;
+    s->d         = d;
+    s->blobs     = blobs;
+    s->spread    = spread;
+    s->imbalance = imbalance;
+    s->centers   = NULL;
+    s->cum       = NULL;
+    if (blobs == 0) return 0;
+
+    s->centers = malloc((size_t)blobs * d * sizeof(double));
+    s->cum     = malloc((size_t)blobs * sizeof(double));
+    if (s->centers == NULL || s->cum == NULL) {
+        stream_free(s);
+        return -1;
+    }
+
+    // Centros uniformes em [0, 100] e frações acumuladas dos blobs
+    for (int j = 0; j < blobs; j++) {
+        for (int g = 0; g < d; g += 4) {
+            Philox4 r = stream_bits(seed, KEY_CENTERS, j, (uint32_t)(g / 4));
+            for (int q = 0; q < 4 && g + q < d; q++) s->centers[(size_t)j * d + g + q] = uniform(r.w[q]) * 100.0;
+        }
+    }
+    double total = 0.0;
+    for (int j = 0; j < blobs; j++) {
+        total    += pow(j + 1.0, -imbalance);
+        s->cum[j] = total;
+    }
+    for (int j = 0; j < blobs; j++) s->cum[j] /= total;
+    s->cum[blobs - 1] = 1.0;
+    return 0;
+}
+
+void stream_free(PointStream *s) {
+    free(s->centers);
+    free(s->cum);
+    s->centers = NULL;
+    s->cum     = NULL;
+}
+
+// Blob do ponto id: o primeiro com fração acumulada acima de um uniforme
+static int pick_blob(const PointStream *s, long long id) {
+    double u = uniform(stream_bits(s->seed, KEY_BLOB, id, BLOB_GROUP).w[0]);
+    int lo = 0, hi = s->blobs - 1;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (u < s->cum[mid]) hi = mid;
+        else lo = mid + 1;
+    }
+    return lo;
+}
+
+// Gera os pontos [first, first + batch->n) do fluxo, STREAM_CHUNK por vez em cada
+// thread, quatro colunas por vez. Sem rótulos (labels == NULL), só gera as
+// coordenadas
+void stream_fill(const PointStream *s, long long first, Points *batch) {
+    int num_chunks = (batch->n + STREAM_CHUNK - 1) / STREAM_CHUNK;
+    int D = batch->d;
+
+    #pragma omp parallel for schedule(static)
+    for (int ch = 0; ch < num_chunks; ch++) {
+        int begin = ch * STREAM_CHUNK;
+        int end   = (begin + STREAM_CHUNK < batch->n) ? begin + STREAM_CHUNK : batch->n;
+        int    count = end - begin;
+        int    blob[STREAM_CHUNK];
+        double spare[STREAM_CHUNK];   // Destino das dimensões além de D no último grupo
+        for (int l = 0; s->blobs > 0 && l < count; l++) blob[l] = pick_blob(s, first + begin + l);
+
+        for (int g = 0; g < D; g += 4) {
+            double *col[4];
+            for (int q = 0; q < 4; q++) col[q] = (g + q < D) ? point_col(batch, g + q) + begin : spare;
+
+            if (s->blobs == 0) {
+                // Uniforme: o laço sobre os pontos vetoriza
+                #pragma omp simd
+                for (int l = 0; l < count; l++) {
+                    Philox4 r = stream_bits(s->seed, KEY_COORDS, first + begin + l, (uint32_t)(g / 4));
+                    col[0][l] = uniform(r.w[0]) * 100.0;
+                    col[1][l] = uniform(r.w[1]) * 100.0;
+                    col[2][l] = uniform(r.w[2]) * 100.0;
+                    col[3][l] = uniform(r.w[3]) * 100.0;
+                }
+                continue;
+            }
+
+            // Blobs (Box-Muller: dois pares de uniformes viram quatro normais)
+            for (int l = 0; l < count; l++) {
+                Philox4 r = stream_bits(s->seed, KEY_COORDS, first + begin + l, (uint32_t)(g / 4));
+                const double *center = s->centers + (size_t)blob[l] * D + g;
+                for (int q = 0; q < 4; q += 2) {
+                    double rad   = sqrt(-2.0 * log(uniform(r.w[q])));
+                    double angle = TWO_PI * uniform(r.w[q + 1]);
+                    col[q][l]     = (g + q < D ? center[q] : 0.0) + s->spread * rad * cos(angle);
+                    col[q + 1][l] = (g + q + 1 < D ? center[q + 1] : 0.0) + s->spread * rad * sin(angle);
+                }
+            }
+        }
+        for (int i = begin; batch->labels != NULL && i < end; i++) batch->labels[i] = NO_LABEL;
+    }
+}
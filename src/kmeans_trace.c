@@ -0,0 +1,200 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <omp.h>
+
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "kmeans.h"
+
+// Trace por iteração (make TRACE=1, compilado com KMEANS_TRACE). Sem KMEANS_TRACE as
+// macros TRACE_* de kmeans.h não geram código e nada daqui é chamado. Cada iteração
+// de um fit vira uma linha CSV no arquivo KMEANS_TRACE (padrão kmeans_trace.csv; na
+// versão MPI, um arquivo por processo, com o processo no fim do nome) com:
+// - os pontos que mudaram de cluster;
+// - o tempo de cada fase, medido pela thread mestre entre marcas (TRACE_MARK):
+//   atribuição, acumulação das somas (só na engine twopass; nas outras ela é feita
+//   na passada de atribuição), redução das parciais (incluindo a soma entre
+//   processos MPI), atualização dos centróides e reordenação dos pontos por
+//   cluster (só nas iterações em que ela acontece);
+// - o tempo ocupado de cada thread até a barreira que fecha a passada sobre os
+//   pontos (TRACE_BUSY), e o desequilíbrio (maior / média). A kd-tree distribui o
+//   trabalho em tarefas e não registra esse tempo;
+// - ciclos, instruções e faltas na cache de último nível das threads do time, via
+//   perf_event_open, quando o kernel permite (colunas vazias caso contrário). A
+//   banda é estimada como faltas x 64 bytes / tempo da iteração.
+
+#define LINE_BYTES 64
+
+enum { CNT_CYCLES, CNT_INSTRUCTIONS, CNT_LLC_MISSES, NUM_COUNTERS };
+
+static FILE   *trace_file   = NULL;
+static int     runs         = 0;
+static const char *engine_name;
+static int     num_threads;
+static int     iteration;
+static double  iter_start;
+static double  mark;
+static double  phase[TRACE_PHASES];
+static double *busy         = NULL;
+static int    *fds          = NULL;  // num_threads x NUM_COUNTERS (-1 = indisponível)
+static int     perf_ok      = 0;
+static long long last_count[NUM_COUNTERS];
+
+#ifdef __linux__
+static int open_counter(unsigned long long config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size           = sizeof(attr);
+    attr.type           = PERF_TYPE_HARDWARE;
+    attr.config         = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+// Soma dos contadores c de todas as threads
+static long long read_counter(int c) {
+    long long total = 0;
+    for (int t = 0; t < num_threads; t++) {
+        long long value;
+        int fd = fds[t * NUM_COUNTERS + c];
+        if (fd >= 0 && read(fd, &value, sizeof(value)) == (ssize_t)sizeof(value)) total += value;
+    }
+    return total;
+}
+
+// Abre o arquivo (na primeira execução) e os contadores de cada thread do time
+void trace_run_begin(const char *engine, int threads) {
+    if (trace_file == NULL) {
+        const char *path = getenv("KMEANS_TRACE");
+        char name[4096];
+        if (path == NULL || path[0] == '\0') path = "kmeans_trace.csv";
+        if (mpi_world_size() > 1) {
+            snprintf(name, sizeof(name), "%s.%d", path, mpi_rank());
+            path = name;
+        }
+        trace_file = fopen(path, "w");
+        if (trace_file == NULL) {
+            perror(path);
+            return;
+        }
+        fprintf(trace_file, "run,engine,threads,iter,changed,assign_s,accumulate_s,merge_s,update_s,reorder_s,iter_s,"
+                            "busy_min_s,busy_max_s,imbalance,cycles,instructions,llc_misses,llc_bytes_per_s,"
+                            "thread_busy_s\n");
+    }
+
+    runs++;
+    engine_name = engine;
+    num_threads = threads;
+    iteration   = 0;
+    busy = calloc((size_t)threads, sizeof(double));
+    fds  = malloc((size_t)threads * NUM_COUNTERS * sizeof(int));
+    if (busy == NULL || fds == NULL) {
+        trace_run_end();
+        return;
+    }
+    for (int i = 0; i < threads * NUM_COUNTERS; i++) fds[i] = -1;
+
+    // Cada thread abre os próprios contadores (perf_event_open mede a thread que chama)
+#ifdef __linux__
+    static const unsigned long long events[NUM_COUNTERS] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES
+    };
+    int opened = 0;
+    #pragma omp parallel num_threads(threads) reduction(+:opened)
+    {
+      int t = omp_get_thread_num();
+      for (int c = 0; c < NUM_COUNTERS; c++) {
+          fds[t * NUM_COUNTERS + c] = open_counter(events[c]);
+          opened += (fds[t * NUM_COUNTERS + c] >= 0);
+      }
+    }
+    perf_ok = (opened == threads * NUM_COUNTERS);
+    if (!perf_ok && runs == 1) {
+        fprintf(stderr, "Aviso: contadores de hardware indisponíveis (perf_event_open), "
+                        "colunas vazias no trace.\n");
+    }
+#endif
+    for (int c = 0; c < NUM_COUNTERS; c++) last_count[c] = perf_ok ? read_counter(c) : 0;
+}
+
+void trace_run_end(void) {
+    if (fds != NULL) {
+        for (int i = 0; i < num_threads * NUM_COUNTERS; i++) {
+            if (fds[i] >= 0) close(fds[i]);
+        }
+    }
+    free(fds);
+    free(busy);
+    fds  = NULL;
+    busy = NULL;
+    if (trace_file != NULL) fflush(trace_file);
+}
+
+void trace_iter_begin(void) {
+    if (busy == NULL) return;
+    memset(phase, 0, sizeof(phase));
+    memset(busy, 0, (size_t)num_threads * sizeof(double));
+    iter_start = mark = omp_get_wtime();
+}
+
+// Fecha a fase atual: o tempo desde a última marca vai para phase[p]. Só a thread
+// mestre chama (TRACE_MARK)
+void trace_mark(int p) {
+    double now = omp_get_wtime();
+    phase[p] += now - mark;
+    mark = now;
+}
+
+// Tempo da thread atual desde a última marca, somado ao seu tempo ocupado
+void trace_busy(void) {
+    if (busy == NULL) return;
+    busy[omp_get_thread_num()] += omp_get_wtime() - mark;
+}
+
+void trace_iter_end(int changed) {
+    if (trace_file == NULL || busy == NULL) return;
+    double elapsed = omp_get_wtime() - iter_start;
+    iteration++;
+
+    fprintf(trace_file, "%d,%s,%d,%d,%d,%.9f,%.9f,%.9f,%.9f,%.9f,%.9f,", runs, engine_name, num_threads,
+            iteration, changed, phase[TRACE_ASSIGN], phase[TRACE_ACCUMULATE], phase[TRACE_MERGE],
+            phase[TRACE_UPDATE], phase[TRACE_REORDER], elapsed);
+
+    double lo = busy[0], hi = busy[0], mean = 0.0;
+    for (int t = 0; t < num_threads; t++) {
+        lo = dmin(lo, busy[t]);
+        hi = dmax(hi, busy[t]);
+        mean += busy[t];
+    }
+    mean /= num_threads;
+    if (hi > 0.0) fprintf(trace_file, "%.9f,%.9f,%.4f,", lo, hi, hi / mean);
+    else fprintf(trace_file, ",,,");
+
+    if (perf_ok) {
+        long long delta[NUM_COUNTERS];
+        for (int c = 0; c < NUM_COUNTERS; c++) {
+            long long now = read_counter(c);
+            delta[c] = now - last_count[c];
+            last_count[c] = now;
+        }
+        fprintf(trace_file, "%lld,%lld,%lld,%.4e,", delta[CNT_CYCLES], delta[CNT_INSTRUCTIONS],
+                delta[CNT_LLC_MISSES], (double)delta[CNT_LLC_MISSES] * LINE_BYTES / elapsed);
+    } else {
+        fprintf(trace_file, ",,,,");
+    }
+
+    for (int t = 0; hi > 0.0 && t < num_threads; t++) {
+        fprintf(trace_file, "%s%.9f", t ? " " : "", busy[t]);
+    }
+    fprintf(trace_file, "\n");
+}
@@ -0,0 +1,356 @@
+#include <stdlib.h>
+#include <math.h>
+#include <omp.h>
+
+#include "kmeans.h"
+
+// Engine Yinyang (Ding et al., 2015): os centróides são agrupados uma única vez em
+// G grupos, e cada ponto guarda um limitante superior da distância ao seu centróide
+// e um limitante inferior por grupo. A filtragem é feita em dois níveis: o filtro
+// global/de grupo descarta grupos inteiros pelo limitante do grupo, e o filtro local
+// descarta centróides de um grupo examinado pelo deslocamento de cada centróide.
+// Usa N*G limitantes (em vez dos N*K do Elkan), e o custo por iteração cresce bem
+// abaixo de K quando os centróides se movem pouco.
+//
+// O artigo sugere G = K/10. Em 2D, porém, ler e corrigir os G limitantes de cada ponto
+// custa mais que as distâncias poupadas, então G cresce com sqrt(K): cada ponto paga
+// O(G) pelos limitantes e O(K/G) por grupo examinado.
+//
+// O filtro local só é usado com D >= YY_LOCAL_D. Com D menor uma distância custa pouco,
+// e o desvio do teste por centróide (mal predito quando metade dos membros é pulada)
+// custa mais que ela: com K = 256 e pontos uniformes, D = 64 fica 45% mais lento com o
+// filtro e D = 128 empata, enquanto D = 192 e D = 512 ficam 2x e 6x mais rápidos (com
+// K = 1024, D = 128 fica 2,2x mais rápido).
+
+#define YY_BLOCK       1024 // Pontos por bloco no schedule(dynamic)
+#define YY_MAX_GROUPS  64   // Limita a memória dos limitantes a N*64 doubles
+#define YY_GROUP_ITERS 5    // Iterações do k-means que agrupa os centróides
+#define YY_LOCAL_D     128  // D a partir do qual o filtro local é usado
+
+typedef struct {
+    int       k;            // Número de centróides
+    int       g;            // Número de grupos
+    int       first;        // Primeira iteração: agrupa os centróides e inicializa os limitantes
+    double    tol;          // Folga absoluta usada nas comparações entre limitantes
+    double   *upper;        // Limitante superior da distância ao centróide atual (por ponto)
+    double   *lower;        // Limitante inferior por grupo (n*G), exclui o centróide atual
+    int      *group_of;     // Grupo de cada centróide
+    int      *group_start;  // Início de cada grupo em members (G+1 posições)
+    int      *members;      // Centróides ordenados por grupo
+    Centroids prev;         // Centróides da iteração anterior
+    double   *drift;        // Deslocamento de cada centróide desde a iteração anterior
+    double   *group_drift;  // Maior deslocamento dentro de cada grupo
+    Centroids sorted;       // Cópia dos centróides na ordem de members (acesso contíguo)
+    double   *sorted_drift; // Deslocamentos na ordem de members
+} YinyangState;
+
+// Mesmo critério de poda das engines Hamerly/Elkan: só poda com separação estrita
+static inline int separated(const YinyangState *st, double u, double l) {
+    return u + st->tol < l;
+}
+
+void yinyang_destroy(void *state) {
+    YinyangState *st = state;
+    if (st == NULL) return;
+    free(st->upper);
+    free(st->lower);
+    free(st->group_of);
+    free(st->group_start);
+    free(st->members);
+    free_centroids(&st->prev);
+    free(st->drift);
+    free(st->group_drift);
+    free_centroids(&st->sorted);
+    free(st->sorted_drift);
+    free(st);
+}
+
+void *yinyang_create(const Points *pts, int k) {
+    YinyangState *st = calloc(1, sizeof(YinyangState));
+    if (st == NULL) return NULL;
+
+    int g = (int)ceil(sqrt((double)k) / 2.0);
+    if (g > YY_MAX_GROUPS) g = YY_MAX_GROUPS;
+
+    st->k           = k;
+    st->g           = g;
+    st->first       = 1;
+    st->tol         = bound_tolerance(pts);
+    st->upper       = alloc_aligned((size_t)pts->n * sizeof(double));
+    st->lower       = alloc_aligned((size_t)pts->n * g * sizeof(double));
+    st->group_of    = malloc((size_t)k * sizeof(int));
+    st->group_start = malloc((size_t)(g + 1) * sizeof(int));
+    st->members     = malloc((size_t)k * sizeof(int));
+    st->drift       = malloc((size_t)k * sizeof(double));
+    st->group_drift = malloc((size_t)g * sizeof(double));
+    st->sorted_drift = malloc((size_t)k * sizeof(double));
+    if (alloc_centroids(&st->prev, k, pts->d) != 0 || alloc_centroids(&st->sorted, k, pts->d) != 0 ||
+        st->upper == NULL || st->lower == NULL || st->group_of == NULL ||
+        st->group_start == NULL || st->members == NULL || st->drift == NULL ||
+        st->group_drift == NULL || st->sorted_drift == NULL) {
+        yinyang_destroy(st);
+        return NULL;
+    }
+    return st;
+}
+
+// Agrupa os centróides iniciais com algumas iterações de k-means (sequencial, O(K*G)
+// por iteração) e monta a lista de membros de cada grupo. Os grupos não mudam depois
+static int group_centroids(YinyangState *st, const Centroids *c) {
+    int k = st->k, g = st->g, d = c->d;
+    Centroids gc;
+    Sums gs;
+    if (alloc_centroids(&gc, g, d) != 0) return -1;
+    if (alloc_sums(&gs, g, d) != 0) {
+        free_centroids(&gc);
+        return -1;
+    }
+
+    // Centros iniciais: centróides igualmente espaçados
+    for (int t = 0; t < g; t++) {
+        int j = (int)((long)t * k / g);
+        for (int e = 0; e < d; e++) centroid(&gc, t)[e] = centroid(c, j)[e];
+    }
+
+    for (int it = 0; it < YY_GROUP_ITERS; it++) {
+        clear_sums(&gs);
+        for (int j = 0; j < k; j++) {
+            int best = 0;
+            double bestDist = INFINITY;
+            for (int t = 0; t < g; t++) {
+                double d2 = distance_sq(centroid(c, j), centroid(&gc, t), d);
+                if (d2 < bestDist) {
+                    bestDist = d2;
+                    best = t;
+                }
+            }
+            st->group_of[j] = best;
+            accumulate(&gs, best, centroid(c, j));
+        }
+        update_centroids(&gc, &gs);
+    }
+
+    // Lista de membros por grupo (counting sort dos centróides pelo grupo)
+    for (int t = 0; t <= g; t++) st->group_start[t] = 0;
+    for (int j = 0; j < k; j++) st->group_start[st->group_of[j] + 1]++;
+    for (int t = 0; t < g; t++) st->group_start[t + 1] += st->group_start[t];
+    int *fill = gs.count; // Reaproveita as contagens como cursor de preenchimento
+    for (int t = 0; t < g; t++) fill[t] = st->group_start[t];
+    for (int j = 0; j < k; j++) st->members[fill[st->group_of[j]]++] = j;
+
+    free_centroids(&gc);
+    free_sums(&gs);
+    return 0;
+}
+
+// Deslocamento de cada centróide e maior deslocamento de cada grupo. Também copia
+// os centróides e deslocamentos na ordem dos grupos, para o filtro local percorrer
+// os membros de um grupo sem acesso indireto
+static void update_drift(YinyangState *st, const Centroids *c) {
+    for (int t = 0; t < st->g; t++) st->group_drift[t] = 0.0;
+    for (int j = 0; j < st->k; j++) {
+        double d = st->first ? 0.0 : sqrt(distance_sq(centroid(c, j), centroid(&st->prev, j), c->d));
+        st->drift[j] = d;
+        if (d > st->group_drift[st->group_of[j]]) st->group_drift[st->group_of[j]] = d;
+    }
+    for (int p = 0; p < st->k; p++) {
+        int j = st->members[p];
+        for (int e = 0; e < c->d; e++) centroid(&st->sorted, p)[e] = centroid(c, j)[e];
+        st->sorted_drift[p] = st->drift[j];
+    }
+    copy_centroids(&st->prev, c);
+}
+
+// Varre todos os membros do grupo t, exceto o centróide a (que já tem a distância
+// exata), e devolve a menor e a segunda menor distância ao quadrado e o centróide
+// da menor. Usada com D < YY_LOCAL_D, onde calcular a distância custa menos que testar
+// o filtro local de cada centróide e errar a predição do desvio, então o laço não tem
+// desvios e os membros são lidos na ordem dos grupos (sorted)
+static inline void scan_group(const YinyangState *st, const double *pt, int t, int a,
+                              double *first2, double *second2, int *argfirst) {
+    const Centroids *sc = &st->sorted;
+    double f = INFINITY, s = INFINITY;
+    int    arg = -1;
+    for (int p = st->group_start[t]; p < st->group_start[t + 1]; p++) {
+        int    j  = st->members[p];
+        double d2 = distance_sq(pt, centroid(sc, p), sc->d);
+        d2 = (j == a) ? INFINITY : d2;
+        // Membros em ordem crescente de índice: "<" estrito mantém o menor índice no empate
+        int lt = d2 < f;
+        s   = lt ? f  : dmin(s, d2);
+        arg = lt ? j  : arg;
+        f   = lt ? d2 : f;
+    }
+    *first2   = f;
+    *second2  = s;
+    *argfirst = arg;
+}
+
+// Como scan_group, com o filtro local: o limitante do grupo antes da correção (old_lb)
+// menos o deslocamento do membro p limita a distância a ele, e o membro é pulado se
+// esse limitante supera bound (a melhor distância até aqui). *skipped recebe o menor
+// limitante dos membros pulados, que entra no novo limitante do grupo
+static inline void scan_group_local(const YinyangState *st, const double *pt, int t, int a, double old_lb,
+                                    double bound, double *first2, double *second2, int *argfirst,
+                                    double *skipped) {
+    const Centroids *sc = &st->sorted;
+    double f = INFINITY, s = INFINITY, skip = INFINITY;
+    int    arg = -1;
+    for (int p = st->group_start[t]; p < st->group_start[t + 1]; p++) {
+        int j = st->members[p];
+        if (j == a) continue;
+        double lp = old_lb - st->sorted_drift[p];
+        if (separated(st, bound, lp)) {
+            skip = dmin(skip, lp);
+            continue;
+        }
+        double d2 = distance_sq(pt, centroid(sc, p), sc->d);
+        if (d2 < f) {
+            s   = f;
+            f   = d2;
+            arg = j;
+        } else {
+            s = dmin(s, d2);
+        }
+    }
+    *first2   = f;
+    *second2  = s;
+    *argfirst = arg;
+    *skipped  = skip;
+}
+
+// Primeira iteração: varredura completa, inicializa o limitante de cada grupo com a
+// menor distância aos seus membros (excluindo o centróide escolhido)
+static int yinyang_init_point(YinyangState *st, const double *pt, int i) {
+    double *lb = st->lower + (size_t)i * st->g;
+    double best2 = INFINITY, best_second2 = INFINITY;
+    int best = -1, best_group = 0;
+
+    for (int t = 0; t < st->g; t++) {
+        double first2, second2;
+        int argfirst;
+        scan_group(st, pt, t, -1, &first2, &second2, &argfirst);
+        if (first2 < best2 || (first2 == best2 && argfirst < best)) {
+            best         = argfirst;
+            best2        = first2;
+            best_second2 = second2;
+            best_group   = t;
+        }
+        lb[t] = sqrt(first2);
+    }
+    lb[best_group] = sqrt(best_second2);
+
+    st->upper[i] = sqrt(best2);
+    return best;
+}
+
+static int yinyang_point(YinyangState *st, const double *pt, int a, const Centroids *c, int i) {
+    if (st->first) return yinyang_init_point(st, pt, i);
+
+    int     g  = st->g;
+    double *lb = st->lower + (size_t)i * g;
+
+    // Corrige os limitantes pelo deslocamento dos centróides
+    double u = st->upper[i] + st->drift[a];
+    double glb = INFINITY;
+    for (int t = 0; t < g; t++) {
+        lb[t] -= st->group_drift[t];
+        glb = dmin(glb, lb[t]);
+    }
+
+    // Filtro global
+    if (separated(st, u, glb)) {
+        st->upper[i] = u;
+        return a;
+    }
+    double u2 = distance_sq(pt, centroid(c, a), c->d);
+    u = sqrt(u2);
+    if (separated(st, u, glb)) {
+        st->upper[i] = u;
+        return a;
+    }
+
+    // Filtro de grupo: só examina os grupos cujo limitante não supera a melhor
+    // distância até aqui. O melhor candidato é o menor par (distância ao quadrado,
+    // índice), o mesmo desempate do laço de força bruta
+    int    best     = a;
+    double best2    = u2;
+    double bestDist = u;
+    double best_lb  = 0.0; // Novo limitante do grupo do melhor candidato, excluindo-o
+
+    int local = c->d >= YY_LOCAL_D;
+    for (int t = 0; t < g; t++) {
+        if (separated(st, bestDist, lb[t])) continue;
+
+        double first2, second2, skipped = INFINITY;
+        int argfirst;
+        if (local) {
+            scan_group_local(st, pt, t, a, lb[t] + st->group_drift[t], bestDist, &first2, &second2, &argfirst,
+                             &skipped);
+        } else {
+            scan_group(st, pt, t, a, &first2, &second2, &argfirst);
+        }
+        if (first2 < best2 || (first2 == best2 && argfirst < best)) {
+            best     = argfirst;
+            best2    = first2;
+            bestDist = sqrt(first2);
+            best_lb  = dmin(sqrt(second2), skipped);
+        }
+        lb[t] = dmin(sqrt(first2), skipped);
+    }
+
+    if (best != a) {
+        // O novo centróide sai do limitante do seu grupo e o antigo entra no dele
+        lb[st->group_of[best]] = best_lb;
+        int ga = st->group_of[a];
+        lb[ga] = dmin(lb[ga], u);
+    }
+
+    st->upper[i] = bestDist;
+    return best;
+}
+
+int iterate_yinyang(void *state, Points *pts, const Centroids *c, assign_kernel_fn kernel, Sums *sums) {
+    YinyangState *st = state;
+    (void)kernel;
+    int num_points = pts->n;
+    int num_blocks = (num_points + YY_BLOCK - 1) / YY_BLOCK;
+    int changed    = 0;
+
+    Sums *locals = thread_sums(sums);
+    if (locals == NULL) return -1;
+
+    if (st->first && group_centroids(st, c) != 0) return -1;
+    update_drift(st, c);
+
+    #pragma omp parallel reduction(+:changed)
+    {
+      Sums *local = &locals[omp_get_thread_num()];
+      double pt[pts->d];
+
+      #pragma omp for schedule(dynamic) nowait
+      for (int b = 0; b < num_blocks; b++) {
+        int begin = b * YY_BLOCK;
+        int end   = (begin + YY_BLOCK < num_points) ? begin + YY_BLOCK : num_points;
+
+        for (int i = begin; i < end; i++) {
+            load_point(pts, i, pt);
+            int a = pts->labels[i];
+            int best = yinyang_point(st, pt, a, c, i);
+
+            changed += (a != best);
+            pts->labels[i] = (label_t)best;
+            accumulate(local, best, pt);
+        }
+      }
+
+      TRACE_BUSY();
+      #pragma omp barrier
+      TRACE_MARK(TRACE_ASSIGN);
+      reduce_thread_sums(sums);
+    }
+    TRACE_MARK(TRACE_MERGE);
+
+    st->first = 0;
+    return changed;
+}
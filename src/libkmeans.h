@@ -0,0 +1,124 @@
+#ifndef LIBKMEANS_H
+#define LIBKMEANS_H
+
+// API pública da libkmeans (make lib): o k-means da v3 como biblioteca. Um contexto
+// guarda os centróides treinados e os buffers reaproveitados entre chamadas
+// (rótulos, cópia compacta dos pontos, parciais por thread), então rotular novos lotes não
+// aloca memória. Com a reordenação por cluster, o fit trabalha sobre uma cópia dos
+// pontos ordenada pelo rótulo, mas os rótulos voltam na ordem do chamador.
+//
+// Os pontos são passados em colunas (layout SoA): a coordenada c do ponto i está em
+// coords[c * stride + i], com stride >= n. As coordenadas não são copiadas (exceto
+// para a cópia compacta de KMEANS_PREC_F32 e KMEANS_PREC_Q16) e precisam continuar
+// válidas durante a chamada. Um contexto não deve ser usado por duas threads ao mesmo tempo;
+// contextos diferentes podem, e cada chamada deixa o número de threads do OpenMP como estava.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define KMEANS_PREC_F64 0           // Laço principal em double
+#define KMEANS_PREC_F32 1           // Pontos em float32, somas em double (engines twopass e fused)
+#define KMEANS_PREC_Q16 2           // Pontos quantizados em 16 bits por dimensão, somas em double (idem)
+#define KMEANS_DEFAULT_MAX_ITER 150 // Limite padrão de iterações do fit
+#define KMEANS_COARSE_NONE 0        // Fit sobre todos os pontos desde a inicialização
+#define KMEANS_COARSE_UNIFORM 1     // Pipeline grossa-para-fina com amostras uniformes
+#define KMEANS_COARSE_IMPORTANCE 2  // Idem, com amostras por importância (coreset leve)
+#define KMEANS_DEFAULT_FINAL_ITER 10 // Limite padrão de iterações sobre todos os pontos após a pipeline
+
+typedef struct KMeansContext KMeansContext;
+
+// Configuração de um contexto. kmeans_config_init preenche os valores padrão
+typedef struct {
+    int          k;           // Número de centróides (1 a 65534)
+    int          d;           // Dimensões (1 a 4096)
+    const char  *engine;      // twopass, fused, hamerly, elkan, yinyang, kdtree ou gemm
+    const char  *init;        // random ou kmpar (k-means||)
+    int          precision;   // KMEANS_PREC_F64, KMEANS_PREC_F32 ou KMEANS_PREC_Q16
+    int          max_iter;    // Limite de iterações do fit
+    int          num_threads; // Threads OpenMP de cada chamada (0 = omp_get_max_threads())
+    unsigned int seed;        // Semente da inicialização
+    int          reorder;     // Reordena os pontos por cluster a cada reorder iterações do fit
+                              // (0 = nunca; engines twopass e fused)
+    int          n_init;      // Reinícios do fit, com sementes seed, seed + 1, ...; fica o de menor
+                              // inércia (1 a 256; > 1 só nas engines twopass e fused, sem reorder)
+    int          coarse;      // Pipeline grossa-para-fina: KMEANS_COARSE_NONE, _UNIFORM ou
+                              // _IMPORTANCE (não combina com n_init > 1)
+    int          final_iter;  // Limite de iterações sobre todos os pontos depois da pipeline
+    int          incremental; // 1 = o fit também monta o estado de kmeans_update (somas por
+                              // cluster e folga de cada ponto; uma passada a mais sobre os pontos)
+} KMeansConfig;
+
+// Resultado de um fit
+typedef struct {
+    int    iterations; // Iterações até convergir (ou max_iter)
+    double time;       // Tempo do laço principal (seg)
+    double setup;      // Tempo de preparação da engine (ex.: construção da kd-tree)
+    double init;       // Tempo da inicialização dos centróides
+    double inertia;    // Soma das distâncias ao quadrado de cada ponto ao seu centróide
+    int    reorders;     // Reordenações dos pontos por cluster (KMeansConfig.reorder)
+    double reorder_time; // Tempo total das reordenações (incluído em time)
+    double skipped;      // Fração dos blocos de pontos que não calcularam distâncias
+    int    best_restart;  // Reinício escolhido (semente seed + best_restart; 0 se n_init == 1)
+    double worst_inertia; // Maior inércia entre os reinícios
+    long long restart_iterations; // Iterações somadas de todos os reinícios
+    int    coarse_levels;     // Amostras da pipeline grossa-para-fina (0 se não rodou)
+    int    coarse_iterations; // Iterações somadas sobre as amostras
+    long long coarse_points;  // Tamanho da maior amostra
+    double coarse_time;       // Tempo da pipeline (sem a inicialização, que fica em init)
+    long long update_candidates; // kmeans_update: pontos reavaliados com distâncias, somados nos passos
+    double state_time;           // Tempo de montagem do estado incremental (fit) ou da remontagem (update)
+} KMeansStats;
+
+void           kmeans_config_init(KMeansConfig *cfg, int k, int d);
+KMeansContext *kmeans_create(const KMeansConfig *cfg);
+void           kmeans_destroy(KMeansContext *ctx);
+
+// Treina do zero sobre n pontos: inicializa os centróides e itera até nenhum ponto
+// mudar de cluster (ou max_iter). Com n_init > 1, os reinícios avançam juntos (cada
+// bloco de pontos é lido uma vez por iteração para todos), os que convergem saem do
+// laço e o contexto fica com os centróides e rótulos do de menor inércia; iterations
+// e inertia são os dele. Com coarse, a inicialização e as primeiras iterações rodam
+// sobre amostras de tamanho crescente (a maior a um fator 8 de n), e o fit termina
+// com até final_iter iterações sobre todos os pontos; iterations conta só essas.
+// Retorna o número de iterações, ou -1 em erro
+int kmeans_fit(KMeansContext *ctx, const double *coords, int n, size_t stride, KMeansStats *stats);
+
+// Atualização incremental depois de um fit com incremental = 1 (ou de um modelo salvo
+// com o estado): coords tem nas posições [0, n0) os mesmos n0 pontos da chamada
+// anterior e em [n0, n) os pontos novos; removed lista os índices (< n0) dos pontos
+// que saíram, que continuam no vetor mas deixam de contar (rótulo 0xFFFF). Os pontos
+// novos e removidos entram direto nas somas por cluster, e os passos seguintes só
+// calculam distâncias para os pontos cuja folga não prova mais o cluster, então o
+// custo acompanha o tamanho da mudança, não n. Um ponto alterado é uma remoção mais
+// uma adição. stats->inertia fica -1 (custaria uma passada por todos os pontos).
+// Retorna o número de passos, ou -1 em erro
+int kmeans_update(KMeansContext *ctx, const double *coords, int n, size_t stride, const int *removed,
+                  int num_removed, KMeansStats *stats);
+
+// Atualiza os centróides com um lote (mini-batch, taxa 1 / pontos já vistos por
+// centróide). O primeiro lote de um contexto sem treino também escolhe os
+// centróides iniciais. Retorna 0, ou -1 em erro
+int kmeans_partial_fit(KMeansContext *ctx, const double *coords, int n, size_t stride);
+
+// Rotula n pontos com o centróide mais próximo (em double, com o kernel SIMD do
+// contexto). labels só é escrito, então pode vir sem inicializar. Não aloca memória.
+// Retorna 0, ou -1 se o contexto não foi treinado
+int kmeans_predict(const KMeansContext *ctx, const double *coords, int n, size_t stride, uint16_t *labels);
+
+// Soma das distâncias ao quadrado de cada ponto ao centróide do seu rótulo
+double kmeans_inertia(const KMeansContext *ctx, const double *coords, int n, size_t stride,
+                      const uint16_t *labels);
+
+// Centróides treinados (k linhas de d coordenadas) e rótulos do último fit ou lote
+const double   *kmeans_centroids(const KMeansContext *ctx);
+const uint16_t *kmeans_labels(const KMeansContext *ctx);
+
+// Modelo em arquivo binário: cabeçalho de 64 bytes, centróides (float64) e pontos
+// vistos por centróide (para continuar com partial_fit) e, se houver, o estado
+// incremental (somas, rótulos e folgas, para continuar com kmeans_update). Em kmeans_load, k e d vêm
+// do arquivo; os demais campos de cfg (ou os padrões, se cfg == NULL) configuram o
+// contexto. Retornam 0 / o contexto, ou -1 / NULL em erro
+int            kmeans_save(const KMeansContext *ctx, const char *path);
+KMeansContext *kmeans_load(const char *path, const KMeansConfig *cfg);
+
+#endif
@@ -40,8 +40,9 @@ int main(int argc, char *argv[]) {
 
     Centroid centroids[K];
 
-    // Inicializa semente base para rand_r
-    unsigned int seed_base = (unsigned int)time(NULL);
+    // Inicializa semente base para rand_r (fixa com KMEANS_SEED, para repetir a execução)
+    const char *seed_env = getenv("KMEANS_SEED");
+    unsigned int seed_base = seed_env ? (unsigned int)strtoul(seed_env, NULL, 10) : (unsigned int)time(NULL);
 
     // Cada thread terá sua própria semente, derivada da semente base
     #pragma omp parallel
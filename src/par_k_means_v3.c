@@ -1,197 +1,948 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include <time.h>
+#include <limits.h>
+#include <unistd.h>
 #include <omp.h>
 
+#include "kmeans.h"
+#include "libkmeans.h"
+
 #define DEFAULT_NUM_POINTS 10000000 // Número total de pontos
-#define K 50                        // Número de centróides
-#define MAX_ITER 150                // Número máximo de iterações
+#define SWEEP_NUM_POINTS (DEFAULT_NUM_POINTS / 10) // Pontos na varredura de K (modo 3)
+#define STREAM_NUM_POINTS (10LL * DEFAULT_NUM_POINTS) // Pontos no fluxo do modo mini-batch (modo 4)
+#define MINIBATCH_SIZE (16 * STREAM_CHUNK)           // Pontos por lote no modo mini-batch
+#define DEFAULT_REORDER 5                            // Período da reordenação no modo 7 (sem -r)
+#define DEFAULT_RESTARTS 8                           // Reinícios no modo 8 (sem -R)
+#define DEFAULT_SPREAD 2.0                           // Desvio de cada blob dos pontos gerados (sem -s)
+#define UPDATE_ROUNDS 4                              // Rodadas de atualização incremental (modo 10)
+#define UPDATE_PERCENT 1                             // Pontos novos por rodada, em % de N (modo 10)
 
-// Estrutura que representa um ponto 2D e o cluster ao qual pertence
+// Resultado de uma execução do k-means
 typedef struct {
-    double x, y;
-    int cluster;
-} Point;
+    double time;       // Tempo do laço principal (seg)
+    double setup;      // Tempo de preparação da engine (ex.: construção da kd-tree)
+    double init;       // Tempo da inicialização dos centróides
+    double startup;    // Tempo até a primeira iteração (carga ou geração dos pontos incluída)
+    double inertia;    // Soma das distâncias ao quadrado de cada ponto ao seu centróide, ao final
+    int    iterations; // Iterações até convergir (ou max_iter)
+    int    reorders;     // Reordenações dos pontos por cluster
+    double reorder_time; // Tempo das reordenações (incluído em time)
+    double skipped;      // Fração dos blocos que não calcularam distâncias
+    int    best_restart;  // Reinício de menor inércia (n_init > 1)
+    double worst_inertia; // Maior inércia entre os reinícios
+    long long restart_iterations; // Iterações somadas de todos os reinícios
+    int    coarse_levels;     // Amostras da pipeline grossa-para-fina
+    int    coarse_iterations; // Iterações somadas sobre as amostras
+    long long coarse_points;  // Tamanho da maior amostra
+    double coarse_time;       // Tempo da pipeline (sem a inicialização)
+} RunResult;
 
-// Estrutura que representa um centróide em 2D
-typedef struct {
-    double x, y;
-} Centroid;
+// Engine e inicialização escolhidas em main() (padrão: duas passadas e k-means||).
+// As tabelas ficam na libkmeans (kmeans_lib.c)
+static const Engine      *engine      = &engines[0];
+static const Initializer *initializer = &initializers[1];
+
+// Dimensões dos pontos gerados, limite de iterações, precisão do laço principal,
+// período da reordenação por cluster (0 = sem reordenação) e reinícios avançados
+// juntos em cada execução, definidos em main()
+static int dims      = DEFAULT_D;
+static int max_iter  = KMEANS_DEFAULT_MAX_ITER;
+static int precision = PREC_F64;
+static int reorder   = 0;
+static int n_init    = 1;
+
+// Pipeline grossa-para-fina (-a): amostras uniformes ou por importância antes de até
+// final_iter iterações sobre todos os pontos
+static int coarse     = COARSE_NONE;
+static int final_iter = KMEANS_DEFAULT_FINAL_ITER;
+
+// Distribuição dos pontos gerados (ver PointStream): uniforme em [0, 100] com
+// blobs == 0, ou blobs gaussianos com desvio spread e desequilíbrio imbalance
+static int    blobs     = 0;
+static double spread    = DEFAULT_SPREAD;
+static double imbalance = 0.0;
+
+// Modo NUMA (-N): threads fixadas por nó, pontos alocados no nó da thread que os
+// processa e redução das somas em dois níveis (ver kmeans_numa.c)
+static int numa_mode = 0;
+
+// Semente base dos pontos gerados e da inicialização, sorteada uma vez em main() ou
+// fixada por KMEANS_SEED: execuções com a mesma semente, N e D usam o mesmo
+// conjunto de pontos, com qualquer número de threads e de processos
+static unsigned int seed_base;
+
+// Deslocamento da semente da inicialização (os pontos continuam os de seed_base): o
+// modo 8 roda cada reinício sozinho com a semente que ele tem no conjunto
+static unsigned int seed_shift = 0;
 
-// Função para calcular a distância euclidiana ao quadrado
-double distance_sq(Point p, Centroid c) {
-    double dx = p.x - c.x;
-    double dy = p.y - c.y;
-    return dx * dx + dy * dy;
+// Conjunto de pontos lido de arquivo (KMEANS_DATA), ou NULL para gerar os pontos.
+// load_start marca o início da carga, para medir o tempo até a primeira iteração
+static Dataset *dataset = NULL;
+static double   load_start;
+static Dataset  data;
+static const char *data_path;
+static int      use_mmap;
+
+// Carrega (ou recarrega, quando muda o número de processos MPI) a parte deste
+// processo do dataset
+static int load_dataset(void) {
+    if (dataset != NULL) dataset_close(dataset);
+    dataset = NULL;
+    load_start = omp_get_wtime();
+    if (dataset_open_part(&data, data_path, use_mmap, mpi_rank(), mpi_ranks()) != 0) return -1;
+    dataset = &data;
+    return 0;
 }
 
-static double run(int num_points, int num_threads) {
-    // Define número de threads via OpenMP
+// Executa o k-means com a engine, a inicialização e a precisão dadas, por meio de
+// um contexto da libkmeans. Se out != NULL (já alocado com k centróides), recebe os
+// centróides finais
+static RunResult run(const Engine *eng, const Initializer *ini, int prec, int num_points, int k,
+                     int num_threads, Centroids *out) {
+    RunResult result = { -1.0, 0.0, 0.0, 0.0, 0.0, 0, 0, 0.0, 0.0, 0, 0.0, 0, 0, 0, 0, 0.0 };
+
+    double entry_time = (dataset != NULL) ? load_start : omp_get_wtime();
+
+    // Define número de threads via OpenMP (e, no modo NUMA, fixa cada uma em uma CPU)
     omp_set_num_threads(num_threads);
+    if (numa_mode && numa_setup(num_threads) != 0) {
+        fprintf(stderr, "Erro ao preparar o modo NUMA.\n");
+        mpi_fail();
+        return result;
+    }
 
-    // Aloca o vetor de pontos
-    Point *points = malloc(num_points * sizeof(Point));
-    if (points == NULL) {
-        fprintf(stderr, "Erro ao alocar memória para os pontos.\n");
-        return 1;
+    // Pontos em colunas (SoA). Com um dataset, as coordenadas são as dele (sem
+    // cópia). Na versão MPI, cada processo fica só com a sua parte dos num_points
+    // pontos (a mesma divisão de dataset_open_part)
+    Points pts;
+    if (dataset != NULL) {
+        pts = dataset->pts;
+    } else {
+        int first, last;
+        block_share((num_points + ASSIGN_BLOCK - 1) / ASSIGN_BLOCK, mpi_rank(), mpi_ranks(), &first, &last);
+        pts.n        = ((last * ASSIGN_BLOCK < num_points) ? last * ASSIGN_BLOCK : num_points) - first * ASSIGN_BLOCK;
+        pts.d        = dims;
+        pts.stride   = points_stride(pts.n);
+        pts.coords32 = NULL;
+        pts.labels   = NULL;
+        pts.coords   = alloc_aligned(pts.stride * pts.d * sizeof(double));
+        if (pts.coords == NULL) {
+            fprintf(stderr, "Erro ao alocar memória para os pontos.\n");
+            mpi_fail();
+            return result;
+        }
+        numa_bind_points(&pts);
+
+        // Pontos gerados como o fluxo do modo mini-batch: cada ponto vem da semente e
+        // da sua posição, então o conjunto é o mesmo com qualquer número de threads e
+        // de processos. Cada thread gera os blocos que vai processar nas iterações (a
+        // divisão estática de stream_fill é a de thread_blocks), então as páginas
+        // ficam no seu nó NUMA
+        PointStream stream;
+        if (stream_init(&stream, seed_base, num_points, dims, blobs, spread, imbalance) != 0) {
+            fprintf(stderr, "Erro ao alocar memória para os centros dos blobs.\n");
+            free(pts.coords);
+            mpi_fail();
+            return result;
+        }
+        stream_fill(&stream, (long long)first * ASSIGN_BLOCK, &pts);
+        stream_free(&stream);
     }
 
-    // Cria o vetor de centróides
-    Centroid centroids[K];
+    // Contexto com a engine, a inicialização e a precisão pedidas
+    KMeansConfig cfg;
+    kmeans_config_init(&cfg, k, pts.d);
+    cfg.engine      = eng->name;
+    cfg.init        = ini->name;
+    cfg.precision   = prec;
+    cfg.max_iter    = max_iter;
+    cfg.num_threads = num_threads;
+    cfg.seed        = seed_base + seed_shift;
+    cfg.reorder     = reorder;
+    cfg.n_init      = n_init;
+    cfg.coarse      = coarse;
+    cfg.final_iter  = final_iter;
 
-    // Inicializa semente base para rand_r
-    unsigned int seed_base = (unsigned int)time(NULL);
+    KMeansStats stats;
+    double fit_time = omp_get_wtime();
+    KMeansContext *ctx = kmeans_create(&cfg);
+    if (ctx == NULL) {
+        fprintf(stderr, "Erro ao criar o contexto do k-means.\n");
+        mpi_fail();
+    } else if (kmeans_fit(ctx, pts.coords, pts.n, pts.stride, &stats) >= 0) {
+        result.time       = stats.time;
+        result.setup      = stats.setup;
+        result.init       = stats.init;
+        result.startup    = mpi_max(fit_time - entry_time) + stats.init + stats.coarse_time + stats.setup;
+        result.inertia    = stats.inertia;
+        result.iterations = stats.iterations;
+        result.reorders     = stats.reorders;
+        result.reorder_time = stats.reorder_time;
+        result.skipped      = stats.skipped;
+        result.best_restart       = stats.best_restart;
+        result.worst_inertia      = stats.worst_inertia;
+        result.restart_iterations = stats.restart_iterations;
+        result.coarse_levels      = stats.coarse_levels;
+        result.coarse_iterations  = stats.coarse_iterations;
+        result.coarse_points      = stats.coarse_points;
+        result.coarse_time        = stats.coarse_time;
+        if (out != NULL) memcpy(out->pos, kmeans_centroids(ctx), (size_t)k * pts.d * sizeof(double));
+    }
 
-    // Inicializa variáveis de controle
-    int iterations    = 0;
-    int changed       = 1;
-    double start_time, end_time;
+    kmeans_destroy(ctx);
+    if (dataset == NULL) free(pts.coords);
+    return result;
+}
 
-    // Cada thread terá sua própria semente, derivada da semente base
-    #pragma omp parallel
-    {
-        unsigned int seed = seed_base + omp_get_thread_num();
+// Lotes do modo mini-batch: gerados a partir do fluxo ou, com KMEANS_DATA, lidos
+// do arquivo pela thread de E/S do ChunkReader enquanto o lote anterior é processado
+typedef struct {
+    PointStream  stream;
+    Points       batch;      // Lote gerado (sem reader)
+    ChunkReader *reader;
+    long long    num_points;
+    long long    next;       // Primeiro ponto do próximo lote gerado
+} BatchSource;
 
-        // Paraleliza a geração aleatória dos pontos no intervalo [0, 100] para x e y
-        // Considera a seed local de cada thread para isso
-        #pragma omp for
-        for (int i = 0; i < num_points; i++) {
+// Começa uma passada sobre os lotes. Retorna 0, ou -1 se a thread de E/S não subir
+static int batch_begin(BatchSource *src) {
+    src->next = 0;
+    return (src->reader != NULL) ? chunks_start(src->reader) : 0;
+}
 
-            points[i].x = rand_r(&seed) / (double)RAND_MAX * 100.0;
-            points[i].y = rand_r(&seed) / (double)RAND_MAX * 100.0;
-            points[i].cluster = -1;
-        }
+// Próximo lote da passada: 1 e o lote em *batch, 0 no fim, -1 em erro de leitura
+static int batch_next(BatchSource *src, Points **batch) {
+    if (src->reader != NULL) {
+        long long first;
+        return chunks_next(src->reader, batch, &first);
+    }
+    if (src->next >= src->num_points) return 0;
+    src->batch.n = (src->num_points - src->next < MINIBATCH_SIZE) ? (int)(src->num_points - src->next)
+                                                                  : MINIBATCH_SIZE;
+    stream_fill(&src->stream, src->next, &src->batch);
+    src->next += src->batch.n;
+    *batch = &src->batch;
+    return 1;
+}
 
-        // Inicializa os centróides escolhendo aleatoriamente pontos gerados
-        // Garante que apenas uma thread execute essa parte
-        // Isso *parece* ser válido, já que o número de centróides é pequeno e ocorre apenas uma vez
-        #pragma omp single
-        {
-            unsigned int cent_seed = seed_base; // Semente base para esse laço
-            for (int i = 0; i < K; i++) {
-                int index = rand_r(&cent_seed) % num_points;
-                centroids[i].x = points[index].x;
-                centroids[i].y = points[index].y;
-            }
+// Tempo da thread de E/S na passada que terminou e quanto dele o cálculo esperou
+static void print_io(BatchSource *src) {
+    if (src->reader == NULL) return;
+    double io_time, wait_time;
+    chunks_times(src->reader, &io_time, &wait_time);
+    printf("Leitura: %.4f seg na thread de E/S, Espera por lotes: %.4f seg, E/S sobreposta: %.1f%%\n",
+           io_time, wait_time, io_time > 0.0 ? 100.0 * dmax(0.0, io_time - wait_time) / io_time : 100.0);
+}
+
+// Modo mini-batch: percorre uma vez os pontos em lotes de MINIBATCH_SIZE: o fluxo
+// gerado de num_points pontos ou, com reader, o arquivo. Cada lote é atribuído
+// (engine fused) e aplicado aos centróides; só os lotes atuais ficam na memória.
+// Opcionalmente faz ao final uma passada completa de rotulação, que calcula a
+// inércia e o tamanho dos clusters (os rótulos não são guardados, já que não cabem
+// na memória)
+static void run_minibatch(long long num_points, int k, int num_threads, int label_pass, ChunkReader *reader) {
+    omp_set_num_threads(num_threads);
+    BatchSource src;
+    src.reader     = reader;
+    src.num_points = (reader != NULL) ? chunks_points(reader) : num_points;
+    int batch_size = (reader != NULL) ? chunks_size(reader)
+                   : (src.num_points < MINIBATCH_SIZE) ? (int)src.num_points : MINIBATCH_SIZE;
+    printf("\n--- Mini-batch (N=%lld, K=%d, D=%d, lote=%d, threads=%d%s) ---\n",
+           src.num_points, k, dims, batch_size, num_threads, (reader != NULL) ? ", pontos do dataset" : "");
+
+    if (k > batch_size) {
+        fprintf(stderr, "K deve ser no máximo o tamanho do lote (%d).\n", batch_size);
+        return;
+    }
+
+    // O lote gerado (com os rótulos da rotulação final) e o contexto que acumula
+    // os lotes, com a engine fused em double
+    KMeansConfig cfg;
+    kmeans_config_init(&cfg, k, dims);
+    cfg.engine      = "fused";
+    cfg.init        = initializer->name;
+    cfg.num_threads = num_threads;
+    cfg.seed        = seed_base;
+    KMeansContext *ctx = kmeans_create(&cfg);
+    int stream_ok = reader != NULL ||
+                    stream_init(&src.stream, seed_base, src.num_points, dims, blobs, spread, imbalance) == 0;
+    int batch_ok  = reader != NULL || alloc_points(&src.batch, batch_size, dims) == 0;
+    if (!batch_ok || ctx == NULL || !stream_ok) {
+        fprintf(stderr, "Erro ao alocar memória para o mini-batch.\n");
+        kmeans_destroy(ctx);
+        if (reader == NULL && batch_ok) free_points(&src.batch);
+        if (reader == NULL && stream_ok) stream_free(&src.stream);
+        return;
+    }
+
+    Points *batch;
+    double start_time = omp_get_wtime();
+    int steps = 0, rc = batch_begin(&src);
+    while (rc == 0 && (rc = batch_next(&src, &batch)) > 0) {
+        // O primeiro lote também escolhe os centróides iniciais
+        if (kmeans_partial_fit(ctx, batch->coords, batch->n, batch->stride) != 0) {
+            fprintf(stderr, "Erro ao alocar memória no lote %d.\n", steps);
+            break;
         }
+        steps++;
+        rc = 0;
     }
+    double elapsed = omp_get_wtime() - start_time;
+    if (rc < 0) fprintf(stderr, "Erro ao ler o lote %d do dataset.\n", steps);
+    printf("Lotes: %d, Tempo: %.4f seg, Vazão: %.3e pontos/seg\n",
+           steps, elapsed, src.num_points / elapsed);
+    print_io(&src);
 
-    // Busca o tempo de início da execução
-    start_time = omp_get_wtime();
-
-    // Loop principal do algoritmo k-means
-    while (changed && iterations < MAX_ITER) {
-        changed = 0;
-        
-        // Paraleliza a atribuição de pontos ao centróide mais próximo
-        #pragma omp parallel for schedule(static) reduction(max:changed)
-        for (int i = 0; i < num_points; i++) {
-            double minDist = distance_sq(points[i], centroids[0]);
-            int bestCluster = 0;
-
-            // Sinaliza o uso de SIMD para essa parte, otimizando o loop no compilador
-            #pragma omp simd
-            for (int j = 1; j < K; j++) {
-                double d2 = distance_sq(points[i], centroids[j]);
-                if (d2 < minDist) {
-                    minDist = d2;
-                    bestCluster = j;
-                }
-            }
+    if (label_pass && rc == 0) {
+        double inertia = 0.0;
+        int empty = 0, largest = 0;
+        long long *sizes = calloc((size_t)k, sizeof(long long)); // Tamanho final de cada cluster
+        if (sizes == NULL) {
+            fprintf(stderr, "Erro ao alocar memória para a rotulação final.\n");
+            rc = -1;
+        }
 
-            if (points[i].cluster != bestCluster) {
-                points[i].cluster = bestCluster;
-                changed = 1;
-            }
+        start_time = omp_get_wtime();
+        rc = (rc == 0) ? batch_begin(&src) : rc;
+        while (rc == 0 && (rc = batch_next(&src, &batch)) > 0) {
+            kmeans_predict(ctx, batch->coords, batch->n, batch->stride, batch->labels);
+            inertia += kmeans_inertia(ctx, batch->coords, batch->n, batch->stride, batch->labels);
+            for (int i = 0; i < batch->n; i++) sizes[batch->labels[i]]++;
+            rc = 0;
         }
-        
-        // Atualização dos centróides
-        double sumX[K] = {0};
-        double sumY[K] = {0};
-        int count[K]   = {0};
-
-        // Paraleliza a soma dos pontos por centróide
-        // Cada thread calcula a soma localmente e depois atualiza a soma global
-        #pragma omp parallel
-        {
-          double localSumX[K]  = {0};
-          double localSumY[K]  = {0};
-          int    localCount[K] = {0};
-        
-          #pragma omp for
-          for (int i = 0; i < num_points; i++) {
-            int cl = points[i].cluster;
-            localSumX[cl] += points[i].x;
-            localSumY[cl] += points[i].y;
-            localCount[cl]++;
-          }
-        
-          #pragma omp critical
-          for (int j = 0; j < K; j++) {
-            sumX[j]  += localSumX[j];
-            sumY[j]  += localSumY[j];
-            count[j] += localCount[j];
-          }
-        }
-        
-        // Pode-se paralelizar a atualização dos centróides
-        // Porém, pouco ganho de desempenho (são poucos centróides e operações simples)
-        // O custo de sincronização pode ser maior que o ganho
-        // #pragma omp parallel for
-        for (int j = 0; j < K; j++) {
-            if (count[j] != 0) {
-                centroids[j].x = sumX[j] / count[j];
-                centroids[j].y = sumY[j] / count[j];
+        elapsed = omp_get_wtime() - start_time;
+
+        if (rc == 0) {
+            for (int j = 0; j < k; j++) {
+                if (sizes[j] == 0) empty++;
+                if (sizes[j] > sizes[largest]) largest = j;
             }
+            printf("Rotulação final: Tempo: %.4f seg, Vazão: %.3e pontos/seg, Inércia: %.6e, "
+                   "Clusters vazios: %d, Maior cluster: %lld pontos\n",
+                   elapsed, src.num_points / elapsed, inertia, empty, sizes[largest]);
+            print_io(&src);
+        } else if (sizes != NULL) {
+            fprintf(stderr, "Erro ao ler os lotes do dataset na rotulação final.\n");
         }
-        
-        iterations++;
+        free(sizes);
     }
 
-    end_time = omp_get_wtime();
-    free(points);
-    return end_time - start_time;
+    kmeans_destroy(ctx);
+    if (reader == NULL) {
+        free_points(&src.batch);
+        stream_free(&src.stream);
+    }
 }
 
-// Teste de escalabilidade forte: problema fixo, varia threads
-static void test_strong(int base_points) {
-    printf("\n--- Teste de Escalabilidade Forte (N=%d) ---\n", base_points);
+// Próximo número de processos MPI nos testes de escalabilidade: dobra a cada
+// passo, terminando exatamente no total do mpirun
+static int next_ranks(int ranks) {
+    int total = mpi_world_size();
+    return (ranks < total && ranks * 2 > total) ? total : ranks * 2;
+}
 
-    // Loop para aumentar o número de threads
+// Teste de escalabilidade forte: problema fixo, varia processos (versão MPI) e threads
+static void test_strong(int base_points, int k) {
+    printf("\n--- Teste de Escalabilidade Forte (N=%d, K=%d, D=%d, engine=%s) ---\n",
+           base_points, k, (dataset != NULL) ? dataset->pts.d : dims, engine->name);
+
+    // Loop para aumentar o número de processos e, em cada um, o de threads. Os
+    // processos que ficam de fora de um passo só esperam o próximo; com um dataset,
+    // os que participam recarregam a sua parte
     int max_threads = omp_get_max_threads();
-    for (int t = 1; t <= max_threads; t *= 2) {
-        double t_exec = run(base_points, t);
-        printf("Threads: %2d, Tempo: %.4f seg\n", t, t_exec);
+    for (int p = 1; p <= mpi_world_size(); p = next_ranks(p)) {
+        int active = mpi_use_ranks(p);
+        if (active && dataset != NULL && mpi_world_size() > 1 && load_dataset() != 0) {
+            mpi_fail();
+            return;
+        }
+        for (int t = 1; active && t <= max_threads; t *= 2) {
+            RunResult r = run(engine, initializer, precision, base_points, k, t, NULL);
+            printf("Processos: %d, Threads: %2d, Iterações: %3d, Tempo: %.4f seg, Por iteração: %.6f seg, "
+                   "Preparação: %.4f seg, Inicialização: %.4f seg\n", p, t, r.iterations, r.time,
+                   r.time / (r.iterations > 0 ? r.iterations : 1), r.setup, r.init);
+        }
     }
+    mpi_use_ranks(mpi_world_size());
 }
 
-// Teste de escalabilidade fraca: aumenta N proporcional a threads
-static void test_weak(int base_points) {
-    printf("\n--- Teste de Escalabilidade Fraca (inicial N=%d) ---\n", base_points);
+// Teste de escalabilidade fraca: aumenta N proporcional a processos x threads
+static void test_weak(int base_points, int k) {
+    printf("\n--- Teste de Escalabilidade Fraca (inicial N=%d, K=%d, D=%d, engine=%s) ---\n",
+           base_points, k, dims, engine->name);
 
-    // Loop para aumentar o número de pontos proporcionalmente ao número de threads
+    // Loop para aumentar o número de pontos proporcionalmente ao número de processos
+    // e de threads
     int max_threads = omp_get_max_threads();
-    for (int t = 1; t <= max_threads; t *= 2) {
-        int n_pts = base_points * t;
-        double t_exec = run(n_pts, t);
-        printf("Threads: %2d, N=%d, Tempo: %.4f seg\n", t, n_pts, t_exec);
+    for (int p = 1; p <= mpi_world_size(); p = next_ranks(p)) {
+        int active = mpi_use_ranks(p);
+        for (int t = 1; active && t <= max_threads; t *= 2) {
+            int n_pts = base_points * t * p;
+            RunResult r = run(engine, initializer, precision, n_pts, k, t, NULL);
+            printf("Processos: %d, Threads: %2d, N=%d, Iterações: %3d, Tempo: %.4f seg, Por iteração: %.6f seg, "
+                   "Preparação: %.4f seg, Inicialização: %.4f seg\n", p, t, n_pts, r.iterations, r.time,
+                   r.time / (r.iterations > 0 ? r.iterations : 1), r.setup, r.init);
+        }
     }
+    mpi_use_ranks(mpi_world_size());
 }
 
-int main(int argc, char *argv[]) {
-    int num_threads = (argc > 1) ? atoi(argv[1]) : omp_get_max_threads();
+// Varredura de K: compara a engine fused (kernel SIMD de força bruta, O(N*K) por
+// iteração) com a engine Yinyang no mesmo conjunto de pontos. As duas produzem os
+// mesmos rótulos, então o número de iterações é o mesmo e o tempo por iteração é
+// diretamente comparável
+static void test_k_sweep(int base_points, int num_threads) {
+    printf("\n--- Varredura de K (N=%d, D=%d, threads=%d): fused x yinyang ---\n", base_points, dims, num_threads);
+
+    const Engine *plain   = find_engine("fused");
+    const Engine *yinyang = find_engine("yinyang");
+    for (int k = 16; k <= 4096; k *= 4) {
+        RunResult rp = run(plain,   initializer, PREC_F64, base_points, k, num_threads, NULL);
+        RunResult ry = run(yinyang, initializer, PREC_F64, base_points, k, num_threads, NULL);
+        double tp = rp.time / (rp.iterations > 0 ? rp.iterations : 1);
+        double ty = ry.time / (ry.iterations > 0 ? ry.iterations : 1);
+        printf("K=%5d, Iterações: %3d, fused: %.4f seg (%.5f seg/it), yinyang: %.4f seg (%.5f seg/it), Speedup: %.2fx\n",
+               k, rp.iterations, rp.time, tp, ry.time, ty, rp.time / ry.time);
+    }
+}
+
+// Comparação das inicializações: mesma engine e mesmos pontos, cada inicialização
+// em uma execução. Mostra o número de iterações até convergir, o tempo da
+// inicialização, o do laço principal, o total e a inércia final
+static void test_init(int base_points, int k, int num_threads) {
+    printf("\n--- Comparação das inicializações (N=%d, K=%d, D=%d, engine=%s, threads=%d) ---\n",
+           base_points, k, dims, engine->name, num_threads);
+
+    for (int i = 0; i < num_initializers; i++) {
+        RunResult r = run(engine, &initializers[i], precision, base_points, k, num_threads, NULL);
+        printf("%-7s Iterações: %3d, Inicialização: %.4f seg, Laço: %.4f seg, Total: %.4f seg, Inércia: %.6e\n",
+               initializers[i].name, r.iterations, r.init, r.time, r.init + r.time, r.inertia);
+    }
+}
+
+// Comparação de precisão: a mesma execução (engine, inicialização e pontos) em
+// double, em float32 e com os pontos quantizados em 16 bits. Para cada precisão
+// reduzida mostra o speedup do laço principal, o maior desvio (distância euclidiana)
+// entre um centróide final e o mesmo centróide em double e a diferença relativa da
+// inércia
+static void test_precision(int base_points, int k, int num_threads) {
+    printf("\n--- Comparação de precisão (N=%d, K=%d, D=%d, engine=%s, init=%s, threads=%d) ---\n",
+           base_points, k, dims, engine->name, initializer->name, num_threads);
+
+    static const int   precs[] = { PREC_F64, PREC_F32, PREC_Q16 };
+    static const char *names[] = { "double: ", "float32:", "q16:    " };
+    Centroids c[3];
+    RunResult r[3];
+    for (int p = 0; p < 3; p++) {
+        if (alloc_centroids(&c[p], k, dims) != 0) {
+            fprintf(stderr, "Erro ao alocar memória para os centróides.\n");
+            for (int q = 0; q < p; q++) free_centroids(&c[q]);
+            return;
+        }
+    }
+
+    for (int p = 0; p < 3; p++) {
+        r[p] = run(engine, initializer, precs[p], base_points, k, num_threads, &c[p]);
+        printf("%s Iterações: %3d, Tempo: %.4f seg (%.5f seg/it), Inércia: %.6e\n",
+               names[p], r[p].iterations, r[p].time, r[p].time / r[p].iterations, r[p].inertia);
+    }
+
+    for (int p = 1; p < 3 && r[0].time > 0.0; p++) {
+        if (r[p].time <= 0.0) continue;
+        double deviation = 0.0;
+        for (int j = 0; j < k; j++) {
+            deviation = dmax(deviation, sqrt(distance_sq(centroid(&c[0], j), centroid(&c[p], j), dims)));
+        }
+        printf("%s Speedup por iteração: %.2fx, Maior desvio de centróide: %.3e, Diferença de inércia: %+.3e\n",
+               names[p], (r[0].time / r[0].iterations) / (r[p].time / r[p].iterations), deviation,
+               (r[p].inertia - r[0].inertia) / r[0].inertia);
+    }
+
+    for (int p = 0; p < 3; p++) free_centroids(&c[p]);
+}
+
+// Comparação da reordenação por cluster: a mesma execução sem reordenação e com
+// reordenação a cada period iterações. Mostra o custo das reordenações, a fração
+// dos blocos que não calcularam distâncias e o ganho por iteração, sem e com o
+// custo das reordenações
+static void test_reorder(int base_points, int k, int num_threads, int period) {
+    printf("\n--- Comparação da reordenação por cluster (N=%d, K=%d, D=%d, engine=%s, período=%d, threads=%d) ---\n",
+           base_points, k, dims, engine->name, period, num_threads);
+
+    reorder = 0;
+    RunResult r0 = run(engine, initializer, precision, base_points, k, num_threads, NULL);
+    reorder = period;
+    RunResult r1 = run(engine, initializer, precision, base_points, k, num_threads, NULL);
+    printf("Sem reordenação: Iterações: %3d, Tempo: %.4f seg (%.5f seg/it), Inércia: %.6e\n",
+           r0.iterations, r0.time, r0.time / r0.iterations, r0.inertia);
+    printf("Com reordenação: Iterações: %3d, Tempo: %.4f seg (%.5f seg/it), Inércia: %.6e\n",
+           r1.iterations, r1.time, r1.time / r1.iterations, r1.inertia);
+
+    if (r0.time > 0.0 && r1.time > 0.0) {
+        double loop = (r1.time - r1.reorder_time) / r1.iterations;
+        printf("Reordenações: %d, Custo: %.4f seg (%.5f seg cada), Blocos pulados: %.1f%%\n",
+               r1.reorders, r1.reorder_time, r1.reorders ? r1.reorder_time / r1.reorders : 0.0,
+               100.0 * r1.skipped);
+        printf("Speedup por iteração: %.2fx sem o custo das reordenações, %.2fx com\n",
+               (r0.time / r0.iterations) / loop, (r0.time / r0.iterations) / (r1.time / r1.iterations));
+    }
+}
+
+// Comparação dos reinícios: cada um dos restarts reinícios rodado sozinho (semente
+// seed_base + r, uma passada pelos pontos por iteração de cada um) e os mesmos
+// reinícios avançando juntos (n_init = restarts, uma passada por iteração para
+// todos). Os dois caminhos devem escolher o mesmo reinício, com a mesma inércia
+static void test_restarts(int base_points, int k, int num_threads, int restarts) {
+    printf("\n--- Comparação dos reinícios (N=%d, K=%d, D=%d, engine=%s, init=%s, reinícios=%d, threads=%d) ---\n",
+           base_points, k, dims, engine->name, initializer->name, restarts, num_threads);
+
+    int best = 0, total_iterations = 0;
+    double total_time = 0.0, best_inertia = 0.0;
+    n_init = 1;
+    for (int r = 0; r < restarts; r++) {
+        seed_shift = (unsigned int)r;
+        RunResult rr = run(engine, initializer, precision, base_points, k, num_threads, NULL);
+        if (rr.time < 0.0) break;
+        printf("Reinício %3d: Iterações: %3d, Tempo: %.4f seg, Inércia: %.6e\n", r, rr.iterations, rr.time,
+               rr.inertia);
+        total_time       += rr.time;
+        total_iterations += rr.iterations;
+        if (r == 0 || rr.inertia < best_inertia) {
+            best         = r;
+            best_inertia = rr.inertia;
+        }
+    }
+    seed_shift = 0;
+
+    n_init = restarts;
+    RunResult rs = run(engine, initializer, precision, base_points, k, num_threads, NULL);
+    n_init = 1;
+    if (rs.time < 0.0 || total_time <= 0.0) return;
+
+    printf("Separados: Iterações somadas: %d, Tempo: %.4f seg, Melhor: reinício %d, Inércia: %.6e\n",
+           total_iterations, total_time, best, best_inertia);
+    printf("Juntos:    Iterações somadas: %lld (o melhor em %d), Tempo: %.4f seg, Melhor: reinício %d, "
+           "Inércia: %.6e (pior %.6e)\n", rs.restart_iterations, rs.iterations, rs.time, rs.best_restart,
+           rs.inertia, rs.worst_inertia);
+    printf("Speedup: %.2fx, Mesmo resultado: %s\n", total_time / rs.time,
+           (rs.best_restart == best && rs.inertia == best_inertia) ? "sim" : "não");
+}
+
+// Comparação da pipeline grossa-para-fina: a execução sobre todos os pontos desde a
+// inicialização e a mesma execução com amostras uniformes e por importância. Mostra
+// onde ficaram as iterações (amostras ou todos os pontos), o tempo total (preparação,
+// inicialização, amostras e laço) e a inércia final de cada uma em relação à primeira
+static void test_coarse(int base_points, int k, int num_threads) {
+    printf("\n--- Pipeline grossa-para-fina (N=%d, K=%d, D=%d, engine=%s, init=%s, iterações finais=%d, "
+           "threads=%d) ---\n", base_points, k, dims, engine->name, initializer->name, final_iter, num_threads);
+
+    static const int   modes[] = { COARSE_NONE, COARSE_UNIFORM, COARSE_IMPORTANCE };
+    static const char *names[] = { "todos:     ", "uniform:   ", "importance:" };
+    double base_total = 0.0, base_inertia = 0.0;
+    for (int m = 0; m < 3; m++) {
+        coarse = modes[m];
+        RunResult r = run(engine, initializer, precision, base_points, k, num_threads, NULL);
+        if (r.time < 0.0) break;
+        double total = r.setup + r.init + r.coarse_time + r.time;
+        printf("%s Níveis: %d, Maior amostra: %lld, Iterações nas amostras: %4d, Iterações em todos: %3d, "
+               "Inicialização: %.4f seg, Amostras: %.4f seg, Laço: %.4f seg, Total: %.4f seg, Inércia: %.6e\n",
+               names[m], r.coarse_levels, r.coarse_points, r.coarse_iterations, r.iterations, r.init,
+               r.coarse_time, r.time, total, r.inertia);
+        if (m == 0) {
+            base_total   = total;
+            base_inertia = r.inertia;
+        } else {
+            printf("%s Speedup do total: %.2fx, Diferença de inércia: %+.3e\n", names[m], base_total / total,
+                   (r.inertia - base_inertia) / base_inertia);
+        }
+    }
+    coarse = COARSE_NONE;
+}
+
+// Atualização incremental: o fit inicial cobre os primeiros pontos e cada uma das
+// UPDATE_ROUNDS rodadas acrescenta os UPDATE_PERCENT% seguintes (do mesmo fluxo ou do
+// dataset) e remove metade disso entre os antigos, com kmeans_update. No fim, um fit
+// do zero sobre os pontos ativos dá a referência de tempo e de inércia
+static void test_incremental(int base_points, int k, int num_threads) {
+    int delta   = (int)((long long)base_points * UPDATE_PERCENT / 100);
+    int first_n = base_points - UPDATE_ROUNDS * delta;
+    printf("\n--- Atualização incremental (N=%d, K=%d, D=%d, engine=%s, init=%s, rodadas=%d de +%d/-%d pontos, "
+           "threads=%d) ---\n", base_points, k, dims, engine->name, initializer->name, UPDATE_ROUNDS, delta,
+           delta / 2, num_threads);
+    if (delta < 2 || first_n < k) {
+        fprintf(stderr, "Poucos pontos para o modo 10 (N >= %d).\n", 200 / UPDATE_PERCENT);
+        return;
+    }
+
+    // Todos os pontos de uma vez; cada chamada enxerga só os primeiros n
+    omp_set_num_threads(num_threads);
+    Points pts;
+    if (dataset != NULL) {
+        pts = dataset->pts;
+    } else {
+        pts.n      = base_points;
+        pts.d      = dims;
+        pts.stride = points_stride(pts.n);
+        pts.labels = NULL;
+        pts.coords = alloc_aligned(pts.stride * pts.d * sizeof(double));
+        PointStream stream;
+        if (pts.coords == NULL || stream_init(&stream, seed_base, base_points, dims, blobs, spread, imbalance) != 0) {
+            fprintf(stderr, "Erro ao alocar memória para os pontos.\n");
+            free(pts.coords);
+            return;
+        }
+        numa_bind_points(&pts);
+        stream_fill(&stream, 0, &pts);
+        stream_free(&stream);
+    }
+
+    KMeansConfig cfg;
+    kmeans_config_init(&cfg, k, pts.d);
+    cfg.engine      = engine->name;
+    cfg.init        = initializer->name;
+    cfg.precision   = precision;
+    cfg.max_iter    = max_iter;
+    cfg.num_threads = num_threads;
+    cfg.seed        = seed_base;
+    cfg.reorder     = reorder;
+    cfg.n_init      = n_init;
+    cfg.coarse      = coarse;
+    cfg.final_iter  = final_iter;
+    cfg.incremental = 1;
+
+    KMeansStats stats;
+    int num_removed = delta / 2;
+    int *removed    = malloc((size_t)num_removed * sizeof(int));
+    KMeansContext *ctx = kmeans_create(&cfg);
+    if (removed == NULL || ctx == NULL || kmeans_fit(ctx, pts.coords, first_n, pts.stride, &stats) < 0) {
+        fprintf(stderr, "Erro no fit inicial.\n");
+        goto done;
+    }
+    printf("Fit inicial:  N=%d, Iterações: %3d, Tempo: %.4f seg (inicialização e laço), Montagem do estado: %.4f seg\n",
+           first_n, stats.iterations, stats.init + stats.setup + stats.coarse_time + stats.time, stats.state_time);
+
+    // Cada rodada remove pontos ativos espalhados entre os já cobertos (um a cada step
+    // ativos, então nenhum sai duas vezes) e acrescenta os seguintes
+    int n = first_n;
+    double update_total = 0.0;
+    for (int r = 0; r < UPDATE_ROUNDS; r++) {
+        const uint16_t *labels = kmeans_labels(ctx);
+        int live = 0;
+        for (int i = 0; i < n; i++) live += labels[i] != NO_LABEL;
+        int step = live / num_removed;
+        for (int i = 0, seen = 0, count = 0; count < num_removed; i++) {
+            if (labels[i] == NO_LABEL) continue;
+            if (seen++ % step == r % step) removed[count++] = i;
+        }
+        n += delta;
+        if (kmeans_update(ctx, pts.coords, n, pts.stride, removed, num_removed, &stats) < 0) {
+            fprintf(stderr, "Erro na atualização incremental.\n");
+            goto done;
+        }
+        update_total += stats.time;
+        printf("Rodada %d:     N=%d, Passos: %3d, Pontos reavaliados: %lld (%.2f%% de N por passo), "
+               "Remontagem: %.4f seg, Tempo: %.4f seg\n", r + 1, n, stats.iterations, stats.update_candidates,
+               stats.iterations > 0 ? 100.0 * stats.update_candidates / stats.iterations / n : 0.0,
+               stats.state_time, stats.time);
+    }
+
+    // Referência: fit do zero sobre uma cópia compacta dos pontos ativos
+    const uint16_t *labels = kmeans_labels(ctx);
+    int live = 0;
+    for (int i = 0; i < n; i++) live += labels[i] != NO_LABEL;
+    if (live != n - UPDATE_ROUNDS * num_removed) {
+        fprintf(stderr, "Pontos ativos: %d, esperados: %d.\n", live, n - UPDATE_ROUNDS * num_removed);
+        goto done;
+    }
+    size_t stride = points_stride(live);
+    double   *coords  = alloc_aligned(stride * pts.d * sizeof(double));
+    uint16_t *compact = malloc((size_t)live * sizeof(uint16_t));
+    if (coords == NULL || compact == NULL) {
+        fprintf(stderr, "Erro ao alocar memória para a cópia dos pontos ativos.\n");
+        free(coords);
+        free(compact);
+        goto done;
+    }
+    for (int i = 0, next = 0; i < n; i++) {
+        if (labels[i] == NO_LABEL) continue;
+        for (int c = 0; c < pts.d; c++) coords[(size_t)c * stride + next] = point_col(&pts, c)[i];
+        compact[next++] = labels[i];
+    }
+    double inertia = kmeans_inertia(ctx, coords, live, stride, compact);
+
+    cfg.incremental = 0;
+    KMeansContext *fresh = kmeans_create(&cfg);
+    if (fresh != NULL && kmeans_fit(fresh, coords, live, stride, &stats) >= 0) {
+        double total = stats.init + stats.setup + stats.coarse_time + stats.time;
+        printf("Fit do zero:  N=%d ativos, Iterações: %3d, Tempo: %.4f seg, Inércia: %.6e\n", live,
+               stats.iterations, total, stats.inertia);
+        printf("Incremental:  Tempo das %d rodadas: %.4f seg (%.1fx mais rápido por rodada), Inércia: %.6e, "
+               "Diferença de inércia: %+.3e\n", UPDATE_ROUNDS, update_total, total * UPDATE_ROUNDS / update_total,
+               inertia, (inertia - stats.inertia) / stats.inertia);
+    }
+    kmeans_destroy(fresh);
+    free(coords);
+    free(compact);
+
+done:
+    kmeans_destroy(ctx);
+    free(removed);
+    if (dataset == NULL) free(pts.coords);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Uso: %s [-t threads] [-m modo] [-e engine] [-c init] [-p f64|f32|q16] [-k K] [-d D] [-n N]\n"
+            "          [-i iterações] [-r período] [-R reinícios] [-b blobs] [-s desvio] [-u desequilíbrio]\n"
+            "          [-a uniform|importance] [-f iterações] [-l 0|1] [-N]\n"
+            "  -m  0=normal, 1=escalabilidade forte, 2=fraca, 3=varredura de K, 4=mini-batch,\n"
+            "      5=comparação das inicializações, 6=comparação de precisão (double, float32, q16),\n"
+            "      7=comparação da reordenação por cluster, 8=comparação dos reinícios,\n"
+            "      9=comparação da pipeline grossa-para-fina, 10=atualização incremental\n"
+            "  -c  inicialização dos centróides: random ou kmpar (k-means||, padrão)\n"
+            "  -p  precisão do laço principal (f32 e q16, pontos em 16 bits: engines twopass e\n"
+            "      fused, modos 0, 1, 2 e 5)\n"
+            "  -n  número de pontos (no modo 4, tamanho do fluxo; nos modos 1 e 2, N inicial)\n"
+            "  -r  reordena os pontos por cluster a cada período iterações (engines twopass e\n"
+            "      fused, fora dos modos 3 e 4; padrão 0 = nunca, %d no modo 7)\n"
+            "  -R  reinícios avançados juntos, fica o de menor inércia (engines twopass e fused,\n"
+            "      fora dos modos 3, 4 e 7 e sem -r; padrão 1, %d no modo 8)\n"
+            "  -b  pontos gerados em blobs gaussianos (padrão 0 = uniformes em [0, 100])\n"
+            "  -s  desvio padrão de cada blob, em cada dimensão (padrão %.1f)\n"
+            "  -u  desequilíbrio dos blobs: o blob j recebe pontos na proporção 1 / (j + 1)^u\n"
+            "      (padrão 0 = blobs do mesmo tamanho)\n"
+            "  -a  pipeline grossa-para-fina: inicialização e primeiras iterações sobre amostras\n"
+            "      uniformes ou por importância, de tamanho crescente (sem -R, fora dos modos 4 e 8)\n"
+            "  -f  iterações sobre todos os pontos depois da pipeline (padrão %d)\n"
+            "  -l  rotulação final do modo mini-batch (padrão 1)\n"
+            "  -N  modo NUMA: fixa as threads e aloca os pontos no nó de cada uma\n"
+            "Engines:", prog, DEFAULT_REORDER, DEFAULT_RESTARTS, DEFAULT_SPREAD, KMEANS_DEFAULT_FINAL_ITER);
+    for (int e = 0; e < num_engines; e++) fprintf(stderr, " %s", engines[e].name);
+    fprintf(stderr, "\n");
+}
+
+static int kmeans_main(int argc, char *argv[]) {
+    int num_threads = omp_get_max_threads();
+    int mode        = 0;          // 0=normal, 1=forte, 2=fraca, 3=varredura de K, 4=mini-batch, 5=inicializações, 6=precisão,
+                                  // 7=reordenação, 8=reinícios, 9=pipeline grossa-para-fina, 10=incremental
+    int k           = DEFAULT_K;  // Número de centróides
+    int label_pass  = 1;          // Rotulação final do modo mini-batch
+    long long num_points = 0;     // 0 = padrão do modo
+
+    int opt;
+    while ((opt = getopt(argc, argv, "t:m:e:c:p:k:d:n:i:r:R:b:s:u:a:f:l:Nh")) != -1) {
+        switch (opt) {
+        case 't': num_threads = atoi(optarg); break;
+        case 'm': mode        = atoi(optarg); break;
+        case 'k': k           = atoi(optarg); break;
+        case 'd': dims        = atoi(optarg); break;
+        case 'n': num_points  = atoll(optarg); break;
+        case 'i': max_iter    = atoi(optarg); break;
+        case 'r': reorder     = atoi(optarg); break;
+        case 'R': n_init      = atoi(optarg); break;
+        case 'b': blobs       = atoi(optarg); break;
+        case 's': spread      = atof(optarg); break;
+        case 'u': imbalance   = atof(optarg); break;
+        case 'f': final_iter  = atoi(optarg); break;
+        case 'l': label_pass  = atoi(optarg); break;
+        case 'N': numa_mode   = 1; break;
+        case 'e':
+            engine = find_engine(optarg);
+            if (engine == NULL) {
+                fprintf(stderr, "Engine desconhecida: %s.\n", optarg);
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'p':
+            if (strcmp(optarg, "f64") == 0) precision = PREC_F64;
+            else if (strcmp(optarg, "f32") == 0) precision = PREC_F32;
+            else if (strcmp(optarg, "q16") == 0) precision = PREC_Q16;
+            else {
+                fprintf(stderr, "Precisão desconhecida: %s.\n", optarg);
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'a':
+            if (strcmp(optarg, "uniform") == 0) coarse = COARSE_UNIFORM;
+            else if (strcmp(optarg, "importance") == 0) coarse = COARSE_IMPORTANCE;
+            else {
+                fprintf(stderr, "Amostragem desconhecida: %s.\n", optarg);
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'c':
+            initializer = find_initializer(optarg);
+            if (initializer == NULL) {
+                fprintf(stderr, "Inicialização desconhecida: %s.\n", optarg);
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (num_threads < 1 || k < 1 || k > MAX_K || dims < 1 || dims > MAX_D || max_iter < 1 || reorder < 0 ||
+        n_init < 1 || n_init > MAX_RESTARTS || final_iter < 1 || blobs < 0 || !(spread >= 0.0) || !(imbalance >= 0.0) ||
+        num_points < 0 || (mode != 4 && num_points > INT_MAX)) {
+        fprintf(stderr, "Parâmetro fora do intervalo (1 <= K <= %d, 1 <= D <= %d, 1 <= reinícios <= %d, "
+                "blobs, desvio e desequilíbrio >= 0, N <= %d fora do modo 4).\n", MAX_K, MAX_D, MAX_RESTARTS,
+                INT_MAX);
+        return 1;
+    }
+    if ((reorder > 0 || mode == 7) && (engine->create != NULL || mode == 3 || mode == 4)) {
+        fprintf(stderr, "A reordenação por cluster só roda nas engines twopass e fused, fora dos modos 3 e 4.\n");
+        return 1;
+    }
+    if ((n_init > 1 || mode == 8) &&
+        (engine->create != NULL || reorder > 0 || mode == 3 || mode == 4 || mode == 7)) {
+        fprintf(stderr, "Os reinícios só rodam nas engines twopass e fused, sem reordenação, fora dos modos 3, 4 e 7.\n");
+        return 1;
+    }
+    if ((coarse != COARSE_NONE || mode == 9) && (n_init > 1 || mode == 4 || mode == 8)) {
+        fprintf(stderr, "A pipeline grossa-para-fina não roda com reinícios nem nos modos 4 e 8.\n");
+        return 1;
+    }
+    if ((precision != PREC_F64 || mode == 6) && !engine->f32) {
+        fprintf(stderr, "A engine %s só aceita pontos em double (float32 e q16: twopass ou fused).\n", engine->name);
+        return 1;
+    }
+    if (precision != PREC_F64 && (mode == 3 || mode == 4)) {
+        fprintf(stderr, "O modo %d só roda em double.\n", mode);
+        return 1;
+    }
     omp_set_num_threads(num_threads);
-    int mode = (argc > 2) ? atoi(argv[2]) : 0; // 0=normal, 1=forte, 2=fraca
+    if (numa_mode && numa_setup(num_threads) != 0) {
+        fprintf(stderr, "Erro ao preparar o modo NUMA.\n");
+        return 1;
+    }
+
+    // Com mais de um processo MPI, todos usam a mesma semente (a maior sorteada)
+    const char *seed_env = getenv("KMEANS_SEED");
+    seed_base = (seed_env != NULL && seed_env[0] != '\0') ? (unsigned int)strtoul(seed_env, NULL, 10)
+                                                          : (unsigned int)time(NULL);
+    seed_base = (unsigned int)mpi_max((double)seed_base);
+
+    // Pontos lidos de arquivo (modos 0, 1 e 5 a 10): mmap sem cópia por padrão, ou leitura
+    // para um buffer com KMEANS_LOAD=read (para comparar o custo de inicialização).
+    // No modo 4 o arquivo é lido em lotes durante as passadas, pela thread de E/S, com
+    // CHUNK_BUFFERS buffers (com KMEANS_LOAD=read, um só: leitura e cálculo se
+    // alternam, para comparar). N e D passam a ser os do arquivo
+    data_path = getenv("KMEANS_DATA");
+    const char *load_mode = getenv("KMEANS_LOAD");
+    ChunkReader *reader = NULL;
+    if (data_path != NULL && data_path[0] != '\0' && (mode == 2 || mode == 3)) {
+        printf("Aviso: o modo %d usa pontos gerados, KMEANS_DATA é ignorado.\n", mode);
+    } else if (data_path != NULL && data_path[0] != '\0' && mode == 4) {
+        int buffers = (load_mode != NULL && strcmp(load_mode, "read") == 0) ? 1 : CHUNK_BUFFERS;
+        reader = chunks_open(data_path, MINIBATCH_SIZE, buffers);
+        if (reader == NULL) return 1;
+        dims = chunks_dims(reader);
+        printf("Dataset: %s (N=%d, D=%d, lido em lotes de %d pontos, %d buffer%s)\n", data_path,
+               chunks_points(reader), dims, chunks_size(reader), buffers, buffers > 1 ? "s" : "");
+    } else if (data_path != NULL && data_path[0] != '\0') {
+        use_mmap = !(load_mode != NULL && strcmp(load_mode, "read") == 0);
+        if (load_dataset() != 0) {
+            mpi_fail();
+            return 1;
+        }
+        dims = data.pts.d;
+        printf("Dataset: %s (N=%d, D=%d, %s), carga em %.4f seg\n", data_path, data.total_n, data.pts.d,
+               use_mmap ? "mmap" : "leitura", omp_get_wtime() - load_start);
+    }
+
+    // Na versão MPI, cada processo precisa de pelo menos um bloco de pontos
+    int base_n = (dataset != NULL) ? dataset->total_n : num_points ? (int)num_points :
+                 (mode == 3) ? SWEEP_NUM_POINTS : DEFAULT_NUM_POINTS;
+    if (mpi_ranks() > 1 && (mode == 4 || mode == 10 || (base_n + ASSIGN_BLOCK - 1) / ASSIGN_BLOCK < mpi_ranks())) {
+        if (mode == 4 || mode == 10) fprintf(stderr, "O modo %d não roda com mais de um processo MPI.\n", mode);
+        else fprintf(stderr, "Poucos pontos para %d processos MPI (mínimo de %d por processo).\n", mpi_ranks(),
+                     ASSIGN_BLOCK);
+        if (dataset != NULL) dataset_close(dataset);
+        chunks_close(reader);
+        return 1;
+    }
+
+    // Detecta o conjunto de instruções suportado pela CPU; o kernel de cada execução
+    // é escolhido depois, conforme D e K
+    int specialized;
+    const char *simd_name = detect_simd();
+    select_assign_kernel(dims, k, precision, &specialized);
+    printf("Kernel de atribuição: %s (%s)\n", simd_name,
+           specialized == 2 ? "especializado em D e K" :
+           specialized == 1 ? "especializado em D" : "genérico");
+    printf("Semente: %u\n", seed_base);
+    if (dataset == NULL && blobs > 0) {
+        printf("Pontos gerados: %d blobs gaussianos (desvio %.3g, desequilíbrio %.3g)\n", blobs, spread, imbalance);
+    }
 
     // Realiza os testes considerando o tipo de escalabilidade informado
     if (mode == 1) {
-        test_strong(DEFAULT_NUM_POINTS);
+        test_strong(base_n, k);
     } else if (mode == 2) {
-        test_weak(DEFAULT_NUM_POINTS);
+        test_weak(num_points ? (int)num_points : DEFAULT_NUM_POINTS, k);
+    } else if (mode == 3) {
+        test_k_sweep(num_points ? (int)num_points : SWEEP_NUM_POINTS, num_threads);
+    } else if (mode == 4) {
+        run_minibatch(num_points ? num_points : STREAM_NUM_POINTS, k, num_threads, label_pass, reader);
+    } else if (mode == 5) {
+        test_init(base_n, k, num_threads);
+    } else if (mode == 6) {
+        test_precision(base_n, k, num_threads);
+    } else if (mode == 7) {
+        test_reorder(base_n, k, num_threads, reorder ? reorder : DEFAULT_REORDER);
+    } else if (mode == 8) {
+        test_restarts(base_n, k, num_threads, n_init > 1 ? n_init : DEFAULT_RESTARTS);
+    } else if (mode == 9) {
+        test_coarse(base_n, k, num_threads);
+    } else if (mode == 10) {
+        test_incremental(base_n, k, num_threads);
     } else {
-        double t = run(DEFAULT_NUM_POINTS, num_threads);
-        printf("\nExecução normal: threads=%d, Tempo=%.4f seg\n", num_threads, t);
+        int n = base_n;
+        RunResult r = run(engine, initializer, precision, n, k, num_threads, NULL);
+        printf("\nExecução normal: threads=%d, K=%d, D=%d, engine=%s, init=%s, precisão=%s, Iterações=%d, Tempo=%.6f seg, "
+               "Preparação=%.4f seg, Inicialização=%.4f seg, Vazão=%.3e pontos/seg, Até a 1ª iteração=%.4f seg, "
+               "Inércia=%.6e\n",
+               num_threads, k, dims, engine->name, initializer->name,
+               precision == PREC_Q16 ? "q16" : precision == PREC_F32 ? "f32" : "f64", r.iterations, r.time,
+               r.setup, r.init, (double)n * r.iterations / r.time, r.startup, r.inertia);
+        if (reorder > 0) {
+            printf("Reordenação: período=%d, Reordenações=%d, Custo=%.4f seg, Blocos pulados=%.1f%%\n",
+                   reorder, r.reorders, r.reorder_time, 100.0 * r.skipped);
+        }
+        if (n_init > 1) {
+            printf("Reinícios: %d, Melhor: reinício %d (semente %u), Iterações somadas=%lld, Pior inércia=%.6e\n",
+                   n_init, r.best_restart, seed_base + (unsigned int)r.best_restart, r.restart_iterations,
+                   r.worst_inertia);
+        }
+        if (coarse != COARSE_NONE) {
+            printf("Pipeline: amostras=%s, Níveis=%d, Maior amostra=%lld, Iterações nas amostras=%d, "
+                   "Tempo nas amostras=%.4f seg, Total=%.4f seg\n", coarse == COARSE_UNIFORM ? "uniform" : "importance",
+                   r.coarse_levels, r.coarse_points, r.coarse_iterations, r.coarse_time,
+                   r.setup + r.init + r.coarse_time + r.time);
+        }
     }
+
+    if (dataset != NULL) dataset_close(dataset);
+    chunks_close(reader);
+    numa_release();
     return 0;
 }
+
+// Na versão MPI, todos os processos executam kmeans_main; sem MPI, há um só processo
+int main(int argc, char *argv[]) {
+    if (mpi_start(&argc, &argv) != 0) return 1;
+    int rc = kmeans_main(argc, argv);
+    mpi_finish();
+    return rc;
+}
@@ -38,8 +38,10 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
-    // Inicializa semente para geração de números aleatórios
-    unsigned int seed = (unsigned int)time(NULL);
+    // Inicializa semente para geração de números aleatórios (fixa com KMEANS_SEED,
+    // para repetir a execução)
+    const char *seed_env = getenv("KMEANS_SEED");
+    unsigned int seed = seed_env ? (unsigned int)strtoul(seed_env, NULL, 10) : (unsigned int)time(NULL);
     srand(seed);
     
     Centroid centroids[K];